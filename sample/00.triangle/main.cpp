@@ -1,7 +1,7 @@
 #include <iostream>
 
 #include <vkpt/frame/transient_images.h>
-#include <vkpt/graph/graph.h>
+#include <vkpt/graph/graph_cache.h>
 #include <vkpt/object/pipeline.h>
 #include <vkpt/context.h>
 #include <vkpt/utility/vertex.h>
@@ -207,10 +207,13 @@ void run()
 
     AGZ_SCOPE_EXIT{ context.waitIdle(); };
 
+    rg::GraphCache graph_cache;
+
     while(!context.getCloseFlag())
     {
         context.doEvents();
-        if(context.isMinimized() || !context.acquireNextImage())
+        if(context.isMinimized() || !context.acquireNextImage(
+               &frame_resources.getFrameSynchronizer()))
             continue;
 
         if(context.getInput()->isDown(KEY_ESCAPE))
@@ -225,7 +228,7 @@ void run()
         }
         ImGui::End();
 
-        rg::Graph graph;
+        rg::Graph graph(frame_resources.getFrameMemory());
 
         graph.waitBeforeFirstUsage(
             context.getImage(), context.getImageAvailableSemaphore());
@@ -264,9 +267,9 @@ void run()
 
         graph.addDependency(triangle_pass, imgui_pass);
 
-        graph.execute(frame_resources, frame_resources);
+        graph.execute(graph_cache, frame_resources, frame_resources);
 
-        context.swapBuffers();
+        context.swapBuffers(&frame_resources.getFrameSynchronizer());
 
         frame_resources.endFrame({ context.getGraphicsQueue() });
     }
@@ -0,0 +1,157 @@
+#include <memory>
+#include <vector>
+
+#include <vkpt/frame/deletion_queue.h>
+
+#include "test.h"
+
+using namespace vkpt;
+
+namespace
+{
+
+    // records its id into a shared list when destroyed
+    class Tracked
+    {
+    public:
+
+        Tracked(std::shared_ptr<std::vector<int>> destroyed, int id)
+            : destroyed_(std::move(destroyed)), id_(id)
+        {
+
+        }
+
+        Tracked(Tracked &&other) noexcept
+            : destroyed_(std::move(other.destroyed_)), id_(other.id_)
+        {
+
+        }
+
+        Tracked &operator=(Tracked &&other) noexcept
+        {
+            std::swap(destroyed_, other.destroyed_);
+            std::swap(id_, other.id_);
+            return *this;
+        }
+
+        ~Tracked()
+        {
+            if(destroyed_)
+                destroyed_->push_back(id_);
+        }
+
+    private:
+
+        std::shared_ptr<std::vector<int>> destroyed_;
+        int                               id_;
+    };
+
+    void testRelease()
+    {
+        auto destroyed = std::make_shared<std::vector<int>>();
+
+        DeletionQueue queue;
+        VKPT_CHECK(queue.empty());
+
+        queue.push(1, Tracked(destroyed, 1));
+        queue.push(2, Tracked(destroyed, 2));
+        queue.push(2, Tracked(destroyed, 3));
+        queue.push(4, Tracked(destroyed, 4));
+        VKPT_CHECK(!queue.empty());
+        VKPT_CHECK(destroyed->empty());
+
+        queue.release(0);
+        VKPT_CHECK(destroyed->empty());
+
+        queue.release(2);
+        VKPT_CHECK((*destroyed == std::vector{ 1, 2, 3 }));
+
+        queue.release(3);
+        VKPT_CHECK(destroyed->size() == 3);
+
+        queue.release(4);
+        VKPT_CHECK((*destroyed == std::vector{ 1, 2, 3, 4 }));
+        VKPT_CHECK(queue.empty());
+    }
+
+    void testOutOfOrderValues()
+    {
+        auto destroyed = std::make_shared<std::vector<int>>();
+
+        DeletionQueue queue;
+        queue.push(5, Tracked(destroyed, 5));
+        queue.push(2, Tracked(destroyed, 2));
+        queue.push(7, Tracked(destroyed, 7));
+        queue.push(3, Tracked(destroyed, 3));
+
+        queue.release(3);
+        VKPT_CHECK((*destroyed == std::vector{ 2, 3 }));
+
+        queue.release(6);
+        VKPT_CHECK((*destroyed == std::vector{ 2, 3, 5 }));
+
+        queue.release(7);
+        VKPT_CHECK(queue.empty());
+    }
+
+    void testMultipleTypes()
+    {
+        auto destroyed = std::make_shared<std::vector<int>>();
+        auto shared = std::make_shared<int>(0);
+
+        DeletionQueue queue;
+        queue.push(1, Tracked(destroyed, 1));
+        queue.push(1, std::unique_ptr<int>(new int(0)));
+        queue.push(2, shared);
+        VKPT_CHECK(shared.use_count() == 2);
+
+        queue.release(1);
+        VKPT_CHECK(destroyed->size() == 1);
+        VKPT_CHECK(shared.use_count() == 2);
+        VKPT_CHECK(!queue.empty());
+
+        queue.release(2);
+        VKPT_CHECK(shared.use_count() == 1);
+        VKPT_CHECK(queue.empty());
+    }
+
+    void testReleaseAll()
+    {
+        auto destroyed = std::make_shared<std::vector<int>>();
+
+        DeletionQueue queue;
+        queue.push(10, Tracked(destroyed, 1));
+        queue.push(20, Tracked(destroyed, 2));
+
+        queue.releaseAll();
+        VKPT_CHECK(destroyed->size() == 2);
+        VKPT_CHECK(queue.empty());
+
+        // the queue stays usable
+
+        queue.push(1, Tracked(destroyed, 3));
+        queue.release(1);
+        VKPT_CHECK(destroyed->size() == 3);
+    }
+
+    void testDestruction()
+    {
+        auto destroyed = std::make_shared<std::vector<int>>();
+        {
+            DeletionQueue queue;
+            queue.push(1, Tracked(destroyed, 1));
+        }
+        VKPT_CHECK(destroyed->size() == 1);
+    }
+
+} // namespace anonymous
+
+int main()
+{
+    testRelease();
+    testOutOfOrderValues();
+    testMultipleTypes();
+    testReleaseAll();
+    testDestruction();
+    return 0;
+}
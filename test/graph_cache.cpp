@@ -0,0 +1,370 @@
+#include <vkpt/context.h>
+#include <vkpt/graph/graph_cache.h>
+
+#include "test.h"
+
+using namespace vkpt;
+
+namespace
+{
+
+    constexpr rg::ResourceUsage STORAGE_READ = {
+        .stages = vk::PipelineStageFlagBits2KHR::eComputeShader,
+        .access = vk::AccessFlagBits2KHR::eShaderStorageRead
+    };
+
+    constexpr rg::ResourceUsage STORAGE_WRITE = {
+        .stages = vk::PipelineStageFlagBits2KHR::eComputeShader,
+        .access = vk::AccessFlagBits2KHR::eShaderStorageWrite
+    };
+
+    // single-queue graphs need no semaphores
+    class NoSemaphores : public SemaphoreAllocator
+    {
+    public:
+
+        vk::Semaphore newSemaphore() override
+        {
+            throw VKPTException("unexpected semaphore allocation");
+        }
+
+        TimelineSemaphore newTimelineSemaphore() override
+        {
+            throw VKPTException("unexpected semaphore allocation");
+        }
+    };
+
+    Buffer createBuffer(Context &context)
+    {
+        return context.getResourceAllocator().createBuffer(
+            vk::BufferCreateInfo{
+                .size  = 256,
+                .usage = vk::BufferUsageFlagBits::eStorageBuffer
+            }, vma::MemoryUsage::eGPUOnly);
+    }
+
+    Image createImage(Context &context)
+    {
+        return context.getResourceAllocator().createImage(
+            vk::ImageCreateInfo{
+                .imageType     = vk::ImageType::e2D,
+                .format        = vk::Format::eR8G8B8A8Unorm,
+                .extent        = { 64, 64, 1 },
+                .mipLevels     = 4,
+                .arrayLayers   = 1,
+                .samples       = vk::SampleCountFlagBits::e1,
+                .tiling        = vk::ImageTiling::eOptimal,
+                .usage         = vk::ImageUsageFlagBits::eStorage,
+                .sharingMode   = vk::SharingMode::eExclusive,
+                .initialLayout = vk::ImageLayout::eUndefined
+            }, vma::MemoryUsage::eGPUOnly);
+    }
+
+    // p0 writes a and b, p1 reads a and writes b
+    void buildGraph(
+        rg::Graph         &graph,
+        const Queue       *queue,
+        const Buffer      &a,
+        const Buffer      &b,
+        rg::ResourceUsage  p1_b_usage = STORAGE_WRITE)
+    {
+        auto p0 = graph.addPass();
+        p0->setQueue(queue);
+        p0->use(a, STORAGE_WRITE);
+        p0->use(b, STORAGE_WRITE);
+
+        auto p1 = graph.addPass();
+        p1->setQueue(queue);
+        p1->use(a, STORAGE_READ);
+        p1->use(b, p1_b_usage);
+
+        graph.addDependency(p0, p1);
+    }
+
+    // same as above with images in the general layout. buffer barriers
+    // within a queue family become global memory barriers, so only image
+    // barriers refer to their resources. returns p1
+    rg::Pass *buildGraph(
+        rg::Graph   &graph,
+        const Queue *queue,
+        const Image &a,
+        const Image &b)
+    {
+        auto general = [](const rg::ResourceUsage &usage)
+        {
+            return rg::ResourceUsage{
+                .stages = usage.stages,
+                .access = usage.access,
+                .layout = vk::ImageLayout::eGeneral
+            };
+        };
+
+        auto p0 = graph.addPass();
+        p0->setQueue(queue);
+        p0->use(a, general(STORAGE_WRITE));
+        p0->use(b, general(STORAGE_WRITE));
+
+        auto p1 = graph.addPass();
+        p1->setQueue(queue);
+        p1->use(a, general(STORAGE_READ));
+        p1->use(b, general(STORAGE_WRITE));
+
+        graph.addDependency(p0, p1);
+        return p1;
+    }
+
+    bool hasPass(const rg::ExecutableGraph &exec, const rg::PassBase *pass)
+    {
+        for(auto &group : exec.groups)
+        {
+            for(auto &executable_pass : group.passes)
+            {
+                if(executable_pass.pass == pass)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    bool onlyUses(
+        const rg::ExecutableGraph &exec, const Image &a, const Image &b)
+    {
+        bool has_barrier = false;
+        auto check = [&](const vk::ImageMemoryBarrier2KHR &barrier)
+        {
+            has_barrier = true;
+            return barrier.image == a.get() || barrier.image == b.get();
+        };
+
+        for(auto &group : exec.groups)
+        {
+            for(auto &pass : group.passes)
+            {
+                for(auto &barrier : pass.pre_image_barriers)
+                {
+                    if(!check(barrier))
+                        return false;
+                }
+                for(auto &barrier : pass.post_image_barriers)
+                {
+                    if(!check(barrier))
+                        return false;
+                }
+            }
+            for(auto &event : group.events)
+            {
+                for(auto &barrier : event.image_barriers)
+                {
+                    if(!check(barrier))
+                        return false;
+                }
+            }
+        }
+        return has_barrier;
+    }
+
+    void testRebinding(Context &context)
+    {
+        NoSemaphores semaphores;
+        rg::GraphCache cache;
+
+        // fresh images have unrelated handles in every frame
+
+        for(int frame = 0; frame < 16; ++frame)
+        {
+            auto a = createImage(context);
+            auto b = createImage(context);
+
+            rg::Graph graph;
+            buildGraph(graph, context.getGraphicsQueue(), a, b);
+
+            auto &exec = cache.getExecutableGraph(semaphores, graph);
+            VKPT_CHECK(cache.getEntryCount() == 1);
+            VKPT_CHECK(onlyUses(exec, a, b));
+        }
+    }
+
+    void testToggling(Context &context)
+    {
+        NoSemaphores semaphores;
+        rg::GraphCache cache;
+
+        // enable states are applied to the entry of the structure, and
+        // groups filled again are re-bound to the images of every frame
+
+        for(int frame = 0; frame < 8; ++frame)
+        {
+            auto a = createImage(context);
+            auto b = createImage(context);
+
+            rg::Graph graph;
+            auto p1 = buildGraph(graph, context.getGraphicsQueue(), a, b);
+            p1->setEnabled(frame % 3 != 1);
+
+            auto &exec = cache.getExecutableGraph(semaphores, graph);
+            VKPT_CHECK(cache.getEntryCount() == 1);
+            VKPT_CHECK(onlyUses(exec, a, b));
+            VKPT_CHECK(hasPass(exec, p1) == p1->isEnabled());
+        }
+    }
+
+    void testToggleFallback(Context &context)
+    {
+        NoSemaphores semaphores;
+        rg::GraphCache cache;
+
+        // w writes a, then r0 and r1 read it. without w, the reads form a
+        // first run whose layout transition needs a join the graph compiled
+        // with all passes enabled doesn't have
+
+        auto a = createImage(context);
+
+        auto execute = [&](bool w_enabled)
+        {
+            auto usage = [](const rg::ResourceUsage &u)
+            {
+                return rg::ResourceUsage{
+                    .stages = u.stages,
+                    .access = u.access,
+                    .layout = vk::ImageLayout::eGeneral
+                };
+            };
+
+            rg::Graph graph;
+            auto w = graph.addPass();
+            w->setQueue(context.getGraphicsQueue());
+            w->use(a, usage(STORAGE_WRITE));
+            w->setEnabled(w_enabled);
+
+            for(int i = 0; i < 2; ++i)
+            {
+                auto r = graph.addPass();
+                r->setQueue(context.getGraphicsQueue());
+                r->use(a, usage(STORAGE_READ));
+                graph.addDependency(w, r);
+            }
+
+            auto &exec = cache.getExecutableGraph(semaphores, graph);
+            VKPT_CHECK(hasPass(exec, w) == w_enabled);
+        };
+
+        // a miss with w disabled is compiled once, for its enable states
+
+        execute(false);
+        VKPT_CHECK(cache.getEntryCount() == 1);
+
+        execute(true);
+        VKPT_CHECK(cache.getEntryCount() == 2);
+
+        for(int frame = 0; frame < 4; ++frame)
+        {
+            execute(frame % 2 == 0);
+            VKPT_CHECK(cache.getEntryCount() == 2);
+        }
+    }
+
+    void testStructureMiss(Context &context)
+    {
+        NoSemaphores semaphores;
+        rg::GraphCache cache;
+
+        auto a = createBuffer(context);
+        auto b = createBuffer(context);
+
+        {
+            rg::Graph graph;
+            buildGraph(graph, context.getGraphicsQueue(), a, b);
+            cache.getExecutableGraph(semaphores, graph);
+        }
+
+        {
+            rg::Graph graph;
+            buildGraph(graph, context.getGraphicsQueue(), a, b, STORAGE_READ);
+            cache.getExecutableGraph(semaphores, graph);
+        }
+        VKPT_CHECK(cache.getEntryCount() == 2);
+
+        {
+            rg::Graph graph;
+            buildGraph(graph, context.getGraphicsQueue(), a, b);
+            cache.getExecutableGraph(semaphores, graph);
+        }
+        VKPT_CHECK(cache.getEntryCount() == 2);
+
+        // incoming states are part of the key
+
+        a.getState() = UsingState{
+            .queue  = context.getGraphicsQueue(),
+            .stages = STORAGE_WRITE.stages,
+            .access = STORAGE_WRITE.access
+        };
+
+        {
+            rg::Graph graph;
+            buildGraph(graph, context.getGraphicsQueue(), a, b);
+            cache.getExecutableGraph(semaphores, graph);
+        }
+        VKPT_CHECK(cache.getEntryCount() == 3);
+    }
+
+    void testImageStates(Context &context)
+    {
+        NoSemaphores semaphores;
+        rg::GraphCache cache;
+
+        auto image = createImage(context);
+
+        auto execute = [&]
+        {
+            rg::Graph graph;
+            auto pass = graph.addPass();
+            pass->setQueue(context.getGraphicsQueue());
+            pass->use(image, rg::ResourceUsage{
+                .stages = STORAGE_WRITE.stages,
+                .access = STORAGE_WRITE.access,
+                .layout = vk::ImageLayout::eGeneral
+            });
+            cache.getExecutableGraph(semaphores, graph);
+        };
+
+        execute();
+        execute();
+        VKPT_CHECK(cache.getEntryCount() == 1);
+
+        image.getState(vk::ImageSubresource{
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .mipLevel   = 2,
+            .arrayLayer = 0
+        }) = FreeState{ .layout = vk::ImageLayout::eGeneral };
+
+        execute();
+        VKPT_CHECK(cache.getEntryCount() == 2);
+    }
+
+} // namespace anonymous
+
+int main()
+{
+    std::unique_ptr<Context> context;
+    try
+    {
+        context = std::make_unique<Context>(Context::Description{
+            .headless = true,
+            .imgui    = false
+        });
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "no vulkan device: " << e.what() << std::endl;
+        return VKPT_TEST_SKIPPED;
+    }
+
+    testRebinding(*context);
+    testToggling(*context);
+    testToggleFallback(*context);
+    testStructureMiss(*context);
+    testImageStates(*context);
+
+    context->waitIdle();
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+#define VKPT_CHECK(COND)                                                       \
+    do                                                                         \
+    {                                                                          \
+        if(!(COND))                                                            \
+        {                                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__                           \
+                      << ": check failed: " #COND << std::endl;                \
+            std::exit(1);                                                      \
+        }                                                                      \
+    } while(false)
+
+constexpr int VKPT_TEST_SKIPPED = 77;
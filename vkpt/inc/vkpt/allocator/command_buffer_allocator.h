@@ -5,6 +5,8 @@
 
 VKPT_BEGIN
 
+class FrameSynchronizer;
+
 class CommandBufferAllocator
 {
 public:
@@ -13,6 +15,8 @@ public:
 
     virtual CommandBuffer newCommandBuffer(Queue::Type type) = 0;
 
+    virtual CommandBuffer newSecondaryCommandBuffer(Queue::Type type) = 0;
+
     virtual CommandBuffer newGraphicsCommandBuffer()
     {
         return newCommandBuffer(Queue::Type::Graphics);
@@ -32,6 +36,13 @@ public:
     {
         return newCommandBuffer(Queue::Type::Present);
     }
+
+    // frame synchronizer signaled by graphs recorded with this allocator,
+    // unless they set their own with Graph::setFrameSynchronizer
+    virtual FrameSynchronizer *_getFrameSynchronizer()
+    {
+        return nullptr;
+    }
 };
 
 VKPT_END
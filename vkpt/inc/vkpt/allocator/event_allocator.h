@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vkpt/common.h>
+
+VKPT_BEGIN
+
+class EventAllocator
+{
+public:
+
+    virtual ~EventAllocator() = default;
+
+    // returned event is unsignaled
+    virtual vk::Event newEvent() = 0;
+};
+
+VKPT_END
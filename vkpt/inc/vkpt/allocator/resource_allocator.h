@@ -46,6 +46,27 @@ public:
     Image createImage(
         const vk::ImageCreateInfo &create_info, vma::MemoryUsage usage);
 
+    // resources without memory. bind them with bindMemory before use
+
+    Buffer createUnboundBuffer(const vk::BufferCreateInfo &create_info);
+
+    Image createUnboundImage(const vk::ImageCreateInfo &create_info);
+
+    vk::MemoryRequirements getMemoryRequirements(const Buffer &buffer) const;
+
+    vk::MemoryRequirements getMemoryRequirements(const Image &image) const;
+
+    VmaAllocation allocateMemory(
+        const vk::MemoryRequirements &requirements, vma::MemoryUsage usage);
+
+    void freeMemory(VmaAllocation allocation);
+
+    void bindMemory(
+        const Buffer &buffer, VmaAllocation allocation, vk::DeviceSize offset);
+
+    void bindMemory(
+        const Image &image, VmaAllocation allocation, vk::DeviceSize offset);
+
 private:
 
     void swap(ResourceAllocator &other) noexcept;
@@ -19,12 +19,19 @@ public:
 
     void begin(bool one_time_submit = true);
 
+    // begin a secondary command buffer. render pass continue is set when
+    // inheritance.renderPass is not null
+    void beginSecondary(
+        const vk::CommandBufferInheritanceInfo &inheritance,
+        bool                                    one_time_submit = true);
+
     void end();
 
     void beginPipeline(
         const Pipeline                      &pipeline,
         const Framebuffer                   &framebuffer,
-        vk::ArrayProxy<const vk::ClearValue> clear_values);
+        vk::ArrayProxy<const vk::ClearValue> clear_values,
+        vk::SubpassContents                  contents = vk::SubpassContents::eInline);
 
     void endPipeline();
 
@@ -36,6 +43,8 @@ public:
         vk::ArrayProxy<const vk::Buffer> vertex_buffers,
         vk::ArrayProxy<size_t>           vertex_offsets = {});
 
+    void executeCommands(vk::ArrayProxy<const vk::CommandBuffer> command_buffers);
+
     void draw(
         uint32_t vertex_count,
         uint32_t instance_count = 1,
@@ -54,6 +63,16 @@ public:
         vk::ArrayProxy<const vk::BufferMemoryBarrier2KHR> buffer_barriers,
         vk::ArrayProxy<const vk::ImageMemoryBarrier2KHR>  image_barriers);
 
+    void setEvent(
+        vk::Event                                         event,
+        vk::ArrayProxy<const vk::BufferMemoryBarrier2KHR> buffer_barriers,
+        vk::ArrayProxy<const vk::ImageMemoryBarrier2KHR>  image_barriers);
+
+    // dependency_infos[i] must match the one used to set events[i]
+    void waitEvents(
+        vk::ArrayProxy<const vk::Event>             events,
+        vk::ArrayProxy<const vk::DependencyInfoKHR> dependency_infos);
+
 protected:
 
     vk::CommandBuffer impl_;
@@ -5,6 +5,7 @@
 #include <queue>
 #include <set>
 #include <stdexcept>
+#include <unordered_map>
 
 #include <agz-utils/math.h>
 #include <vulkan/vulkan.hpp>
@@ -52,6 +53,9 @@ using MultiMap = std::pmr::multimap<K, V>;
 template<typename T>
 using Set = std::pmr::set<T>;
 
+template<typename K, typename V, typename H = std::hash<K>>
+using HashMap = std::pmr::unordered_map<K, V, H>;
+
 template<typename T>
 using PmrQueue = std::queue<T, std::pmr::deque<T>>;
 
@@ -118,6 +122,19 @@ constexpr bool hasStencilAspect(vk::Format format)
         format == vk::Format::eD32SfloatS8Uint;
 }
 
+// calls f with each single aspect bit in aspects
+template<typename F>
+void foreachAspect(vk::ImageAspectFlags aspects, const F &f)
+{
+    auto bits = static_cast<VkImageAspectFlags>(aspects);
+    while(bits)
+    {
+        const VkImageAspectFlags bit = bits & (~bits + 1);
+        f(static_cast<vk::ImageAspectFlagBits>(bit));
+        bits &= ~bit;
+    }
+}
+
 inline vk::ImageSubresourceRange subrscToRange(
     const vk::ImageSubresource &subrsc)
 {
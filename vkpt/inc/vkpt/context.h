@@ -38,7 +38,14 @@ public:
         std::string title = "vkpt";
 
         int image_count = 3;
-        
+
+        // no window, surface or swapchain. the device needs no present
+        // support and may have a single queue family (e.g. lavapipe).
+        // swapchain images are replaced by offscreen images of width x height,
+        // acquired and 'presented' in turn with the same semaphores as a
+        // swapchain. window events and imgui are unavailable
+        bool headless = false;
+
         bool ray_tracing = false;
 
         bool imgui = true;
@@ -60,7 +67,10 @@ public:
 
     // vulkan frame
 
-    void swapBuffers();
+    // in headless mode, presentation is replaced by a submit, which carries
+    // a signal of frame_synchronizer if given (see FrameSynchronizer::
+    // endFrame)
+    void swapBuffers(FrameSynchronizer *frame_synchronizer = nullptr);
 
     FrameResources createFrameResources();
 
@@ -70,6 +80,7 @@ public:
 
     void waitIdle();
 
+    // nullptr in headless mode
     Input *getInput();
 
     void doEvents();
@@ -88,12 +99,27 @@ public:
 
     vk::Device getDevice();
 
+    bool isHeadless() const;
+
+    // nullptr in headless mode
     vk::SwapchainKHR getSwapchain();
 
     Queue *getGraphicsQueue();
 
     Queue *getComputeQueue();
 
+    // all queues of the graphics/compute family. index 0 is the queue
+    // returned by getGraphicsQueue()/getComputeQueue(). passes can be
+    // spread over them with Graph::addEquivalentQueues. the compute queue
+    // count is 1 when compute aliases the graphics family
+    uint32_t getGraphicsQueueCount() const;
+
+    Queue *getGraphicsQueue(uint32_t index);
+
+    uint32_t getComputeQueueCount() const;
+
+    Queue *getComputeQueue(uint32_t index);
+
     Queue *getPresentQueue();
 
     Queue *getTransferQueue();
@@ -123,7 +149,9 @@ public:
 
     void recreateSwapchain();
 
-    bool acquireNextImage();
+    // in headless mode, acquisition is replaced by a submit, which carries
+    // a signal of frame_synchronizer if given
+    bool acquireNextImage(FrameSynchronizer *frame_synchronizer = nullptr);
 
     vk::Extent2D getFramebufferSize() const;
 
@@ -183,12 +211,17 @@ private:
 
     void createSwapchain();
 
+    void createVirtualSwapchain(const Description &desc);
+
     struct VKBImpl;
 
     std::unique_ptr<VKBImpl> impl_;
 
     GLFWwindow *window_ = nullptr;
 
+    bool headless_   = false;
+    bool close_flag_ = false;
+
     std::unique_ptr<Input> input_;
 
     vk::Instance       instance_;
@@ -200,6 +233,9 @@ private:
     Queue present_queue_;
     Queue transfer_queue_;
 
+    std::vector<Queue> extra_graphics_queues_;
+    std::vector<Queue> extra_compute_queues_;
+
     uint32_t graphics_queue_family_;
     uint32_t compute_queue_family_;
     uint32_t present_queue_family_;
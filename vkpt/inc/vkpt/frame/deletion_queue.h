@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <vkpt/common.h>
+
+VKPT_BEGIN
+
+// objects destroyed in batches once a timeline value is reached.
+// objects are stored by type, without per-object type erasure, and sorted
+// by value. pushing non-decreasing values is the cheap common case
+class DeletionQueue : public agz::misc::uncopyable_t
+{
+public:
+
+    DeletionQueue() = default;
+
+    DeletionQueue(DeletionQueue &&other) noexcept = default;
+
+    DeletionQueue &operator=(DeletionQueue &&other) noexcept = default;
+
+    template<typename T>
+    void push(uint64_t value, T obj);
+
+    // destroy objects pushed with values not greater than completed_value
+    void release(uint64_t completed_value);
+
+    void releaseAll();
+
+    bool empty() const;
+
+private:
+
+    struct ContainerBase
+    {
+        virtual ~ContainerBase() = default;
+
+        virtual void release(uint64_t completed_value) = 0;
+
+        virtual void releaseAll() = 0;
+
+        virtual bool empty() const = 0;
+    };
+
+    template<typename T>
+    struct Container : ContainerBase
+    {
+        std::deque<std::pair<uint64_t, T>> objects;
+
+        void release(uint64_t completed_value) override;
+
+        void releaseAll() override;
+
+        bool empty() const override;
+    };
+
+    static size_t newTypeIndex();
+
+    template<typename T>
+    static size_t getTypeIndex();
+
+    std::vector<std::unique_ptr<ContainerBase>> containers_;
+};
+
+template<typename T>
+void DeletionQueue::push(uint64_t value, T obj)
+{
+    const size_t index = getTypeIndex<T>();
+    if(index >= containers_.size())
+        containers_.resize(index + 1);
+
+    auto &container = containers_[index];
+    if(!container)
+        container = std::make_unique<Container<T>>();
+
+    auto &objects = static_cast<Container<T> *>(container.get())->objects;
+    if(objects.empty() || objects.back().first <= value)
+    {
+        objects.emplace_back(value, std::move(obj));
+        return;
+    }
+
+    auto it = std::ranges::upper_bound(
+        objects, value, {}, &std::pair<uint64_t, T>::first);
+    objects.emplace(it, value, std::move(obj));
+}
+
+inline void DeletionQueue::release(uint64_t completed_value)
+{
+    for(auto &c : containers_)
+    {
+        if(c)
+            c->release(completed_value);
+    }
+}
+
+inline void DeletionQueue::releaseAll()
+{
+    for(auto &c : containers_)
+    {
+        if(c)
+            c->releaseAll();
+    }
+}
+
+inline bool DeletionQueue::empty() const
+{
+    for(auto &c : containers_)
+    {
+        if(c && !c->empty())
+            return false;
+    }
+    return true;
+}
+
+template<typename T>
+void DeletionQueue::Container<T>::release(uint64_t completed_value)
+{
+    auto it = objects.begin();
+    while(it != objects.end() && it->first <= completed_value)
+        ++it;
+    objects.erase(objects.begin(), it);
+}
+
+template<typename T>
+void DeletionQueue::Container<T>::releaseAll()
+{
+    objects.clear();
+}
+
+template<typename T>
+bool DeletionQueue::Container<T>::empty() const
+{
+    return objects.empty();
+}
+
+inline size_t DeletionQueue::newTypeIndex()
+{
+    static std::atomic<size_t> next_index = 0;
+    return next_index++;
+}
+
+template<typename T>
+size_t DeletionQueue::getTypeIndex()
+{
+    static const size_t index = newTypeIndex();
+    return index;
+}
+
+VKPT_END
@@ -1,15 +1,20 @@
 #pragma once
 
+#include <span>
+
 #include <vkpt/frame/frame_synchronizer.h>
 #include <vkpt/frame/perframe_command_buffers.h>
+#include <vkpt/frame/perframe_events.h>
 #include <vkpt/frame/perframe_fences.h>
 #include <vkpt/frame/perframe_semaphores.h>
+#include <vkpt/utility/monotonic_arena.h>
 
 VKPT_BEGIN
 
 class FrameResources :
     public agz::misc::uncopyable_t,
     public CommandBufferAllocator,
+    public EventAllocator,
     public FenceAllocator,
     public SemaphoreAllocator
 {
@@ -35,27 +40,55 @@ public:
 
     void beginFrame();
 
-    void endFrame(vk::ArrayProxy<Queue *const> queues);
+    // the queues given at construction are always tracked,
+    // see FrameSynchronizer::endFrame
+    void endFrame(vk::ArrayProxy<Queue *const> queues = {});
+
+    FrameSynchronizer &getFrameSynchronizer();
 
     CommandBufferAllocator &getCommandBufferAllocator();
 
+    // one command buffer allocator per thread of a thread pool with
+    // thread_count threads, e.g. for Graph::setRecordThreadPool. allocators
+    // are created on first request and reset at beginFrame like others
+    std::span<CommandBufferAllocator *const> getThreadCommandBufferAllocators(
+        uint32_t thread_count);
+
     SemaphoreAllocator &getSemaphoreAllocator();
 
     FenceAllocator &getFenceAllocator();
 
+    EventAllocator &getEventAllocator();
+
+    // host memory of the current frame slot, reset at beginFrame. meant for
+    // per-frame objects like graphs, which then allocate nothing from the
+    // system once the arena has grown to its steady size
+    std::pmr::memory_resource &getFrameMemory();
+
     CommandBuffer newCommandBuffer(Queue::Type type) override;
 
+    CommandBuffer newSecondaryCommandBuffer(Queue::Type type) override;
+
     vk::Fence newFence() override;
 
+    vk::Event newEvent() override;
+
     vk::Semaphore newSemaphore() override;
 
     TimelineSemaphore newTimelineSemaphore() override;
 
+    // graphs executed with this as command buffer allocator signal the
+    // frame timelines
+    FrameSynchronizer *_getFrameSynchronizer() override;
+
     void executeAfterSync(std::function<void()> func);
 
     template<typename T>
     void destroyAfterSync(T obj);
 
+    template<typename T>
+    void destroyAfterQueue(const Queue *queue, uint64_t value, T obj);
+
     void _triggerAllSync();
 
 private:
@@ -64,6 +97,17 @@ private:
     PerFrameFences         fences_;
     PerFrameCommandBuffers cmd_buffers_;
     PerFrameSemaphores     semaphores_;
+    PerFrameEvents         events_;
+
+    vk::Device              device_;
+    uint32_t                frame_count_ = 0;
+    std::array<uint32_t, 4> queue_families_ = {};
+
+    std::vector<std::unique_ptr<PerFrameCommandBuffers>> thread_cmd_buffers_;
+    std::vector<CommandBufferAllocator *> thread_cmd_buffer_allocators_;
+
+    int                         frame_memory_index_ = 0;
+    std::vector<MonotonicArena> frame_memory_;
 };
 
 template<typename T>
@@ -72,4 +116,11 @@ void FrameResources::destroyAfterSync(T obj)
     sync_.destroyAfterSync(std::move(obj));
 }
 
+template<typename T>
+void FrameResources::destroyAfterQueue(
+    const Queue *queue, uint64_t value, T obj)
+{
+    sync_.destroyAfterQueue(queue, value, std::move(obj));
+}
+
 VKPT_END
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <vkpt/frame/deletion_queue.h>
 #include <vkpt/object/queue.h>
+#include <vkpt/object/semaphore.h>
 
 VKPT_BEGIN
 
+// tracks frame completion with one timeline semaphore per queue.
+// submits of a frame attach signals from newQueueSignal, and a frame slot
+// is reused only after the last value signaled on each queue in it is
+// reached
 class FrameSynchronizer : public agz::misc::uncopyable_t
 {
 public:
@@ -24,38 +30,103 @@ public:
 
     void newFrame();
 
-    void endFrame(vk::ArrayProxy<Queue *const> queues);
+    // queues are tracked from their first signal or trackQueue call, and
+    // the given queues are tracked first. a tracked queue that received a
+    // submit after its last signal (e.g. from an uploader or a graph without
+    // frame synchronizer) is signaled by a submit without commands, so that
+    // the frame covers that work too. submits of Context::acquireNextImage
+    // and Context::swapBuffers in headless mode avoid it when given this
+    void endFrame(vk::ArrayProxy<Queue *const> queues = {});
+
+    void trackQueue(const Queue *queue);
+
+    // signal to be attached to a submit to queue in this frame. the frame
+    // is considered complete on queue when the signal is reached
+    vk::SemaphoreSubmitInfoKHR newQueueSignal(const Queue *queue);
+
+    // value of the last signal returned by newQueueSignal for queue, e.g.
+    // the one attached by Graph::execute to its last submit to queue.
+    // 0 if queue has never been signaled
+    uint64_t getLastQueueSignalValue(const Queue *queue);
+
+    // index of the frame being recorded, starting from 0 at construction
+    uint64_t getFrameIndex() const;
+
+    // doesn't block
+    bool isFrameComplete(uint64_t frame_index) const;
 
     void executeAfterSync(std::function<void()> func);
 
+    // destroyed when the frame slot is reused
     template<typename T>
     void destroyAfterSync(T obj);
 
+    // destroyed once the frame timeline of queue reaches value, which must
+    // come from a signal submitted after the last work using obj (see
+    // newQueueSignal and getLastQueueSignalValue). prefer this for
+    // resources used by a single queue, as they are released without
+    // waiting for the frame
+    template<typename T>
+    void destroyAfterQueue(const Queue *queue, uint64_t value, T obj);
+
+    // destroy objects whose queue work has completed. doesn't block and is
+    // called by newFrame
+    void collectGarbage();
+
     void _triggerAllSync();
 
 private:
 
-    struct FenceInfo
+    struct QueueTimeline
+    {
+        vk::Queue         raw_queue;
+        const Queue      *queue = nullptr;
+        TimelineSemaphore semaphore;
+        bool              signaled_in_frame = false;
+        DeletionQueue     deletion_queue;
+
+        // submit count of the queue once the last signal is submitted
+        uint64_t tracked_submit_count = 0;
+    };
+
+    struct FrameInfo
     {
-        bool will_be_signaled = false;
-        std::vector<vk::Fence>       used_fences;
-        std::vector<vk::UniqueFence> fences;
+        uint64_t frame_index = 0;
+
+        // values to wait for before reusing this frame slot
+        std::vector<vk::Semaphore> semaphores;
+        std::vector<uint64_t>      values;
 
         std::vector<std::function<void()>> delayed_functions;
+        DeletionQueue                      deletion_queue;
     };
 
-    void wait(FenceInfo &info);
+    QueueTimeline &getTimeline(const Queue *queue);
+
+    void wait(FrameInfo &info);
 
     vk::Device device_;
 
-    int frame_index_;
-    std::vector<FenceInfo> fence_info_;
+    int      frame_slot_;
+    uint64_t frame_index_;
+
+    std::vector<FrameInfo>     frame_info_;
+    std::vector<QueueTimeline> timelines_;
 };
 
 template<typename T>
 void FrameSynchronizer::destroyAfterSync(T obj)
 {
-    this->executeAfterSync([o = std::move(obj)]{});
+    frame_info_[frame_slot_].deletion_queue.push(0, std::move(obj));
+}
+
+template<typename T>
+void FrameSynchronizer::destroyAfterQueue(
+    const Queue *queue, uint64_t value, T obj)
+{
+    auto &timeline = getTimeline(queue);
+    assert(value <= timeline.semaphore.getLastSignalValue());
+    timeline.deletion_queue.push(value, std::move(obj));
 }
 
 VKPT_END
@@ -27,6 +27,8 @@ public:
     void newFrame();
 
     vk::CommandBuffer newCommandBuffer();
+
+    vk::CommandBuffer newSecondaryCommandBuffer();
     
 private:
 
@@ -35,8 +37,16 @@ private:
         vk::UniqueCommandPool                pool;
         std::vector<vk::UniqueCommandBuffer> buffers;
         size_t                               next_available_buffer_index = 0;
+
+        std::vector<vk::UniqueCommandBuffer> secondary_buffers;
+        size_t                               next_available_secondary_index = 0;
     };
 
+    vk::CommandBuffer newCommandBuffer(
+        std::vector<vk::UniqueCommandBuffer> &buffers,
+        size_t                               &next_available_index,
+        vk::CommandBufferLevel                level);
+
     vk::Device device_;
 
     int frame_index_;
@@ -71,6 +81,8 @@ public:
 
     CommandBuffer newCommandBuffer(Queue::Type type) override;
 
+    CommandBuffer newSecondaryCommandBuffer(Queue::Type type) override;
+
 private:
 
     std::array<PerFrameSingleQueueCommandBuffers, 4> per_queue_;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vkpt/allocator/event_allocator.h>
+
+VKPT_BEGIN
+
+class PerFrameEvents : public EventAllocator, public agz::misc::uncopyable_t
+{
+public:
+
+    PerFrameEvents();
+
+    PerFrameEvents(vk::Device device, uint32_t frame_count);
+
+    PerFrameEvents(PerFrameEvents &&other) noexcept;
+
+    PerFrameEvents &operator=(PerFrameEvents &&other) noexcept;
+
+    operator bool() const;
+
+    void swap(PerFrameEvents &other) noexcept;
+
+    void newFrame();
+
+    vk::Event newEvent() override;
+
+private:
+
+    struct PerFrame
+    {
+        std::vector<vk::UniqueEvent> events;
+        size_t next_available_event = 0;
+    };
+
+    vk::Device device_;
+
+    int frame_index_;
+    std::vector<PerFrame> frames_;
+};
+
+VKPT_END
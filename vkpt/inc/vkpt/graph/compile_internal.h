@@ -1,6 +1,5 @@
 #pragma once
 
-#include <bitset>
 #include <iostream>
 
 #include <vkpt/graph/graph.h>
@@ -32,6 +31,62 @@ protected:
 };
 
 struct CompileGroup;
+struct CompilePass;
+
+struct CompileBufferUsage
+{
+    CompilePass               *pass;
+    vk::PipelineStageFlags2KHR stages;
+    vk::AccessFlags2KHR        access;
+
+    operator Pass::BufferUsage() const;
+};
+
+struct CompileImageUsage
+{
+    CompilePass               *pass;
+    vk::PipelineStageFlags2KHR stages;
+    vk::AccessFlags2KHR        access;
+    vk::ImageLayout            layout;
+    vk::ImageLayout            exit_layout;
+
+    operator Pass::ImageUsage() const;
+};
+
+// refers to a pass's usage in the resource record with the given index
+
+struct CompileBufferUsageRef
+{
+    int                                record;
+    List<CompileBufferUsage>::iterator usage;
+};
+
+struct CompileImageUsageRef
+{
+    int                               record;
+    List<CompileImageUsage>::iterator usage;
+};
+
+// dynamically sized bitset used to partition passes into groups.
+// bits are only ever set, and a hash of the set bits is maintained
+// incrementally so that most unequal flags are rejected in O(1)
+class GroupFlags
+{
+public:
+
+    explicit GroupFlags(std::pmr::memory_resource &memory);
+
+    bool test(size_t index) const;
+
+    void set(size_t index);
+
+    bool operator==(const GroupFlags &rhs) const;
+
+private:
+
+    Vector<uint64_t> words_;
+    uint64_t         hash_;
+};
 
 struct CompilePass
 {
@@ -46,27 +101,95 @@ struct CompilePass
     int      sorted_index;
     int      sorted_index_in_group;
 
-    std::bitset<64> group_flags;
+    GroupFlags group_flags;
 
     Set<CompilePass *> tails;
     Set<CompilePass *> heads;
     
-    Set<vk::BufferMemoryBarrier2KHR> pre_ext_buffer_barriers;
-    Set<vk::ImageMemoryBarrier2KHR>  pre_ext_image_barriers;
-    Set<vk::BufferMemoryBarrier2KHR> post_ext_buffer_barriers;
-    Set<vk::ImageMemoryBarrier2KHR>  post_ext_image_barriers;
+    // barriers are appended freely and deduplicated by removeDuplicates
+
+    Vector<vk::BufferMemoryBarrier2KHR> pre_ext_buffer_barriers;
+    Vector<vk::ImageMemoryBarrier2KHR>  pre_ext_image_barriers;
+    Vector<vk::BufferMemoryBarrier2KHR> post_ext_buffer_barriers;
+    Vector<vk::ImageMemoryBarrier2KHR>  post_ext_image_barriers;
 
-    Map<Buffer, vk::BufferMemoryBarrier2KHR>          pre_buffer_barriers;
-    Map<ImageSubresource, vk::ImageMemoryBarrier2KHR> pre_image_barriers;
+    // tagged with resource record index. only the first barrier of each
+    // record is kept
+
+    Vector<std::pair<int, vk::BufferMemoryBarrier2KHR>> pre_buffer_barriers;
+    Vector<std::pair<int, vk::ImageMemoryBarrier2KHR>>  pre_image_barriers;
 
     std::optional<vk::MemoryBarrier2KHR> pre_memory_barrier;
     std::optional<vk::MemoryBarrier2KHR> post_memory_barrier;
 
-    Map<Semaphore, vk::SemaphoreSubmitInfoKHR> wait_semaphores;
-    Map<Semaphore, vk::SemaphoreSubmitInfoKHR> signal_semaphores;
+    Vector<vk::SemaphoreSubmitInfoKHR> wait_semaphores;
+    Vector<vk::SemaphoreSubmitInfoKHR> signal_semaphores;
+
+    // indices into group->events. events are set after this pass or
+    // waited before it
+
+    Vector<int> set_events;
+    Vector<int> wait_events;
 
-    Map<Buffer, Pass::BufferUsage>          generated_buffer_usages;
-    Map<ImageSubresource, Pass::ImageUsage> generated_image_usages;
+    // find the submit info of given semaphore. create a new one if not found
+    vk::SemaphoreSubmitInfoKHR &getWaitSemaphore(vk::Semaphore semaphore);
+    vk::SemaphoreSubmitInfoKHR &getSignalSemaphore(vk::Semaphore semaphore);
+
+    void removeDuplicates();
+
+    Vector<CompileBufferUsageRef> buffer_usages;
+    Vector<CompileImageUsageRef>  image_usages;
+};
+
+struct CompileBuffer
+{
+    CompileBuffer(
+        std::pmr::memory_resource &memory, int index, const Buffer &resource);
+
+    int    index;
+    Buffer resource;
+
+    List<CompileBufferUsage> usages;
+    bool              has_wait_semaphore   = false;
+    bool              has_signal_semaphore = false;
+
+    // the first usage is a generated pass standing for the last user of the
+    // incoming state on another queue
+    bool              has_dummy_pass       = false;
+};
+
+// covers a range of subresources of a single aspect.
+// all subresources in it share the same usages and initial state
+struct CompileImage
+{
+    CompileImage(
+        std::pmr::memory_resource   &memory,
+        int                          index,
+        const ImageSubresourceRange &resource);
+
+    int                   index;
+    ImageSubresourceRange resource;
+
+    List<CompileImageUsage> usages;
+    bool             has_wait_semaphore = false;
+    bool             has_signal_semaphore = false;
+    bool             has_dummy_pass = false;
+};
+
+// split barrier between two passes of the same group. set after
+// signal_pass and waited before wait_pass with the same barriers
+struct CompileEvent
+{
+    CompileEvent(
+        std::pmr::memory_resource &memory,
+        CompilePass               *signal_pass,
+        CompilePass               *wait_pass);
+
+    CompilePass *signal_pass;
+    CompilePass *wait_pass;
+
+    Vector<vk::BufferMemoryBarrier2KHR> buffer_barriers;
+    Vector<vk::ImageMemoryBarrier2KHR>  image_barriers;
 };
 
 struct CompileGroup
@@ -75,6 +198,7 @@ struct CompileGroup
 
     const Queue          *queue;
     Vector<CompilePass *> passes;
+    Vector<CompileEvent>  events;
 
     bool              need_tail_semaphore;
     TimelineSemaphore tail_semaphore;
@@ -85,49 +209,65 @@ struct CompileGroup
     int unprocessed_head_count;
 };
 
-struct CompileBufferUsage
-{
-    CompilePass               *pass;
-    vk::PipelineStageFlags2KHR stages;
-    vk::AccessFlags2KHR        access;
+using CompileResource = agz::misc::variant_t<Buffer, ImageSubresourceRange>;
 
-    operator Pass::BufferUsage() const;
-};
+const ResourceState &getResourceState(const Buffer &buffer);
 
-struct CompileImageUsage
-{
-    CompilePass               *pass;
-    vk::PipelineStageFlags2KHR stages;
-    vk::AccessFlags2KHR        access;
-    vk::ImageLayout            layout;
-    vk::ImageLayout            exit_layout;
+const ResourceState &getResourceState(const ImageSubresourceRange &image_range);
 
-    operator Pass::ImageUsage() const;
-};
+bool isSameState(const ResourceState &a, const ResourceState &b);
 
-struct CompileBuffer
-{
-    explicit CompileBuffer(std::pmr::memory_resource &memory);
+// a usage that only reads and keeps the layout. passes reading a resource
+// between two writes are not ordered with each other
+bool isSharedRead(const Pass::BufferUsage &usage);
+bool isSharedRead(const Pass::ImageUsage &usage);
 
-    List<CompileBufferUsage> usages;
-    bool              has_wait_semaphore   = false;
-    bool              has_signal_semaphore = false;
+// neighboring shared reads of a record on the same queue and in the same
+// layout form a run. passes of a run are only ordered with the usages before
+// and after it, and every other usage is a run of its own
+bool isSameRun(const CompileBufferUsage &a, const CompileBufferUsage &b);
+bool isSameRun(const CompileImageUsage &a, const CompileImageUsage &b);
 
-    Map<CompilePass *, List<CompileBufferUsage>::iterator> pass_to_usage;
-};
+bool hasLayoutTransition(
+    const CompileBufferUsage &prev, const CompileBufferUsage &usage);
+bool hasLayoutTransition(
+    const CompileImageUsage &prev, const CompileImageUsage &usage);
 
-struct CompileImage
+// first must be the first usage of a run. a run starting with a layout
+// transition ends right after it, so that only one pass transitions
+template<typename Usages, typename It>
+It getRunEnd(Usages &usages, It first)
 {
-    explicit CompileImage(std::pmr::memory_resource &memory);
-
-    List<CompileImageUsage> usages;
-    bool             has_wait_semaphore = false;
-    bool             has_signal_semaphore = false;
-
-    Map<CompilePass *, List<CompileImageUsage>::iterator> pass_to_usage;
-};
-
-using CompileResource = agz::misc::variant_t<Buffer, ImageSubresource>;
+    auto last = std::next(first);
+    if(first != usages.begin() && hasLayoutTransition(*std::prev(first), *first))
+        return last;
+    while(last != usages.end() && isSameRun(*std::prev(last), *last))
+        ++last;
+    return last;
+}
+
+template<typename Usages, typename It>
+It getRunBegin(Usages &usages, It it)
+{
+    auto first = it;
+    while(first != usages.begin() && isSameRun(*std::prev(first), *first))
+        --first;
+    if(first != it && first != usages.begin() &&
+       hasLayoutTransition(*std::prev(first), *first))
+        ++first;
+    return first;
+}
+
+// usages that must happen before the given one: the run right before its
+// own run. empty for usages of the first run
+template<typename Usages, typename It>
+std::pair<It, It> getPrevRun(Usages &usages, It it)
+{
+    auto first = getRunBegin(usages, it);
+    if(first == usages.begin())
+        return { first, first };
+    return { getRunBegin(usages, std::prev(first)), first };
+}
 
 struct GlobalGroupDependency
 {
@@ -2,6 +2,7 @@
 
 #include <vkpt/graph/compile_internal.h>
 #include <vkpt/graph/executor.h>
+#include <vkpt/graph/group_barrier_generator.h>
 #include <vkpt/graph/resource_records.h>
 #include <vkpt/graph/transitive_closure.h>
 
@@ -13,29 +14,102 @@ public:
 
     Compiler();
 
+    // compile-time memory is pooled on top of upstream.
+    // if thread_pool is not null, phases independent per resource or per
+    // group run on it, and the result doesn't depend on the thread count.
+    // the result is only filled concurrently when it's allocated from the
+    // compiler's own memory, as other memory may not be thread-safe
+    explicit Compiler(
+        std::pmr::memory_resource &upstream,
+        ThreadPool                *thread_pool = nullptr);
+
     void setMessenger(std::function<void(const std::string &)> func);
 
     ExecutableGraph compile(
         SemaphoreAllocator &semaphore_allocator,
         const Graph        &graph);
 
+    // result is allocated from output_memory instead of the compiler's own
+    // memory, so that it can outlive the compiler
+    ExecutableGraph compile(
+        SemaphoreAllocator        &semaphore_allocator,
+        const Graph               &graph,
+        std::pmr::memory_resource &output_memory);
+
+    // must be set before compile. passes are compiled as if they were all
+    // enabled, and what recompile needs is kept after compiling
+    void setIncremental(bool incremental);
+
+    // apply the current enable states of graph's passes to result, which
+    // must be the result of the last compile in incremental mode. graph must
+    // have the compiled structure, up to enable states and handles.
+    // disabled passes are removed from their groups, and only groups using
+    // resources of passes whose states changed are filled again. their
+    // indices are stored in dirty_groups in increasing order, and their
+    // barriers refer to the resources of the compiled graph.
+    // returns false without changing anything if the new states need join
+    // passes, semaphores or inter-group arcs the compiled graph doesn't have.
+    // runs on the thread pool given at construction, not on graph's
+    bool recompile(
+        const Graph     &graph,
+        ExecutableGraph &result,
+        Vector<int>     &dirty_groups);
+
 private:
 
+    struct IncrementalState;
+
+    // Queue objects wrapping the same VkQueue are treated as one queue, so
+    // that no group boundary or semaphore is generated between them
+    const Queue *getCanonicalQueue(const Queue *queue);
+
+    void canonicalizeGeneratedPassQueues();
+
     void initializeCompilePasses(const Graph &graph);
 
+    Set<CompilePass *> findDisabledPasses(const Graph &graph);
+
+    void removeDisabledPasses(const Graph &graph);
+
+    void inferDependencies();
+
+    // removed passes are not roots, but their ancestors are found through
+    // them, as if their heads were connected to their tails
+    Set<CompilePass *> findLivePasses(
+        const Graph              &graph,
+        const Set<CompilePass *> &removed_passes);
+
+    void cullDeadPasses(const Graph &graph);
+
     void topologySortCompilePasses();
+
+    void assignQueues(const Graph &graph);
     
     void buildTransitiveClosure();
 
-    void collectResourceUsages();
+    void collectResourceUsages(const Graph &graph);
 
-    template<typename Rsc>
-    void processUnwaitedFirstUsage(const Rsc &resource);
+    // passes of a run of reads are not ordered with each other. adds join
+    // passes and arcs so that the usage walk can treat every run as a whole
+    void mergeNeighboringReadOnlyUsages(const Graph &graph);
 
-    template<typename Rsc>
-    void processUnsignaledFinalState(const Rsc &rsc);
+    void validateResourceUsageOrder();
 
-    void mergeNeighboringReadOnlyUsages();
+    template<typename Usage>
+    bool needsEntryJoin(const ResourceState &state, const Usage &first_usage);
+
+    // whether usages left by recompile fit the compiled structure
+    template<typename Usages>
+    bool keepsStructure(
+        Usages                   &usages,
+        const ResourceState      &state,
+        GlobalGroupDependencyLUT &dependencies);
+
+    template<typename Record>
+    void processUnwaitedFirstUsage(Record &record, const ResourceState &state);
+
+    template<typename Record>
+    void processUnsignaledFinalState(Record &record);
 
     void mergeGeneratedPreAndPostPasses();
 
@@ -52,19 +126,31 @@ private:
 
     void topologySortPassesInGroup(CompileGroup *group);
 
-    void fillInterGroupSemaphores(SemaphoreAllocator &allocator);
+    bool isSingleQueue() const;
+
+    void buildSingleGroup();
 
-    void buildPassToUsage(CompileBuffer &record);
+    void fillInterGroupSemaphores(SemaphoreAllocator &allocator);
 
-    void buildPassToUsage(CompileImage &record);
+    // one per thread, each caching its own group dependencies
+    Vector<GroupBarrierGenerator> createBarrierGenerators(const Graph &graph);
 
     void fillExecutableGroup(
         const CompileGroup &group, ExecutableGroup &output);
 
-    std::pmr::unsynchronized_pool_resource memory_;
-    agz::alloc::obj_arena_t                arena_;
+    std::optional<std::pmr::unsynchronized_pool_resource> unsynchronized_memory_;
+    std::optional<std::pmr::synchronized_pool_resource>   synchronized_memory_;
 
-    Set<CompilePass *>    compile_passes_;
+    std::pmr::memory_resource    &memory_;
+    agz::alloc::object_releaser_t arena_;
+
+    ThreadPool *thread_pool_;
+
+    std::pmr::memory_resource *output_memory_;
+
+    HashMap<VkQueue, const Queue *> canonical_queues_;
+
+    Vector<CompilePass *> compile_passes_;
     Vector<CompilePass *> sorted_compile_passes_;
 
     Vector<CompileGroup *> compile_groups_;
@@ -76,8 +162,10 @@ private:
 
     ResourceRecords resource_records_;
 
-    Map<Buffer, ResourceState>           buffer_final_states_;
-    Map<ImageSubresource, ResourceState> image_final_states_;
+    Map<Buffer, ResourceState>                buffer_final_states_;
+    Map<ImageSubresourceRange, ResourceState> image_final_states_;
+
+    IncrementalState *incremental_;
 };
 
 VKPT_GRAPH_END
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <span>
+
 #include <vkpt/graph/graph.h>
+#include <vkpt/utility/thread_pool.h>
 
 VKPT_GRAPH_BEGIN
 
@@ -17,14 +20,29 @@ struct ExecutablePass
     std::optional<vk::MemoryBarrier2KHR> post_memory_barrier;
     Vector<vk::BufferMemoryBarrier2KHR>  post_buffer_barriers;
     Vector<vk::ImageMemoryBarrier2KHR>   post_image_barriers;
+
+    // indices into ExecutableGroup::events
+    Vector<int> set_events;
+    Vector<int> wait_events;
+};
+
+// split barrier. set after a pass and waited before a later pass of the
+// same group
+struct ExecutableEvent
+{
+    explicit ExecutableEvent(std::pmr::memory_resource &memory);
+
+    Vector<vk::BufferMemoryBarrier2KHR> buffer_barriers;
+    Vector<vk::ImageMemoryBarrier2KHR>  image_barriers;
 };
 
 struct ExecutableGroup
 {
     explicit ExecutableGroup(std::pmr::memory_resource &memory);
 
-    const Queue           *queue;
-    Vector<ExecutablePass> passes;
+    const Queue            *queue;
+    Vector<ExecutablePass>  passes;
+    Vector<ExecutableEvent> events;
 
     Vector<vk::SemaphoreSubmitInfoKHR> wait_semaphores;
     Vector<vk::SemaphoreSubmitInfoKHR> signal_semaphores;
@@ -37,8 +55,8 @@ struct ExecutableGraph
 
     Vector<ExecutableGroup> groups;
 
-    Map<Buffer, ResourceState>           buffer_final_states;
-    Map<ImageSubresource, ResourceState> image_final_states;
+    Map<Buffer, ResourceState>                buffer_final_states;
+    Map<ImageSubresourceRange, ResourceState> image_final_states;
 };
 
 class Executor
@@ -47,10 +65,35 @@ public:
 
     Executor();
 
+    explicit Executor(std::pmr::memory_resource &memory);
+
+    // events of split barriers are allocated from event_allocator. without
+    // it, split barriers are recorded as pipeline barriers before waiting
+    // passes
+    void setEventAllocator(EventAllocator *event_allocator);
+
+    // the last submit to each queue signals the frame timeline of that
+    // queue, so that no extra submit is needed at the end of frame
+    void setFrameSynchronizer(FrameSynchronizer *frame_synchronizer);
+
     void record(
         CommandBufferAllocator &command_buffer_allocator,
         const ExecutableGraph  &graph);
 
+    // record groups concurrently on thread_pool. each group is split into
+    // tasks of at most passes_per_task passes, every task being recorded
+    // into its own command buffers. command buffers are stitched back in
+    // pass order before submission.
+    //
+    // thread_allocators[i] is only used by the thread with index i, so
+    // allocators need no internal synchronization. onPassRender of
+    // different passes may be called concurrently
+    void record(
+        ThreadPool                               &thread_pool,
+        std::span<CommandBufferAllocator *const>  thread_allocators,
+        const ExecutableGraph                    &graph,
+        size_t                                    passes_per_task = 16);
+
     void submit();
 
 private:
@@ -59,9 +102,28 @@ private:
     {
         const ExecutableGroup                 *group;
         Vector<vk::CommandBufferSubmitInfoKHR> command_buffers;
+        Vector<vk::Event>                      events;
     };
 
-    agz::alloc::memory_resource_arena_t memory_;
+    void initializeGroupResults(const ExecutableGraph &graph);
+
+    static void recordPass(
+        PassContext          &context,
+        const GroupResult    &result,
+        const ExecutablePass &pass);
+
+    static void waitEvents(
+        PassContext          &context,
+        const GroupResult    &result,
+        const ExecutablePass &pass);
+
+    static void applyFinalStates(const ExecutableGraph &graph);
+
+    EventAllocator    *event_allocator_;
+    FrameSynchronizer *frame_synchronizer_;
+
+    agz::alloc::memory_resource_arena_t own_memory_;
+    std::pmr::memory_resource          &memory_;
     Vector<GroupResult>                 group_results_;
 };
 
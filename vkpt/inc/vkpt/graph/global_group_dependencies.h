@@ -13,15 +13,21 @@ public:
     const GlobalGroupDependency &getDependency(
         const CompileGroup *start, const CompileGroup *end);
 
+    // nullptr if end can't be reached from start through inter-group arcs
+    const GlobalGroupDependency *findDependency(
+        const CompileGroup *start, const CompileGroup *end);
+
 private:
 
     using Dependencies = Map<
         const CompileGroup *,
         Map<const CompileGroup *, GlobalGroupDependency>>;
 
+    const Map<const CompileGroup *, GlobalGroupDependency> &getDependencies(
+        const CompileGroup *start);
+
     std::pmr::memory_resource &memory_;
     Dependencies               dependencies_;
-    int                        traversal_index_ = 0;
 };
 
 VKPT_GRAPH_END
@@ -1,17 +1,27 @@
 #pragma once
 
+#include <span>
+
 #include <agz-utils/alloc.h>
 
 #include <vkpt/allocator/command_buffer_allocator.h>
+#include <vkpt/allocator/event_allocator.h>
 #include <vkpt/allocator/semaphore_allocator.h>
+#include <vkpt/frame/frame_synchronizer.h>
 #include <vkpt/graph/usage.h>
+#include <vkpt/object/framebuffer.h>
+#include <vkpt/object/pipeline.h>
 #include <vkpt/object/semaphore.h>
 #include <vkpt/resource/buffer.h>
 #include <vkpt/resource/image.h>
+#include <vkpt/utility/thread_pool.h>
 
 VKPT_GRAPH_BEGIN
 
 class Graph;
+class GraphCache;
+struct ExecutableGraph;
+class TransientResourcePool;
 class Compiler;
 
 class PassContext
@@ -22,6 +32,31 @@ public:
 
     CommandBuffer getCommandBuffer();
 
+    // allocate one begun secondary command buffer from each allocator.
+    // a buffer may be recorded on any thread as long as its allocator is not
+    // used by others meanwhile, so typically one allocator per thread.
+    // the buffers are ended and executed in allocation order by
+    // executeSecondaryCommandBuffers. buffers without render pass
+    // inheritance that are still pending after onPassRender are executed by
+    // the executor
+    std::vector<CommandBuffer> newSecondaryCommandBuffers(
+        std::span<CommandBufferAllocator *const> allocators,
+        const vk::CommandBufferInheritanceInfo  &inheritance = {});
+
+    // secondary command buffers continuing a subpass of pipeline's render
+    // pass, which must be begun with eSecondaryCommandBuffers contents.
+    // executeSecondaryCommandBuffers must be called before the render pass
+    // ends, otherwise the executor throws after onPassRender
+    std::vector<CommandBuffer> newSecondaryCommandBuffers(
+        std::span<CommandBufferAllocator *const> allocators,
+        const Pipeline                          &pipeline,
+        const Framebuffer                       &framebuffer,
+        uint32_t                                 subpass = 0);
+
+    void executeSecondaryCommandBuffers();
+
+    bool _hasPendingRenderPassSecondaries() const;
+
 private:
 
     friend class Executor;
@@ -34,6 +69,9 @@ private:
     Queue::Type                             queue_type_;
     CommandBufferAllocator                 &command_buffer_allocator_;
     Vector<vk::CommandBufferSubmitInfoKHR> &command_buffers_;
+
+    std::vector<vk::CommandBuffer> secondary_command_buffers_;
+    bool                           pending_render_pass_secondaries_ = false;
 };
 
 class PassBase
@@ -66,11 +104,33 @@ public:
 
     virtual void onPassRender(PassContext &context) = 0;
 
+    // a disabled pass is removed by the compiler, with its dependencies
+    // bridged so that the order of other passes is kept. with a GraphCache,
+    // toggling a pass only fills again the groups using its resources, and
+    // the joins and semaphores of the graph compiled with every pass enabled
+    // are kept.
+    // a disabled pass using a waited/signaled resource or signaling a fence
+    // is kept for the semaphore/fence, and only its render callback is skipped
+    void setEnabled(bool enabled);
+
+    bool isEnabled() const;
+
+    // allow the compiler to run this pass on queue instead of
+    // getPassQueue(), e.g. the async compute queue for a compute pass.
+    // estimated_duration is used by the compiler's cost model and is only
+    // meaningful relative to other passes
+    void setAlternativeQueue(
+        const Queue *queue, float estimated_duration = 1.0f);
+
+    const Queue *getAlternativeQueue() const;
+
+    float getEstimatedDuration() const;
+
     const Set<PassBase *> &_getTails() const { return tails_; }
     const Set<PassBase *> &_getHeads() const { return heads_; }
 
-    const Map<Buffer, BufferUsage>            &_getBufferUsages() const { return buffer_usages_; }
-    const Map<ImageSubresource, ImageUsage>   &_getImageUsages()  const { return image_usages_; }
+    const Map<Buffer, BufferUsage>                 &_getBufferUsages() const { return buffer_usages_; }
+    const Map<ImageSubresourceRange, ImageUsage>   &_getImageUsages()  const { return image_usages_; }
 
     const List<vk::Fence> &_getFences() const { return fences_; }
 
@@ -84,22 +144,32 @@ protected:
 
     void addBufferUsage(const Buffer &buffer, const BufferUsage &usage);
 
-    void addImageUsage(const ImageSubresource &image, const ImageUsage &usage);
+    void addImageUsage(const ImageSubresourceRange &image, const ImageUsage &usage);
 
     void addFence(vk::Fence fence);
 
 private:
 
     friend class Graph;
+    friend class GraphCache;
     friend class Compiler;
 
-    int index_ = -1;
+    int  index_   = -1;
+    bool enabled_ = true;
+
+    const Queue *alternative_queue_  = nullptr;
+    float        estimated_duration_ = 1.0f;
 
     Set<PassBase *> tails_;
     Set<PassBase *> heads_;
 
-    Map<Buffer, BufferUsage>          buffer_usages_;
-    Map<ImageSubresource, ImageUsage> image_usages_;
+    Map<Buffer, BufferUsage>               buffer_usages_;
+    Map<ImageSubresourceRange, ImageUsage> image_usages_;
+
+    // usages in declaration order. the maps above are ordered by handle
+    // address, which is not stable across frames
+    Vector<Map<Buffer, BufferUsage>::const_iterator>               buffer_usage_order_;
+    Vector<Map<ImageSubresourceRange, ImageUsage>::const_iterator> image_usage_order_;
 
     List<vk::Fence> fences_;
 };
@@ -168,6 +238,13 @@ public:
 
     Graph();
 
+    // all memory of the graph is allocated from memory, which also serves
+    // as the upstream of the compiler and executor when executing it.
+    // with FrameResources::getFrameMemory and a GraphCache, a graph built
+    // and executed every frame allocates nothing from the system once the
+    // frame arenas have grown to their steady size
+    explicit Graph(std::pmr::memory_resource &memory);
+
     void registerPass(PassBase *pass);
 
     Pass *addPass();
@@ -235,16 +312,84 @@ public:
     template<typename...Args>
     void addDependency(Args...passes);
 
+    // when enabled, the compiler adds dependencies between passes using
+    // overlapping parts of a resource, ordered by registration, when at
+    // least one of them writes it or changes the layout. passes reading a
+    // resource between two writes are left unordered. explicit
+    // dependencies are still honored and must not contradict the
+    // registration order of such passes
+    void setDependencyInferenceEnabled(bool enabled);
+
+    // when enabled, the compiler removes passes that cannot affect any graph
+    // output before grouping. a pass is kept if it signals a fence, writes a
+    // resource marked by markOutput, uses a waited or signaled resource,
+    // or is an ancestor of a kept pass
+    void setCullingEnabled(bool enabled);
+
+    // mark a resource whose content is consumed outside this graph,
+    // e.g. a persistent history buffer
+    void markOutput(const Buffer &buffer);
+
+    void markOutput(const Image &image);
+
+    // costs used when assigning passes with an alternative queue, in the
+    // same unit as pass durations. semaphore_cost is paid per dependency
+    // crossing queues and transfer_cost per resource changing queue family
+    void setQueueAssignmentCosts(float semaphore_cost, float transfer_cost);
+
+    // allow the compiler to move a pass whose queue or alternative queue is
+    // in queues to any other of them, e.g. over all hardware queues of the
+    // compute family, so that independent passes can run concurrently.
+    // queues are assigned with the same cost model as alternative queues
+    void addEquivalentQueues(std::span<const Queue *const> queues);
+
+    // bind memory to the pool's transient resources after compilation
+    void setTransientResourcePool(TransientResourcePool *pool);
+
+    // use events instead of pipeline barriers between passes of the same
+    // group when there are other passes between them, so that the device
+    // can execute these passes while waiting for the synchronization.
+    // events are allocated from event_allocator when executing the graph
+    void setEventAllocator(EventAllocator *event_allocator);
+
+    // signal the frame timelines of frame_synchronizer with the last submit
+    // to each queue. defaults to the frame synchronizer of the command
+    // buffer allocator given to execute, e.g. FrameResources
+    void setFrameSynchronizer(FrameSynchronizer *frame_synchronizer);
+
+    // run independent compilation phases on thread_pool
+    void setCompileThreadPool(ThreadPool *thread_pool);
+
+    // record groups concurrently on thread_pool when executing the graph,
+    // thread i allocating command buffers from thread_allocators[i]
+    // (see Executor::record and FrameResources::
+    // getThreadCommandBufferAllocators). the allocators are used instead
+    // of the command buffer allocator given to execute
+    void setRecordThreadPool(
+        ThreadPool                               *thread_pool,
+        std::span<CommandBufferAllocator *const>  thread_allocators,
+        size_t                                    passes_per_task = 16);
+
     void execute(
         SemaphoreAllocator          &semaphore_allocator,
         CommandBufferAllocator      &command_buffer_allocator,
         const std::function<void()> &after_record_callback = {});
 
+    // reuses the compiled graph cached in graph_cache when this graph has
+    // the same structure as a previously executed one
+    void execute(
+        GraphCache                  &graph_cache,
+        SemaphoreAllocator          &semaphore_allocator,
+        CommandBufferAllocator      &command_buffer_allocator,
+        const std::function<void()> &after_record_callback = {});
+
 private:
 
     friend class Compiler;
+    friend class GraphCache;
     friend class SemaphoreSignalHandler;
     friend class SemaphoreWaitHandler;
+    friend class TransientResourcePool;
 
     struct Signal
     {
@@ -256,16 +401,45 @@ private:
 
     void addDependency(std::initializer_list<PassBase *> passes);
 
-    agz::alloc::memory_resource_arena_t memory_;
+    // allocate transient resources for exec, then record and submit it.
+    // groups are recorded on the record thread pool when there is one,
+    // or with command_buffer_allocator otherwise
+    void executeCompiled(
+        ExecutableGraph             &exec,
+        CommandBufferAllocator      &command_buffer_allocator,
+        const std::function<void()> &after_record_callback);
+
+    agz::alloc::memory_resource_arena_t own_memory_;
+    std::pmr::memory_resource          &memory_;
     agz::alloc::object_releaser_t       arena_;
 
     List<PassBase *> passes_;
 
-    Map<Buffer, Semaphore>           buffer_waits_;
-    Map<ImageSubresource, Semaphore> image_waits_;
+    Map<Buffer, Semaphore>                buffer_waits_;
+    Map<ImageSubresourceRange, Semaphore> image_waits_;
+
+    Map<Buffer, Signal>                buffer_signals_;
+    Map<ImageSubresourceRange, Signal> image_signals_;
+
+    bool dependency_inference_enabled_;
+
+    bool        culling_enabled_;
+    Set<Buffer> output_buffers_;
+    Set<Image>  output_images_;
+
+    TransientResourcePool *transient_resource_pool_;
+    EventAllocator        *event_allocator_;
+    FrameSynchronizer     *frame_synchronizer_;
+    ThreadPool            *compile_thread_pool_;
+
+    ThreadPool                      *record_thread_pool_;
+    Vector<CommandBufferAllocator *> record_thread_allocators_;
+    size_t                           record_passes_per_task_;
+
+    float semaphore_cost_;
+    float transfer_cost_;
 
-    Map<Buffer, Signal>           buffer_signals_;
-    Map<ImageSubresource, Signal> image_signals_;
+    Vector<Vector<const Queue *>> equivalent_queues_;
 };
 
 template<typename...Args>
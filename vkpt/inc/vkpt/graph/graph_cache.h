@@ -0,0 +1,74 @@
+#pragma once
+
+#include <unordered_map>
+
+#include <vkpt/graph/executor.h>
+
+VKPT_GRAPH_BEGIN
+
+// caches compiled graphs across frames.
+// a graph is identified by its structure: pass topology & queues, resource
+// usages, waits/signals and incoming resource states, with every buffer,
+// image and semaphore replaced by the index of its first appearance.
+// on a hit, the cached executable graph is re-bound to the passes, resource
+// handles and semaphores of the new graph instead of being recompiled.
+// enable states of passes are not part of the structure. they are applied
+// to the graph compiled with all passes enabled by filling again only the
+// groups they affect. when they need other joins or semaphores, or no
+// such graph is cached, the graph is compiled for them and cached by
+// structure and enable states.
+class GraphCache : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit GraphCache(size_t max_entry_count = 16);
+
+    ~GraphCache();
+
+    // the returned graph may be modified until the next call
+    ExecutableGraph &getExecutableGraph(
+        SemaphoreAllocator &semaphore_allocator,
+        const Graph        &graph);
+
+    void clear();
+
+    size_t getEntryCount() const;
+
+private:
+
+    struct Bindings;
+    struct Entry;
+
+    void buildBindings(const Graph &graph);
+
+    Entry *findEntry(uint64_t hash) const;
+
+    Entry &createEntry(
+        SemaphoreAllocator &semaphore_allocator,
+        const Graph        &graph,
+        uint64_t            hash,
+        bool                incremental);
+
+    bool applyEnableStates(Entry &entry, const Graph &graph) const;
+
+    void createPatchSites(Entry &entry) const;
+
+    void addGroupSites(Entry &entry, uint32_t group_index) const;
+
+    void updatePatchSites(Entry &entry, const Vector<int> &dirty_groups) const;
+
+    void collectFinalStates(Entry &entry) const;
+
+    void rebind(SemaphoreAllocator &semaphore_allocator, Entry &entry) const;
+
+    void evict();
+
+    size_t   max_entry_count_;
+    uint64_t use_counter_;
+
+    std::unique_ptr<Bindings> bindings_;
+
+    std::unordered_multimap<uint64_t, std::unique_ptr<Entry>> entries_;
+};
+
+VKPT_GRAPH_END
@@ -9,11 +9,31 @@ class GroupBarrierGenerator
 {
 public:
 
+    // queue family release barriers belong to passes of other groups. they
+    // are collected here so that groups can be filled concurrently
+    struct ReleaseBarriers
+    {
+        explicit ReleaseBarriers(std::pmr::memory_resource &memory);
+
+        Vector<std::pair<CompilePass *, vk::BufferMemoryBarrier2KHR>> buffer_barriers;
+        Vector<std::pair<CompilePass *, vk::ImageMemoryBarrier2KHR>>  image_barriers;
+
+        // append barriers to post_ext barriers of their passes
+        void apply();
+
+        // only append barriers of passes in groups
+        void apply(const Set<CompileGroup *> &groups);
+    };
+
+    // when split_barriers is true, barriers between passes of the same group
+    // that have other passes in between are placed in events
     GroupBarrierGenerator(
         std::pmr::memory_resource &memory,
-        const ResourceRecords     &resource_records);
+        const ResourceRecords     &resource_records,
+        bool                       split_barriers = false);
 
-    void fillBarriers(CompileGroup *group);
+    // only modifies passes in group. release barriers are added to releases
+    void fillBarriers(CompileGroup *group, ReleaseBarriers &releases);
 
 private:
 
@@ -23,18 +43,26 @@ private:
     // if no such pass exists, returns B
     CompilePass *getBarrierPass(CompilePass *A, CompilePass *B);
 
+    // returns the event set after A and waited before B. create a new one if
+    // not found
+    CompileEvent &getEvent(CompilePass *A, CompilePass *B);
+
     bool shouldSkipBarrier(
         const Pass::BufferUsage &a, const Pass::BufferUsage &b) const;
 
     bool shouldSkipBarrier(
         const Pass::ImageUsage &a, const Pass::ImageUsage &b) const;
 
-    template<typename Resource, typename PassUsage>
+    template<typename Record, typename UsageIt>
     void handleResource(
-        CompilePass *pass, const Resource &rsc, const PassUsage &usage);
+        CompilePass     *pass,
+        const Record    &record,
+        UsageIt          usage_it,
+        ReleaseBarriers &releases);
 
     GlobalGroupDependencyLUT dependencies_;
     const ResourceRecords   &resource_records_;
+    bool                     split_barriers_;
 
     CompilePass *last_pass_with_pre_barrier_ = nullptr;
 };
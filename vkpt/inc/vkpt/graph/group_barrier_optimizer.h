@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vkpt/graph/resource_records.h>
+#include <vkpt/utility/thread_pool.h>
 
 VKPT_GRAPH_BEGIN
 
@@ -10,22 +11,27 @@ public:
 
     static bool isReadOnly(vk::AccessFlags2KHR access);
 
-    void optimize(ResourceRecords &records);
+    // records are processed on thread_pool if it's not null
+    void optimize(ResourceRecords &records, ThreadPool *thread_pool = nullptr);
     
     void optimize(CompileGroup *group);
 
-private:
-
+    // merge the usages of each run. done for all records by
+    // optimize(records)
     void mergeNeighboringUsages(CompileBuffer &record);
 
     void mergeNeighboringUsages(CompileImage &record);
 
+private:
+
     void movePreExtBarriers(CompileGroup *group);
 
     void movePostExtBarriers(CompileGroup *group);
 
     void mergePreAndPostBarriers(CompileGroup *group);
 
+    void mergeImageBarriers(CompileGroup *group);
+
     void convertBufferBarrierToGlobalMemoryBarrier(CompileGroup *group);
 };
 
@@ -3,35 +3,115 @@
 #include <span>
 
 #include <vkpt/graph/compile_internal.h>
+#include <vkpt/utility/thread_pool.h>
 
 VKPT_GRAPH_BEGIN
 
+// records are stored densely and identified by their index.
+// lookups by resource only happen when handling graph-level waits/signals.
+//
+// each (image, aspect) is partitioned into a grid of cells along the
+// boundaries of all ranges used on it and of differing initial states.
+// every used cell becomes one image record
 class ResourceRecords
 {
 public:
 
-    explicit ResourceRecords(std::pmr::memory_resource &memory);
+    ResourceRecords(std::pmr::memory_resource &memory, Messenger *messenger);
 
-    void build(std::span<CompilePass *> sorted_passes);
+    // extra_image_ranges are not used by passes but must not be split
+    // across records, e.g. waited/signaled ranges.
+    // image partitions are finalized on thread_pool if it's not null,
+    // which requires the memory resource to be thread-safe
+    void build(
+        std::span<CompilePass *>               sorted_passes,
+        std::span<const ImageSubresourceRange> extra_image_ranges,
+        ThreadPool                            *thread_pool = nullptr);
 
-    Map<Buffer, CompileBuffer> &getBuffers();
+    // fill CompilePass::buffer_usages/image_usages.
+    // must be called after all usages are finalized
+    void buildPassUsages();
 
-    Map<ImageSubresource, CompileImage> &getImages();
+    Vector<CompileBuffer> &getBuffers();
+
+    Vector<CompileImage> &getImages();
+
+    const Vector<CompileBuffer> &getBuffers() const;
+
+    const Vector<CompileImage> &getImages() const;
 
     CompileBuffer &getRecord(const Buffer &buffer);
 
-    CompileImage &getRecord(const ImageSubresource &image_subrsc);
+    // image_range must be the range of an existing record
+    CompileImage &getRecord(const ImageSubresourceRange &image_range);
 
     const CompileBuffer &getRecord(const Buffer &buffer) const;
 
-    const CompileImage &getRecord(const ImageSubresource &image_subrsc) const;
+    const CompileImage &getRecord(const ImageSubresourceRange &image_range) const;
+
+    // append indices of records covering image_range to output.
+    // returns false if part of the range is not used by any pass
+    bool getRecords(
+        const ImageSubresourceRange &image_range, Vector<int> &output) const;
 
 private:
 
+    struct ImagePartitionKey
+    {
+        VkImage            image;
+        VkImageAspectFlags aspect;
+
+        bool operator==(const ImagePartitionKey &) const = default;
+    };
+
+    struct ImagePartitionKeyHash
+    {
+        size_t operator()(const ImagePartitionKey &key) const;
+    };
+
+    struct ImagePartition
+    {
+        ImagePartition(
+            std::pmr::memory_resource &memory,
+            const Image               &image,
+            vk::ImageAspectFlagBits    aspect);
+
+        Image                   image;
+        vk::ImageAspectFlagBits aspect;
+
+        // sorted cell boundaries
+        Vector<uint32_t> mip_bounds;
+        Vector<uint32_t> layer_bounds;
+
+        // record index of each cell. -1 for unused cells
+        Vector<int> records;
+
+        // f(cell_index, vk::ImageSubresourceRange cell_range)
+        template<typename F>
+        void foreachCell(
+            const vk::ImageSubresourceRange &range, const F &f) const;
+
+        void addStateBounds();
+
+        void finalizeBounds();
+    };
+
+    ImagePartition &getPartition(
+        const Image &image, vk::ImageAspectFlagBits aspect);
+
+    const ImagePartition *findPartition(
+        const Image &image, vk::ImageAspectFlagBits aspect) const;
+
     std::pmr::memory_resource &memory_;
+    Messenger                 *messenger_;
+
+    Vector<CompileBuffer> compile_buffers_;
+    Vector<CompileImage>  compile_images_;
+
+    HashMap<VkBuffer, int> buffer_indices_;
 
-    Map<Buffer, CompileBuffer>          compile_buffers_;
-    Map<ImageSubresource, CompileImage> compile_images_;
+    Vector<ImagePartition>                                 image_partitions_;
+    HashMap<ImagePartitionKey, int, ImagePartitionKeyHash> image_partition_indices_;
 };
 
 VKPT_GRAPH_END
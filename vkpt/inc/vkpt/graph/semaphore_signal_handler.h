@@ -10,13 +10,16 @@ class SemaphoreSignalHandler : public agz::misc::uncopyable_t
 public:
 
     SemaphoreSignalHandler(
-        std::pmr::memory_resource            &memory,
-        const DAGTransitiveClosure           *closure,
-        Map<Buffer, ResourceState>           &buffer_final_states,
-        Map<ImageSubresource, ResourceState> &image_final_states,
-        std::function<CompilePass*()>         create_post_pass);
-
-    void collectSignalingSemaphores(const Graph &graph);
+        std::pmr::memory_resource                 &memory,
+        Messenger                                 *messenger,
+        const DAGTransitiveClosure                *closure,
+        Map<Buffer, ResourceState>                &buffer_final_states,
+        Map<ImageSubresourceRange, ResourceState> &image_final_states,
+        std::function<CompilePass*()>              create_post_pass);
+
+    void collectSignalingSemaphores(
+        const Graph           &graph,
+        const ResourceRecords &resource_records);
     
     void processSignalingSemaphores(
         ResourceRecords &resource_records,
@@ -42,10 +45,14 @@ private:
     std::pmr::memory_resource            &memory_;
     Map<Semaphore, List<CompileResource>> signaling_semaphore_to_resources_;
 
-    const DAGTransitiveClosure           *closure_;
-    Map<Buffer, ResourceState>           &buffer_final_states_;
-    Map<ImageSubresource, ResourceState> &image_final_states_;
-    std::function<CompilePass *()>        create_post_pass_;
+    // image record index -> signal of the range containing it
+    HashMap<int, const Graph::Signal *> image_signals_;
+
+    Messenger                                 *messenger_;
+    const DAGTransitiveClosure                *closure_;
+    Map<Buffer, ResourceState>                &buffer_final_states_;
+    Map<ImageSubresourceRange, ResourceState> &image_final_states_;
+    std::function<CompilePass *()>             create_post_pass_;
 };
 
 VKPT_GRAPH_END
@@ -15,7 +15,9 @@ public:
         const DAGTransitiveClosure   *closure,
         std::function<CompilePass*()> create_pre_pass);
 
-    void collectWaitingSemaphores(const Graph &graph);
+    void collectWaitingSemaphores(
+        const Graph           &graph,
+        const ResourceRecords &resource_records);
 
     void processWaitingSemaphores(ResourceRecords &resource_records);
 
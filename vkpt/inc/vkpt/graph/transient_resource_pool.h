@@ -0,0 +1,110 @@
+#pragma once
+
+#include <unordered_map>
+
+#include <vkpt/allocator/resource_allocator.h>
+#include <vkpt/graph/executor.h>
+
+VKPT_GRAPH_BEGIN
+
+// creates images/buffers whose memory is bound only when the graph using
+// them is executed. their lifetimes are computed from the executable graph
+// and resources with disjoint lifetimes on the same queue share memory.
+//
+// a transient resource must not be used before the graph using it is
+// executed (e.g. views must be created in pass callbacks), and its content
+// is undefined at its first usage
+class TransientResourcePool : public agz::misc::uncopyable_t
+{
+public:
+
+    TransientResourcePool();
+
+    TransientResourcePool(
+        ResourceAllocator &resource_allocator, int frame_count);
+
+    TransientResourcePool(TransientResourcePool &&other) noexcept;
+
+    TransientResourcePool &operator=(TransientResourcePool &&other) noexcept;
+
+    ~TransientResourcePool();
+
+    operator bool() const;
+
+    void swap(TransientResourcePool &other) noexcept;
+
+    void newFrame();
+
+    Buffer newBuffer(const vk::BufferCreateInfo &create_info);
+
+    Image newImage(const vk::ImageCreateInfo &create_info);
+
+    // bind memory to transient resources used by graph, and add the
+    // barriers required between resources sharing memory to exec.
+    // these barriers only hold for this execution, so they must be removed
+    // by restoreBarriers once exec is recorded, as exec may be a cached
+    // graph executed again with other resources
+    void allocate(const Graph &graph, ExecutableGraph &exec);
+
+    // undo the barrier changes made by the last allocate
+    void restoreBarriers();
+
+private:
+
+    struct Resource
+    {
+        Buffer                 buffer;
+        Image                  image;
+        vk::MemoryRequirements requirements;
+        bool                   linear = false;
+        bool                   bound  = false;
+    };
+
+    struct Heap
+    {
+        uint32_t       memory_type_bits = 0;
+        vk::DeviceSize size             = 0;
+        vk::DeviceSize alignment        = 1;
+        VmaAllocation  allocation       = nullptr;
+        bool           in_use           = false;
+    };
+
+    struct PerFrame
+    {
+        std::vector<Resource> resources;
+        std::vector<Heap>     heaps;
+    };
+
+    struct Lifetime;
+
+    struct ImageBarrierPatch
+    {
+        ExecutablePass            *pass;
+        size_t                     barrier;
+        vk::PipelineStageFlags2KHR src_stages;
+        vk::AccessFlags2KHR        src_access;
+    };
+
+    struct MemoryBarrierPatch
+    {
+        ExecutablePass                      *pass;
+        std::optional<vk::MemoryBarrier2KHR> barrier;
+    };
+
+    VmaAllocation getHeap(
+        uint32_t       memory_type_bits,
+        vk::DeviceSize size,
+        vk::DeviceSize alignment);
+
+    void freeHeaps(PerFrame &frame, bool only_unused);
+
+    ResourceAllocator *resource_allocator_;
+
+    int                   frame_index_;
+    std::vector<PerFrame> frames_;
+
+    std::vector<ImageBarrierPatch>  image_barrier_patches_;
+    std::vector<MemoryBarrierPatch> memory_barrier_patches_;
+};
+
+VKPT_GRAPH_END
@@ -6,6 +6,8 @@
 
 VKPT_GRAPH_BEGIN
 
+// vertices must be numbered in topological order, i.e. head < tail for
+// every arc
 class DAGTransitiveClosure
 {
 public:
@@ -23,8 +25,9 @@ private:
 
     // bitmap_[head * line].bits[tail] stores isReachable(head, tail)
 
+    int              vertex_count_;
     int              line_;
-    Vector<uint32_t> bitmap_;
+    Vector<uint64_t> bitmap_;
 
     Vector<Vector<int>> direct_neighbors_;
 };
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 #include <vkpt/command_buffer.h>
 
 VKPT_BEGIN
@@ -16,24 +19,39 @@ public:
         Present  = 3
     };
 
+    // should be shared by Queue objects wrapping the same VkQueue. mutex is
+    // locked by submit/present, as VkQueue access must be externally
+    // synchronized, and submits are counted per VkQueue
+    struct SubmitState
+    {
+        std::mutex            mutex;
+        std::atomic<uint64_t> submit_count = 0;
+    };
+
     Queue();
 
+    // a queue without submit_state gets its own
     Queue(
-        vk::Device device,
-        vk::Queue  raw_queue,
-        Type       type,
-        uint32_t   family_index);
+        vk::Device                   device,
+        vk::Queue                    raw_queue,
+        Type                         type,
+        uint32_t                     family_index,
+        std::shared_ptr<SubmitState> submit_state = {});
 
     operator bool() const;
 
-    vk::Device getDevice();
+    vk::Device getDevice() const;
 
-    vk::Queue getRaw();
+    vk::Queue getRaw() const;
 
     Type getType() const;
 
     uint32_t getFamilyIndex() const;
 
+    // number of submit calls carrying at least one submit, made through
+    // all Queue objects sharing the submit state of this one
+    uint64_t getSubmitCount() const;
+
     void submit(
         vk::ArrayProxy<const vk::Semaphore>          wait_semaphores,
         vk::ArrayProxy<const vk::PipelineStageFlags> wait_stages,
@@ -47,14 +65,29 @@ public:
         vk::ArrayProxy<const vk::CommandBufferSubmitInfoKHR> command_buffers,
         vk::Fence                                            fence) const;
 
+    // submits are executed in order. fence is signaled when all of them
+    // are complete. with no submits, fence is signaled after all work
+    // previously submitted to this queue
+    void submit(
+        vk::ArrayProxy<const vk::SubmitInfo2KHR> submits,
+        vk::Fence                                fence) const;
+
+    vk::Result present(const vk::PresentInfoKHR &present_info) const;
+
     auto operator<=>(const Queue &rhs) const { return queue_ <=> rhs.queue_; }
 
 private:
 
+    std::unique_lock<std::mutex> lockSubmission() const;
+
+    void countSubmission() const;
+
     vk::Device device_;
     vk::Queue  queue_;
     Type       type_;
     uint32_t   family_index_;
+
+    std::shared_ptr<SubmitState> submit_state_;
 };
 
 inline Queue::Queue()
@@ -64,14 +97,18 @@ inline Queue::Queue()
 }
 
 inline Queue::Queue(
-    vk::Device device,
-    vk::Queue  raw_queue,
-    Type       type,
-    uint32_t   family_index)
+    vk::Device                   device,
+    vk::Queue                    raw_queue,
+    Type                         type,
+    uint32_t                     family_index,
+    std::shared_ptr<SubmitState> submit_state)
     : device_(device), queue_(raw_queue),
-      type_(type), family_index_(family_index)
+      type_(type), family_index_(family_index),
+      submit_state_(std::move(submit_state))
 {
     assert(!device == !raw_queue);
+    if(!submit_state_)
+        submit_state_ = std::make_shared<SubmitState>();
 }
 
 inline Queue::operator bool() const
@@ -79,12 +116,12 @@ inline Queue::operator bool() const
     return !!queue_;
 }
 
-inline vk::Device Queue::getDevice()
+inline vk::Device Queue::getDevice() const
 {
     return device_;
 }
 
-inline vk::Queue Queue::getRaw()
+inline vk::Queue Queue::getRaw() const
 {
     return queue_;
 }
@@ -99,6 +136,11 @@ inline uint32_t Queue::getFamilyIndex() const
     return family_index_;
 }
 
+inline uint64_t Queue::getSubmitCount() const
+{
+    return submit_state_->submit_count;
+}
+
 inline void Queue::submit(
     vk::ArrayProxy<const vk::Semaphore>          wait_semaphores,
     vk::ArrayProxy<const vk::PipelineStageFlags> wait_stages,
@@ -112,6 +154,8 @@ inline void Queue::submit(
     for(uint32_t i = 0; i < command_buffers.size(); ++i)
         raw_command_buffers[i] = command_buffers.data()[i].getRaw();
 
+    auto lock = lockSubmission();
+    countSubmission();
     queue_.submit(
     {
         vk::SubmitInfo{
@@ -132,6 +176,8 @@ inline void Queue::submit(
     vk::ArrayProxy<const vk::CommandBufferSubmitInfoKHR> command_buffers,
     vk::Fence                                            fence) const
 {
+    auto lock = lockSubmission();
+    countSubmission();
     queue_.submit2KHR(
     {
         vk::SubmitInfo2KHR{
@@ -145,4 +191,30 @@ inline void Queue::submit(
     }, fence);
 }
 
+inline void Queue::submit(
+    vk::ArrayProxy<const vk::SubmitInfo2KHR> submits,
+    vk::Fence                                fence) const
+{
+    auto lock = lockSubmission();
+    if(!submits.empty())
+        countSubmission();
+    queue_.submit2KHR(submits, fence);
+}
+
+inline vk::Result Queue::present(const vk::PresentInfoKHR &present_info) const
+{
+    auto lock = lockSubmission();
+    return queue_.presentKHR(present_info);
+}
+
+inline std::unique_lock<std::mutex> Queue::lockSubmission() const
+{
+    return std::unique_lock(submit_state_->mutex);
+}
+
+inline void Queue::countSubmission() const
+{
+    ++submit_state_->submit_count;
+}
+
 VKPT_END
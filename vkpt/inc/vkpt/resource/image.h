@@ -77,6 +77,18 @@ struct ImageSubresource
     auto operator<=>(const ImageSubresource &) const = default;
 };
 
+struct ImageSubresourceRange
+{
+    Image                     image;
+    vk::ImageSubresourceRange range;
+
+    vk::Image get() const;
+
+    const std::string &getName() const;
+
+    auto operator<=>(const ImageSubresourceRange &) const = default;
+};
+
 class ImageView
 {
 public:
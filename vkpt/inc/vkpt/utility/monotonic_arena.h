@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+
+#include <vkpt/common.h>
+
+VKPT_BEGIN
+
+// bump allocator whose blocks are kept across resets. deallocation is a
+// no-op, and reset makes all memory available again without returning it
+// to the system, so a steady workload stops allocating after warm-up.
+// not thread-safe
+class MonotonicArena :
+    public std::pmr::memory_resource, public agz::misc::uncopyable_t
+{
+public:
+
+    explicit MonotonicArena(size_t initial_block_size = 64 * 1024);
+
+    MonotonicArena(MonotonicArena &&other) noexcept;
+
+    MonotonicArena &operator=(MonotonicArena &&other) noexcept;
+
+    ~MonotonicArena() override;
+
+    void swap(MonotonicArena &other) noexcept;
+
+    // all memory allocated before is invalidated. if more than one block
+    // was used since the last reset, blocks are merged into a single one
+    void reset();
+
+    size_t getCapacity() const;
+
+private:
+
+    struct Block
+    {
+        std::byte *data;
+        size_t     size;
+    };
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void *ptr, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const memory_resource &other) const noexcept override;
+
+    void releaseBlocks();
+
+    size_t initial_block_size_;
+
+    std::vector<Block> blocks_;
+    size_t             block_index_;
+    size_t             offset_;
+};
+
+VKPT_END
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <vkpt/common.h>
+
+VKPT_BEGIN
+
+// fixed set of worker threads running parallel-for style jobs.
+// the calling thread participates in each job, so a pool with n workers
+// hands out thread indices in [0, n]
+class ThreadPool : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit ThreadPool(uint32_t worker_count);
+
+    ~ThreadPool();
+
+    uint32_t getThreadCount() const;
+
+    // call func(thread_index, task_index) for each task in [0, task_count).
+    // blocks until all tasks are done. the first exception thrown by any
+    // task is rethrown here.
+    //
+    // not reentrant: a job shares the pool's state, so func (e.g. a pass
+    // callback during parallel recording) must not call parallelFor on the
+    // same pool, and only one thread may start jobs at a time
+    void parallelFor(
+        size_t                                       task_count,
+        const std::function<void(uint32_t, size_t)> &func);
+
+private:
+
+    void workerMain(uint32_t thread_index);
+
+    void runTasks(uint32_t thread_index);
+
+    std::vector<std::thread> workers_;
+
+    std::mutex              mutex_;
+    std::condition_variable start_cond_;
+    std::condition_variable finish_cond_;
+
+    bool     stop_;
+    uint64_t job_index_;
+    uint32_t running_workers_;
+
+    const std::function<void(uint32_t, size_t)> *func_;
+    size_t                                       task_count_;
+    std::atomic<size_t>                          next_task_;
+    std::exception_ptr                           exception_;
+};
+
+// run on thread_pool, or on the calling thread as thread 0 if thread_pool
+// is null
+void parallelFor(
+    ThreadPool                                  *thread_pool,
+    size_t                                       task_count,
+    const std::function<void(uint32_t, size_t)> &func);
+
+VKPT_END
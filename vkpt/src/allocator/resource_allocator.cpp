@@ -153,6 +153,143 @@ Image ResourceAllocator::createImage(
     return result;
 }
 
+Buffer ResourceAllocator::createUnboundBuffer(
+    const vk::BufferCreateInfo &create_info)
+{
+    auto buffer = device_.createBuffer(create_info);
+
+    const Buffer::Description description = {
+        .size         = create_info.size,
+        .usage        = create_info.usage,
+        .sharing_mode = create_info.sharingMode
+    };
+
+    auto raw_impl = new Buffer::Impl{
+        .device      = device_,
+        .buffer      = buffer,
+        .description = description,
+        .state       = FreeState{}
+    };
+
+    auto impl = std::shared_ptr<Buffer::Impl>(
+        raw_impl, [device = device_](Buffer::Impl *p)
+    {
+        assert(p && p->buffer);
+        device.destroyBuffer(p->buffer);
+        delete p;
+    });
+
+    Buffer result;
+    result.impl_ = std::move(impl);
+    return result;
+}
+
+Image ResourceAllocator::createUnboundImage(
+    const vk::ImageCreateInfo &create_info)
+{
+    auto image = device_.createImage(create_info);
+
+    const Image::Description description = {
+        .type         = create_info.imageType,
+        .format       = create_info.format,
+        .samples      = create_info.samples,
+        .extent       = create_info.extent,
+        .sharing_mode = create_info.sharingMode,
+        .mip_levels   = create_info.mipLevels,
+        .array_layers = create_info.arrayLayers
+    };
+
+    auto raw_impl = new Image::Impl{
+        .device      = device_,
+        .image       = image,
+        .description = description
+    };
+
+    auto impl = std::shared_ptr<Image::Impl>(
+        raw_impl, [device = device_](Image::Impl *p)
+    {
+        assert(p && p->image);
+        device.destroyImage(p->image);
+        delete p;
+    });
+
+    raw_impl->initializeStateIndices();
+    const uint32_t state_count = raw_impl->A * create_info.arrayLayers;
+    raw_impl->state = std::make_unique<Image::State[]>(state_count);
+    for(uint32_t i = 0; i < state_count; ++i)
+        raw_impl->state[i] = FreeState{ create_info.initialLayout };
+
+    Image result;
+    result.impl_ = std::move(impl);
+    return result;
+}
+
+vk::MemoryRequirements ResourceAllocator::getMemoryRequirements(
+    const Buffer &buffer) const
+{
+    return device_.getBufferMemoryRequirements(buffer.get());
+}
+
+vk::MemoryRequirements ResourceAllocator::getMemoryRequirements(
+    const Image &image) const
+{
+    return device_.getImageMemoryRequirements(image.get());
+}
+
+VmaAllocation ResourceAllocator::allocateMemory(
+    const vk::MemoryRequirements &requirements, vma::MemoryUsage usage)
+{
+    const VkMemoryRequirements vk_requirements = requirements;
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage = static_cast<VmaMemoryUsage>(usage);
+
+    VmaAllocation allocation;
+    auto rt = vmaAllocateMemory(
+        allocator_, &vk_requirements, &alloc_info, &allocation, nullptr);
+    if(rt != VK_SUCCESS)
+    {
+        throw VKPTException(
+            "failed to allocate vma memory. err code is " +
+            std::to_string(rt));
+    }
+
+    return allocation;
+}
+
+void ResourceAllocator::freeMemory(VmaAllocation allocation)
+{
+    vmaFreeMemory(allocator_, allocation);
+}
+
+void ResourceAllocator::bindMemory(
+    const Buffer &buffer, VmaAllocation allocation, vk::DeviceSize offset)
+{
+    auto rt = vmaBindBufferMemory2(
+        allocator_, allocation, offset,
+        static_cast<VkBuffer>(buffer.get()), nullptr);
+    if(rt != VK_SUCCESS)
+    {
+        throw VKPTException(
+            "failed to bind buffer memory. err code is " +
+            std::to_string(rt));
+    }
+}
+
+void ResourceAllocator::bindMemory(
+    const Image &image, VmaAllocation allocation, vk::DeviceSize offset)
+{
+    auto rt = vmaBindImageMemory2(
+        allocator_, allocation, offset,
+        static_cast<VkImage>(image.get()), nullptr);
+    if(rt != VK_SUCCESS)
+    {
+        throw VKPTException(
+            "failed to bind image memory. err code is " +
+            std::to_string(rt));
+    }
+}
+
 void ResourceAllocator::swap(ResourceAllocator &other) noexcept
 {
     std::swap(device_, other.device_);
@@ -31,6 +31,22 @@ void CommandBuffer::begin(bool one_time_submit)
     });
 }
 
+void CommandBuffer::beginSecondary(
+    const vk::CommandBufferInheritanceInfo &inheritance,
+    bool                                    one_time_submit)
+{
+    vk::CommandBufferUsageFlags flags = {};
+    if(one_time_submit)
+        flags |= vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    if(inheritance.renderPass)
+        flags |= vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+
+    impl_.begin(vk::CommandBufferBeginInfo{
+        .flags            = flags,
+        .pInheritanceInfo = &inheritance
+    });
+}
+
 void CommandBuffer::end()
 {
     impl_.end();
@@ -39,7 +55,8 @@ void CommandBuffer::end()
 void CommandBuffer::beginPipeline(
     const Pipeline                      &pipeline,
     const Framebuffer                   &framebuffer,
-    vk::ArrayProxy<const vk::ClearValue> clear_values)
+    vk::ArrayProxy<const vk::ClearValue> clear_values,
+    vk::SubpassContents                  contents)
 {
     const auto &fb_desc = framebuffer.getDescription();
 
@@ -54,9 +71,12 @@ void CommandBuffer::beginPipeline(
         .renderArea      = render_area,
         .clearValueCount = clear_values.size(),
         .pClearValues    = clear_values.data()
-    }, vk::SubpassContents::eInline);
+    }, contents);
 
-    impl_.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+    // only executeCommands is allowed in a render pass whose contents are
+    // secondary command buffers
+    if(contents == vk::SubpassContents::eInline)
+        impl_.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
 }
 
 void CommandBuffer::endPipeline()
@@ -64,6 +84,12 @@ void CommandBuffer::endPipeline()
     impl_.endRenderPass();
 }
 
+void CommandBuffer::executeCommands(
+    vk::ArrayProxy<const vk::CommandBuffer> command_buffers)
+{
+    impl_.executeCommands(command_buffers);
+}
+
 void CommandBuffer::setViewport(vk::ArrayProxy<const vk::Viewport> viewports)
 {
     impl_.setViewport(0, viewports.size(), viewports.data());
@@ -133,4 +159,25 @@ void CommandBuffer::pipelineBarrier(
     });
 }
 
+void CommandBuffer::setEvent(
+    vk::Event                                         event,
+    vk::ArrayProxy<const vk::BufferMemoryBarrier2KHR> buffer_barriers,
+    vk::ArrayProxy<const vk::ImageMemoryBarrier2KHR>  image_barriers)
+{
+    impl_.setEvent2KHR(event, vk::DependencyInfoKHR{
+        .bufferMemoryBarrierCount = buffer_barriers.size(),
+        .pBufferMemoryBarriers    = buffer_barriers.data(),
+        .imageMemoryBarrierCount  = image_barriers.size(),
+        .pImageMemoryBarriers     = image_barriers.data()
+    });
+}
+
+void CommandBuffer::waitEvents(
+    vk::ArrayProxy<const vk::Event>             events,
+    vk::ArrayProxy<const vk::DependencyInfoKHR> dependency_infos)
+{
+    assert(events.size() == dependency_infos.size());
+    impl_.waitEvents2KHR(events, dependency_infos);
+}
+
 VKPT_END
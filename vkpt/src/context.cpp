@@ -187,11 +187,14 @@ struct Context::VKBImpl
 Context::Context(const Description &desc)
 {
     image_count_ = desc.image_count;
+    headless_    = desc.headless;
 
-    initializeWindow(desc);
+    if(!headless_)
+        initializeWindow(desc);
     initializeVulkan(desc);
 
-    input_ = std::make_unique<Input>(window_);
+    if(window_)
+        input_ = std::make_unique<Input>(window_);
 }
 
 Context::~Context()
@@ -200,6 +203,10 @@ Context::~Context()
     {
         imgui_.reset();
         descriptor_set_manager_.reset();
+
+        // images of the virtual swapchain are owned by resource_allocator_
+        swapchain_image_views_.clear();
+        swapchain_images_.clear();
         resource_allocator_ = ResourceAllocator();
 
         swapchain_image_available_semaphores_.clear();
@@ -240,12 +247,34 @@ Input *Context::getInput()
     return input_.get();
 }
 
-void Context::swapBuffers()
+void Context::swapBuffers(FrameSynchronizer *frame_synchronizer)
 {
     auto present_semaphore = getPresentAvailableSemaphore().get();
+
+    if(headless_)
+    {
+        // consume the semaphore like a presentation engine would
+
+        const vk::SemaphoreSubmitInfoKHR wait_info = {
+            .semaphore = present_semaphore,
+            .stageMask = vk::PipelineStageFlagBits2KHR::eAllCommands
+        };
+
+        if(frame_synchronizer)
+        {
+            present_queue_.submit(
+                wait_info,
+                frame_synchronizer->newQueueSignal(&present_queue_),
+                {}, nullptr);
+        }
+        else
+            present_queue_.submit(wait_info, {}, {}, nullptr);
+        return;
+    }
+
     auto swapchain = swapchain_.get();
 
-    (void)present_queue_.getRaw().presentKHR(
+    (void)present_queue_.present(
         vk::PresentInfoKHR{
             .waitSemaphoreCount = 1,
             .pWaitSemaphores    = &present_semaphore,
@@ -269,22 +298,27 @@ TransientImages Context::createTransientImages()
 
 void Context::doEvents()
 {
-    glfwPollEvents();
+    if(window_)
+        glfwPollEvents();
 }
 
 void Context::waitEvents()
 {
-    glfwWaitEvents();
+    if(window_)
+        glfwWaitEvents();
 }
 
 void Context::waitFocus()
 {
-    while(glfwGetWindowAttrib(window_, GLFW_FOCUSED))
+    while(window_ && glfwGetWindowAttrib(window_, GLFW_FOCUSED))
         waitEvents();
 }
 
 bool Context::isMinimized() const
 {
+    if(!window_)
+        return false;
+
     int width, height;
     glfwGetFramebufferSize(window_, &width, &height);
     return width == 0 || height == 0;
@@ -292,12 +326,17 @@ bool Context::isMinimized() const
 
 bool Context::getCloseFlag() const
 {
+    if(!window_)
+        return close_flag_;
     return glfwWindowShouldClose(window_);
 }
 
 void Context::setCloseFlag(bool flag)
 {
-    glfwSetWindowShouldClose(window_, flag);
+    if(!window_)
+        close_flag_ = flag;
+    else
+        glfwSetWindowShouldClose(window_, flag);
 }
 
 vk::Device Context::getDevice()
@@ -305,6 +344,11 @@ vk::Device Context::getDevice()
     return device_;
 }
 
+bool Context::isHeadless() const
+{
+    return headless_;
+}
+
 vk::SwapchainKHR Context::getSwapchain()
 {
     return swapchain_.get();
@@ -320,6 +364,26 @@ Queue *Context::getComputeQueue()
     return &compute_queue_;
 }
 
+uint32_t Context::getGraphicsQueueCount() const
+{
+    return static_cast<uint32_t>(extra_graphics_queues_.size() + 1);
+}
+
+Queue *Context::getGraphicsQueue(uint32_t index)
+{
+    return index ? &extra_graphics_queues_[index - 1] : &graphics_queue_;
+}
+
+uint32_t Context::getComputeQueueCount() const
+{
+    return static_cast<uint32_t>(extra_compute_queues_.size() + 1);
+}
+
+Queue *Context::getComputeQueue(uint32_t index)
+{
+    return index ? &extra_compute_queues_[index - 1] : &compute_queue_;
+}
+
 Queue *Context::getPresentQueue()
 {
     return &present_queue_;
@@ -396,6 +460,10 @@ Pipeline Context::createGraphicsPipeline(const PipelineDescription &desc)
 
 void Context::recreateSwapchain()
 {
+    // virtual swapchain images never become out of date
+    if(headless_)
+        return;
+
     waitIdle();
     sender_.send(InvalidateSwapchain{});
 
@@ -409,28 +477,53 @@ void Context::recreateSwapchain()
     sender_.send(RecreateSwapchain{});
 }
 
-bool Context::acquireNextImage()
+bool Context::acquireNextImage(FrameSynchronizer *frame_synchronizer)
 {
     frame_resource_index_ = (frame_resource_index_ + 1) % image_count_;
 
     auto image_available_semaphore =
         swapchain_image_available_semaphores_[frame_resource_index_];
 
-    auto acquire_result = device_.acquireNextImageKHR(
-        swapchain_.get(), UINT64_MAX,
-        image_available_semaphore, nullptr, &image_index_);
-
-    if(acquire_result == vk::Result::eErrorOutOfDateKHR)
+    if(headless_)
     {
-        recreateSwapchain();
-        return false;
-    }
+        // images are used in turn. reusing one is safe once the frame
+        // resources of image_count_ frames ago are synchronized
 
-    if(acquire_result != vk::Result::eSuccess &&
-       acquire_result != vk::Result::eSuboptimalKHR)
+        image_index_ = (image_index_ + 1) % image_count_;
+
+        const vk::SemaphoreSubmitInfoKHR signal_info = {
+            .semaphore = image_available_semaphore.get(),
+            .stageMask = vk::PipelineStageFlagBits2KHR::eAllCommands
+        };
+
+        if(frame_synchronizer)
+        {
+            const auto frame_signal_info =
+                frame_synchronizer->newQueueSignal(&present_queue_);
+            present_queue_.submit(
+                {}, { signal_info, frame_signal_info }, {}, nullptr);
+        }
+        else
+            present_queue_.submit({}, signal_info, {}, nullptr);
+    }
+    else
     {
-        throw VKPTException(
-            "failed to acquire next swapchain image");
+        auto acquire_result = device_.acquireNextImageKHR(
+            swapchain_.get(), UINT64_MAX,
+            image_available_semaphore, nullptr, &image_index_);
+
+        if(acquire_result == vk::Result::eErrorOutOfDateKHR)
+        {
+            recreateSwapchain();
+            return false;
+        }
+
+        if(acquire_result != vk::Result::eSuccess &&
+           acquire_result != vk::Result::eSuboptimalKHR)
+        {
+            throw VKPTException(
+                "failed to acquire next swapchain image");
+        }
     }
 
     getImage().getState({ vk::ImageAspectFlagBits::eColor, 0, 0 }) =
@@ -617,6 +710,9 @@ void Context::initializeVulkan(const Description &desc)
         .set_app_name("vkpt")
         .require_api_version(1, 2);
 
+    if(headless_)
+        instance_builder.set_headless(true);
+
     if(desc.debug_layers)
     {
         instance_builder
@@ -634,28 +730,37 @@ void Context::initializeVulkan(const Description &desc)
 
     // surface
 
-    VkSurfaceKHR raw_surface;
-    const VkResult create_surface_result = glfwCreateWindowSurface(
-        impl_->instance.instance, window_, nullptr, &raw_surface);
-    if(create_surface_result != VK_SUCCESS)
-        throw VKPTException("failed to create vulkan surface");
-
-    using Deleter = vk::UniqueHandleTraits<
-        vk::SurfaceKHR, VULKAN_HPP_DEFAULT_DISPATCHER_TYPE>::deleter;
-    surface_ =
-        vk::UniqueSurfaceKHR(raw_surface, Deleter(impl_->instance.instance));
+    if(!headless_)
+    {
+        VkSurfaceKHR raw_surface;
+        const VkResult create_surface_result = glfwCreateWindowSurface(
+            impl_->instance.instance, window_, nullptr, &raw_surface);
+        if(create_surface_result != VK_SUCCESS)
+            throw VKPTException("failed to create vulkan surface");
+
+        using Deleter = vk::UniqueHandleTraits<
+            vk::SurfaceKHR, VULKAN_HPP_DEFAULT_DISPATCHER_TYPE>::deleter;
+        surface_ = vk::UniqueSurfaceKHR(
+            raw_surface, Deleter(impl_->instance.instance));
+    }
     
     // physical device
 
     vkb::PhysicalDeviceSelector physical_device_selector(impl_->instance);
 
     physical_device_selector
-        .set_surface(surface_.get())
         .prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
         .set_minimum_version(1, 2)
-        .add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)
-        .require_separate_compute_queue()
-        .require_dedicated_transfer_queue();
+        .add_required_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+    if(headless_)
+    {
+        // for the present layout used by graphs written for swapchains
+        physical_device_selector.add_desired_extension(
+            VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+    else
+        physical_device_selector.set_surface(surface_.get());
 
     physical_device_selector.add_required_extension(
         VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
@@ -683,9 +788,21 @@ void Context::initializeVulkan(const Description &desc)
     impl_->physical_device = select_physical_device_result.value();
     physical_device_ = impl_->physical_device.physical_device;
 
-    // device
+    // device. all queues of every family are created
+
+    const auto queue_families = impl_->physical_device.get_queue_families();
 
-    auto build_device_result = vkb::DeviceBuilder(impl_->physical_device).build();
+    std::vector<vkb::CustomQueueDescription> queue_descs;
+    for(uint32_t i = 0; i < queue_families.size(); ++i)
+    {
+        const uint32_t count = queue_families[i].queueCount;
+        queue_descs.emplace_back(i, count, std::vector<float>(count, 1.0f));
+    }
+
+    vkb::DeviceBuilder device_builder(impl_->physical_device);
+    device_builder.custom_queue_setup(queue_descs);
+
+    auto build_device_result = device_builder.build();
     if(!build_device_result)
         throw VKPTException("failed to create vulkan device");
     impl_->device = build_device_result.value();
@@ -695,31 +812,82 @@ void Context::initializeVulkan(const Description &desc)
     device_ = impl_->device.device;
 
     auto graphics_queue = impl_->device.get_queue(vkb::QueueType::graphics).value();
-    auto compute_queue  = impl_->device.get_queue(vkb::QueueType::compute).value();
-    auto present_queue  = impl_->device.get_queue(vkb::QueueType::present).value();
-    auto transfer_queue = impl_->device.get_queue(vkb::QueueType::transfer).value();
-
     graphics_queue_family_ = impl_->device.get_queue_index(
         vkb::QueueType::graphics).value();
-    compute_queue_family_ = impl_->device.get_queue_index(
-        vkb::QueueType::compute).value();
-    present_queue_family_ = impl_->device.get_queue_index(
-        vkb::QueueType::present).value();
-    transfer_queue_family_ = impl_->device.get_queue_index(
-        vkb::QueueType::transfer).value();
-
-    graphics_queue_ = Queue(
-        device_, graphics_queue, Queue::Type::Graphics, graphics_queue_family_);
-    compute_queue_ = Queue(
-        device_, compute_queue, Queue::Type::Compute, compute_queue_family_);
-    present_queue_ = Queue(
-        device_, present_queue, Queue::Type::Present, present_queue_family_);
-    transfer_queue_ = Queue(
-        device_, transfer_queue, Queue::Type::Transfer, transfer_queue_family_);
+
+    // separate compute/transfer queues are used when the device has them.
+    // otherwise they alias the graphics queue, which the graph compiler
+    // treats as the same queue. so does the present queue in headless mode
+
+    auto get_queue = [&](vkb::QueueType type, uint32_t &family)
+    {
+        const bool use_graphics_queue =
+            type == vkb::QueueType::present ?
+            headless_ : !impl_->device.get_queue(type);
+
+        if(use_graphics_queue)
+        {
+            family = graphics_queue_family_;
+            return graphics_queue;
+        }
+        family = impl_->device.get_queue_index(type).value();
+        return impl_->device.get_queue(type).value();
+    };
+
+    auto compute_queue = get_queue(
+        vkb::QueueType::compute, compute_queue_family_);
+    auto present_queue = get_queue(
+        vkb::QueueType::present, present_queue_family_);
+    auto transfer_queue = get_queue(
+        vkb::QueueType::transfer, transfer_queue_family_);
+
+    // Queue objects sharing a VkQueue share its submit state
+
+    std::map<VkQueue, std::shared_ptr<Queue::SubmitState>> submit_states;
+
+    auto create_queue = [&](VkQueue raw_queue, Queue::Type type, uint32_t family)
+    {
+        auto &state = submit_states[raw_queue];
+        if(!state)
+            state = std::make_shared<Queue::SubmitState>();
+        return Queue(device_, raw_queue, type, family, state);
+    };
+
+    graphics_queue_ = create_queue(
+        graphics_queue, Queue::Type::Graphics, graphics_queue_family_);
+    compute_queue_ = create_queue(
+        compute_queue, Queue::Type::Compute, compute_queue_family_);
+    present_queue_ = create_queue(
+        present_queue, Queue::Type::Present, present_queue_family_);
+    transfer_queue_ = create_queue(
+        transfer_queue, Queue::Type::Transfer, transfer_queue_family_);
+
+    // other queues of graphics/compute families
+
+    for(uint32_t i = 1; i < queue_families[graphics_queue_family_].queueCount; ++i)
+    {
+        extra_graphics_queues_.push_back(create_queue(
+            device_.getQueue(graphics_queue_family_, i),
+            Queue::Type::Graphics, graphics_queue_family_));
+    }
+
+    // a compute queue aliasing the graphics family has no distinct extra
+    // queues: they are already exposed as extra graphics queues
+
+    if(compute_queue_family_ != graphics_queue_family_)
+    {
+        for(uint32_t i = 1; i < queue_families[compute_queue_family_].queueCount; ++i)
+        {
+            extra_compute_queues_.push_back(create_queue(
+                device_.getQueue(compute_queue_family_, i),
+                Queue::Type::Compute, compute_queue_family_));
+        }
+    }
 
     // swapchain
 
-    createSwapchain();
+    if(!headless_)
+        createSwapchain();
 
     // semaphores
 
@@ -731,13 +899,16 @@ void Context::initializeVulkan(const Description &desc)
     resource_allocator_ =
         ResourceAllocator(instance_, physical_device_, device_);
 
+    if(headless_)
+        createVirtualSwapchain(desc);
+
     // descriptor set manager
 
     descriptor_set_manager_ = std::make_unique<DescriptorSetManager>(device_);
 
     // imgui
 
-    if(desc.imgui)
+    if(desc.imgui && !headless_)
     {
         imgui_ = std::make_unique<ImGuiIntegration>(
             window_, instance_, physical_device_, device_, &graphics_queue_,
@@ -904,4 +1075,65 @@ void Context::createSwapchain()
     }
 }
 
+void Context::createVirtualSwapchain(const Description &desc)
+{
+    // same format as preferred for real swapchains, so that pipelines
+    // created for them can be used unchanged
+
+    const vk::ImageCreateInfo create_info = {
+        .imageType     = vk::ImageType::e2D,
+        .format        = vk::Format::eB8G8R8A8Srgb,
+        .extent        = {
+            static_cast<uint32_t>(desc.width),
+            static_cast<uint32_t>(desc.height),
+            1
+        },
+        .mipLevels     = 1,
+        .arrayLayers   = 1,
+        .samples       = vk::SampleCountFlagBits::e1,
+        .tiling        = vk::ImageTiling::eOptimal,
+        .usage         = vk::ImageUsageFlagBits::eColorAttachment |
+                         vk::ImageUsageFlagBits::eTransferSrc |
+                         vk::ImageUsageFlagBits::eTransferDst,
+        .sharingMode   = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined
+    };
+
+    swapchain_image_desc_ = Image::Description{
+        .type         = create_info.imageType,
+        .format       = create_info.format,
+        .samples      = create_info.samples,
+        .extent       = create_info.extent,
+        .sharing_mode = create_info.sharingMode,
+        .mip_levels   = create_info.mipLevels,
+        .array_layers = create_info.arrayLayers
+    };
+
+    // image_index_ is advanced before each acquisition
+    image_index_ = image_count_ - 1;
+
+    for(uint32_t i = 0; i < image_count_; ++i)
+    {
+        auto image = resource_allocator_.createImage(
+            create_info, vma::MemoryUsage::eGPUOnly);
+        swapchain_image_views_.push_back(
+            image.createView(
+                vk::ImageViewType::e2D,
+                vk::ImageSubresourceRange{
+                    .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel   = 0,
+                    .levelCount     = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount     = 1
+                },
+                vk::ComponentMapping{
+                    .r = vk::ComponentSwizzle::eIdentity,
+                    .g = vk::ComponentSwizzle::eIdentity,
+                    .b = vk::ComponentSwizzle::eIdentity,
+                    .a = vk::ComponentSwizzle::eIdentity,
+                }));
+        swapchain_images_.push_back(std::move(image));
+    }
+}
+
 VKPT_END
@@ -17,9 +17,23 @@ FrameResources::FrameResources(
           compute_queue->getFamilyIndex(),
           transfer_queue->getFamilyIndex(),
           present_queue->getFamilyIndex()),
-      semaphores_(device, frame_count)
+      semaphores_(device, frame_count),
+      events_(device, frame_count),
+      device_(device),
+      frame_count_(frame_count),
+      queue_families_{
+          graphics_queue->getFamilyIndex(),
+          compute_queue->getFamilyIndex(),
+          transfer_queue->getFamilyIndex(),
+          present_queue->getFamilyIndex()
+      }
 {
-    
+    frame_memory_.resize(frame_count);
+
+    sync_.trackQueue(graphics_queue);
+    sync_.trackQueue(compute_queue);
+    sync_.trackQueue(transfer_queue);
+    sync_.trackQueue(present_queue);
 }
 
 FrameResources::~FrameResources()
@@ -38,6 +52,14 @@ void FrameResources::beginFrame()
     fences_.newFrame();
     cmd_buffers_.newFrame();
     semaphores_.newFrame();
+    events_.newFrame();
+
+    for(auto &cmd_buffers : thread_cmd_buffers_)
+        cmd_buffers->newFrame();
+
+    frame_memory_index_ =
+        (frame_memory_index_ + 1) % static_cast<int>(frame_memory_.size());
+    frame_memory_[frame_memory_index_].reset();
 }
 
 void FrameResources::endFrame(vk::ArrayProxy<Queue *const> queues)
@@ -45,21 +67,51 @@ void FrameResources::endFrame(vk::ArrayProxy<Queue *const> queues)
     sync_.endFrame(queues);
 }
 
+FrameSynchronizer &FrameResources::getFrameSynchronizer()
+{
+    return sync_;
+}
+
 FenceAllocator &FrameResources::getFenceAllocator()
 {
     return fences_;
 }
 
+EventAllocator &FrameResources::getEventAllocator()
+{
+    return events_;
+}
+
+std::pmr::memory_resource &FrameResources::getFrameMemory()
+{
+    return frame_memory_[frame_memory_index_];
+}
+
 CommandBuffer FrameResources::newCommandBuffer(Queue::Type type)
 {
     return cmd_buffers_.newCommandBuffer(type);
 }
 
+CommandBuffer FrameResources::newSecondaryCommandBuffer(Queue::Type type)
+{
+    return cmd_buffers_.newSecondaryCommandBuffer(type);
+}
+
 vk::Fence FrameResources::newFence()
 {
     return fences_.newFence();
 }
 
+vk::Event FrameResources::newEvent()
+{
+    return events_.newEvent();
+}
+
+FrameSynchronizer *FrameResources::_getFrameSynchronizer()
+{
+    return &sync_;
+}
+
 vk::Semaphore FrameResources::newSemaphore()
 {
     return semaphores_.newSemaphore();
@@ -75,6 +127,22 @@ CommandBufferAllocator &FrameResources::getCommandBufferAllocator()
     return cmd_buffers_;
 }
 
+std::span<CommandBufferAllocator *const>
+    FrameResources::getThreadCommandBufferAllocators(uint32_t thread_count)
+{
+    while(thread_cmd_buffers_.size() < thread_count)
+    {
+        thread_cmd_buffers_.push_back(
+            std::make_unique<PerFrameCommandBuffers>(
+                device_, frame_count_,
+                queue_families_[0], queue_families_[1],
+                queue_families_[2], queue_families_[3]));
+        thread_cmd_buffer_allocators_.push_back(
+            thread_cmd_buffers_.back().get());
+    }
+    return { thread_cmd_buffer_allocators_.data(), thread_count };
+}
+
 SemaphoreAllocator &FrameResources::getSemaphoreAllocator()
 {
     return semaphores_;
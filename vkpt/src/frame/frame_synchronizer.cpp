@@ -3,15 +3,15 @@
 VKPT_BEGIN
 
 FrameSynchronizer::FrameSynchronizer()
-    : device_(nullptr), frame_index_(0)
+    : device_(nullptr), frame_slot_(0), frame_index_(0)
 {
     
 }
 
 FrameSynchronizer::FrameSynchronizer(vk::Device device, int frame_count)
-    : device_(device), frame_index_(0)
+    : device_(device), frame_slot_(0), frame_index_(0)
 {
-    fence_info_.resize(frame_count);
+    frame_info_.resize(frame_count);
 }
 
 FrameSynchronizer::FrameSynchronizer(FrameSynchronizer &&other) noexcept
@@ -28,77 +28,206 @@ FrameSynchronizer &FrameSynchronizer::operator=(FrameSynchronizer &&other) noexc
 
 FrameSynchronizer::~FrameSynchronizer()
 {
-    for(auto &f : fence_info_)
+    for(auto &f : frame_info_)
         wait(f);
+
+    for(auto &timeline : timelines_)
+    {
+        const vk::Semaphore semaphore = timeline.semaphore.get();
+        const uint64_t value = timeline.semaphore.getLastSignalValue();
+        const vk::SemaphoreWaitInfoKHR wait_info = {
+            .semaphoreCount = 1,
+            .pSemaphores    = &semaphore,
+            .pValues        = &value
+        };
+        (void)device_.waitSemaphoresKHR(wait_info, UINT64_MAX);
+        timeline.deletion_queue.releaseAll();
+    }
 }
 
 FrameSynchronizer::operator bool() const
 {
-    return !fence_info_.empty();
+    return !frame_info_.empty();
 }
 
 void FrameSynchronizer::swap(FrameSynchronizer &other) noexcept
 {
     std::swap(device_, other.device_);
+    std::swap(frame_slot_, other.frame_slot_);
     std::swap(frame_index_, other.frame_index_);
-    std::swap(fence_info_, other.fence_info_);
+    std::swap(frame_info_, other.frame_info_);
+    std::swap(timelines_, other.timelines_);
 }
 
 void FrameSynchronizer::newFrame()
 {
-    frame_index_ = (frame_index_ + 1) % static_cast<int>(fence_info_.size());
-    wait(fence_info_[frame_index_]);
+    frame_slot_ = (frame_slot_ + 1) % static_cast<int>(frame_info_.size());
+    ++frame_index_;
+
+    auto &info = frame_info_[frame_slot_];
+    wait(info);
+    info.frame_index = frame_index_;
+
+    collectGarbage();
 }
 
 void FrameSynchronizer::endFrame(vk::ArrayProxy<Queue *const> queues)
 {
-    auto &info = fence_info_[frame_index_];
+    for(auto queue : queues)
+        trackQueue(queue);
+
+    for(auto &timeline : timelines_)
+    {
+        auto queue = timeline.queue;
+        if(queue->getSubmitCount() > timeline.tracked_submit_count)
+            queue->submit({}, { newQueueSignal(queue) }, {}, nullptr);
+    }
+
+    auto &info = frame_info_[frame_slot_];
+    assert(info.semaphores.empty());
+
+    for(auto &timeline : timelines_)
+    {
+        if(timeline.signaled_in_frame)
+        {
+            info.semaphores.push_back(timeline.semaphore.get());
+            info.values.push_back(timeline.semaphore.getLastSignalValue());
+        }
+        timeline.signaled_in_frame = false;
+    }
+}
+
+void FrameSynchronizer::trackQueue(const Queue *queue)
+{
+    getTimeline(queue);
+}
+
+vk::SemaphoreSubmitInfoKHR FrameSynchronizer::newQueueSignal(const Queue *queue)
+{
+    auto &timeline = getTimeline(queue);
+    timeline.signaled_in_frame = true;
+
+    // the signal is carried by the next submit to the queue. a submit by
+    // another thread in between only causes an extra signal at endFrame
+
+    timeline.tracked_submit_count = queue->getSubmitCount() + 1;
+
+    return vk::SemaphoreSubmitInfoKHR{
+        .semaphore = timeline.semaphore.get(),
+        .value     = timeline.semaphore.nextSignalValue(),
+        .stageMask = vk::PipelineStageFlagBits2KHR::eAllCommands
+    };
+}
+
+uint64_t FrameSynchronizer::getLastQueueSignalValue(const Queue *queue)
+{
+    return getTimeline(queue).semaphore.getLastSignalValue();
+}
+
+uint64_t FrameSynchronizer::getFrameIndex() const
+{
+    return frame_index_;
+}
+
+bool FrameSynchronizer::isFrameComplete(uint64_t frame_index) const
+{
+    // older frames were waited for when their slots were reused
 
-    while(info.fences.size() < queues.size())
-        info.fences.push_back(device_.createFenceUnique({}));
+    const uint64_t frame_count = frame_info_.size();
+    if(frame_index + frame_count <= frame_index_)
+        return true;
 
-    assert(info.used_fences.empty());
-    for(uint32_t i = 0; i < queues.size(); ++i)
+    auto &info = frame_info_[frame_index % frame_count];
+    if(info.frame_index != frame_index || frame_index == frame_index_)
+        return false;
+
+    for(size_t i = 0; i < info.semaphores.size(); ++i)
     {
-        info.used_fences.push_back(info.fences[i].get());
-        queues.data()[i]->submit({}, {}, {}, {}, info.used_fences.back());
+        if(device_.getSemaphoreCounterValueKHR(info.semaphores[i]) <
+           info.values[i])
+            return false;
     }
+    return true;
+}
 
-    fence_info_[frame_index_].will_be_signaled = true;
+void FrameSynchronizer::collectGarbage()
+{
+    for(auto &timeline : timelines_)
+    {
+        if(timeline.deletion_queue.empty())
+            continue;
+        const uint64_t completed_value =
+            device_.getSemaphoreCounterValueKHR(timeline.semaphore.get());
+        timeline.deletion_queue.release(completed_value);
+    }
 }
 
 void FrameSynchronizer::executeAfterSync(std::function<void()> func)
 {
-    fence_info_[frame_index_].delayed_functions.push_back(std::move(func));
+    frame_info_[frame_slot_].delayed_functions.push_back(std::move(func));
 }
 
 void FrameSynchronizer::_triggerAllSync()
 {
-    for(auto &f : fence_info_)
+    for(auto &f : frame_info_)
     {
         for(auto &func : f.delayed_functions)
             func();
         f.delayed_functions.clear();
+        f.deletion_queue.releaseAll();
     }
+
+    for(auto &timeline : timelines_)
+        timeline.deletion_queue.releaseAll();
 }
 
-void FrameSynchronizer::wait(FenceInfo &info)
+FrameSynchronizer::QueueTimeline &FrameSynchronizer::getTimeline(
+    const Queue *queue)
 {
-    if(info.will_be_signaled)
+    // Queue objects may wrap the same VkQueue
+
+    const vk::Queue raw_queue = queue->getRaw();
+    for(auto &timeline : timelines_)
     {
-        (void)device_.waitForFences(info.used_fences, true, UINT64_MAX);
-        info.will_be_signaled = false;
+        if(timeline.raw_queue == raw_queue)
+            return timeline;
     }
 
-    if(!info.used_fences.empty())
+    const vk::SemaphoreTypeCreateInfo type_create_info = {
+        .semaphoreType = vk::SemaphoreType::eTimeline,
+        .initialValue  = 0
+    };
+    const vk::SemaphoreCreateInfo create_info = {
+        .pNext = &type_create_info
+    };
+
+    timelines_.push_back({
+        raw_queue,
+        queue,
+        TimelineSemaphore(device_.createSemaphoreUnique(create_info), 0)
+    });
+    return timelines_.back();
+}
+
+void FrameSynchronizer::wait(FrameInfo &info)
+{
+    if(!info.semaphores.empty())
     {
-        device_.resetFences(info.used_fences);
-        info.used_fences.clear();
+        const vk::SemaphoreWaitInfoKHR wait_info = {
+            .semaphoreCount = static_cast<uint32_t>(info.semaphores.size()),
+            .pSemaphores    = info.semaphores.data(),
+            .pValues        = info.values.data()
+        };
+        (void)device_.waitSemaphoresKHR(wait_info, UINT64_MAX);
+
+        info.semaphores.clear();
+        info.values.clear();
     }
 
     for(auto &func : info.delayed_functions)
         func();
     info.delayed_functions.clear();
+    info.deletion_queue.releaseAll();
 }
 
 VKPT_END
@@ -58,27 +58,47 @@ void PerFrameSingleQueueCommandBuffers::newFrame()
 
     auto &f = frames_[frame_index_];
 
-    if(f.next_available_buffer_index)
+    if(f.next_available_buffer_index || f.next_available_secondary_index)
     {
         device_.resetCommandPool(f.pool.get());
         f.next_available_buffer_index = 0;
+        f.next_available_secondary_index = 0;
     }
 }
 
 vk::CommandBuffer PerFrameSingleQueueCommandBuffers::newCommandBuffer()
 {
     auto &f = frames_[frame_index_];
-    if(f.next_available_buffer_index >= f.buffers.size())
+    return newCommandBuffer(
+        f.buffers, f.next_available_buffer_index,
+        vk::CommandBufferLevel::ePrimary);
+}
+
+vk::CommandBuffer PerFrameSingleQueueCommandBuffers::newSecondaryCommandBuffer()
+{
+    auto &f = frames_[frame_index_];
+    return newCommandBuffer(
+        f.secondary_buffers, f.next_available_secondary_index,
+        vk::CommandBufferLevel::eSecondary);
+}
+
+vk::CommandBuffer PerFrameSingleQueueCommandBuffers::newCommandBuffer(
+    std::vector<vk::UniqueCommandBuffer> &buffers,
+    size_t                               &next_available_index,
+    vk::CommandBufferLevel                level)
+{
+    auto &f = frames_[frame_index_];
+    if(next_available_index >= buffers.size())
     {
         auto buffer = std::move(device_.allocateCommandBuffersUnique(
             vk::CommandBufferAllocateInfo{
                 .commandPool        = f.pool.get(),
-                .level              = vk::CommandBufferLevel::ePrimary,
+                .level              = level,
                 .commandBufferCount = 1
             }).front());
-        f.buffers.push_back(std::move(buffer));
+        buffers.push_back(std::move(buffer));
     }
-    return f.buffers[f.next_available_buffer_index++].get();
+    return buffers[next_available_index++].get();
 }
 
 PerFrameCommandBuffers::PerFrameCommandBuffers(
@@ -115,4 +135,10 @@ CommandBuffer PerFrameCommandBuffers::newCommandBuffer(Queue::Type type)
     return per_queue_[static_cast<int>(type)].newCommandBuffer();
 }
 
+CommandBuffer PerFrameCommandBuffers::newSecondaryCommandBuffer(
+    Queue::Type type)
+{
+    return per_queue_[static_cast<int>(type)].newSecondaryCommandBuffer();
+}
+
 VKPT_END
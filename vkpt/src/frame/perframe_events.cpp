@@ -0,0 +1,63 @@
+#include <vkpt/frame/perframe_events.h>
+
+VKPT_BEGIN
+
+PerFrameEvents::PerFrameEvents()
+    : device_(nullptr), frame_index_(0)
+{
+    
+}
+
+PerFrameEvents::PerFrameEvents(vk::Device device, uint32_t frame_count)
+    : device_(device), frame_index_(0)
+{
+    frames_.resize(frame_count);
+}
+
+PerFrameEvents::PerFrameEvents(PerFrameEvents &&other) noexcept
+    : PerFrameEvents()
+{
+    swap(other);
+}
+
+PerFrameEvents &PerFrameEvents::operator=(PerFrameEvents &&other) noexcept
+{
+    swap(other);
+    return *this;
+}
+
+PerFrameEvents::operator bool() const
+{
+    return frames_.data();
+}
+
+void PerFrameEvents::swap(PerFrameEvents &other) noexcept
+{
+    std::swap(device_, other.device_);
+    std::swap(frame_index_, other.frame_index_);
+    std::swap(frames_, other.frames_);
+}
+
+void PerFrameEvents::newFrame()
+{
+    frame_index_ = (frame_index_ + 1) % static_cast<int>(frames_.size());
+    frames_[frame_index_].next_available_event = 0;
+}
+
+vk::Event PerFrameEvents::newEvent()
+{
+    auto &frame = frames_[frame_index_];
+
+    if(frame.next_available_event >= frame.events.size())
+        frame.events.push_back(device_.createEventUnique({}));
+
+    // events of this frame slot are no longer in use by the device,
+    // so they can be reset from host. device-only events can't be
+    // reset this way and are thus not used
+
+    auto result = frame.events[frame.next_available_event++].get();
+    device_.resetEvent(result);
+    return result;
+}
+
+VKPT_END
@@ -1,7 +1,49 @@
+#include <algorithm>
+
 #include <vkpt/graph/compile_internal.h>
+#include <vkpt/graph/group_barrier_optimizer.h>
 
 VKPT_GRAPH_BEGIN
 
+GroupFlags::GroupFlags(std::pmr::memory_resource &memory)
+    : words_(&memory), hash_(0)
+{
+    
+}
+
+bool GroupFlags::test(size_t index) const
+{
+    const size_t word = index / 64;
+    if(word >= words_.size())
+        return false;
+    return words_[word] & (uint64_t(1) << index % 64);
+}
+
+void GroupFlags::set(size_t index)
+{
+    const size_t word = index / 64;
+    if(word >= words_.size())
+        words_.resize(word + 1, 0);
+
+    const uint64_t bit = uint64_t(1) << index % 64;
+    if(words_[word] & bit)
+        return;
+    words_[word] |= bit;
+
+    // splitmix64 finalizer
+
+    uint64_t h = index + 0x9e3779b97f4a7c15;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+    hash_ ^= h ^ (h >> 31);
+}
+
+bool GroupFlags::operator==(const GroupFlags &rhs) const
+{
+    // the last word is never zero, so equal sets have equal sizes
+    return hash_ == rhs.hash_ && std::ranges::equal(words_, rhs.words_);
+}
+
 CompilePass::CompilePass(std::pmr::memory_resource &memory)
     : raw_pass(nullptr),
       queue(nullptr),
@@ -9,7 +51,7 @@ CompilePass::CompilePass(std::pmr::memory_resource &memory)
       unprocessed_head_count(0),
       sorted_index(-1),
       sorted_index_in_group(-1),
-      group_flags(0),
+      group_flags(memory),
       tails(&memory),
       heads(&memory),
       pre_ext_buffer_barriers(&memory),
@@ -20,12 +62,73 @@ CompilePass::CompilePass(std::pmr::memory_resource &memory)
       pre_image_barriers(&memory),
       wait_semaphores(&memory),
       signal_semaphores(&memory),
-      generated_buffer_usages(&memory),
-      generated_image_usages(&memory)
+      set_events(&memory),
+      wait_events(&memory),
+      buffer_usages(&memory),
+      image_usages(&memory)
 {
     
 }
 
+namespace
+{
+
+    vk::SemaphoreSubmitInfoKHR &findOrAddSubmit(
+        Vector<vk::SemaphoreSubmitInfoKHR> &submits, vk::Semaphore semaphore)
+    {
+        for(auto &submit : submits)
+        {
+            if(submit.semaphore == semaphore)
+                return submit;
+        }
+        return submits.emplace_back(
+            vk::SemaphoreSubmitInfoKHR{ .semaphore = semaphore });
+    }
+
+    template<typename T>
+    void sortAndUnique(Vector<T> &barriers)
+    {
+        std::sort(barriers.begin(), barriers.end());
+        barriers.erase(
+            std::unique(barriers.begin(), barriers.end()), barriers.end());
+    }
+
+    template<typename T>
+    void uniqueByRecord(Vector<std::pair<int, T>> &barriers)
+    {
+        std::stable_sort(
+            barriers.begin(), barriers.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+        auto it = std::unique(
+            barriers.begin(), barriers.end(),
+            [](const auto &a, const auto &b) { return a.first == b.first; });
+        barriers.erase(it, barriers.end());
+    }
+
+} // namespace anonymous
+
+vk::SemaphoreSubmitInfoKHR &CompilePass::getWaitSemaphore(
+    vk::Semaphore semaphore)
+{
+    return findOrAddSubmit(wait_semaphores, semaphore);
+}
+
+vk::SemaphoreSubmitInfoKHR &CompilePass::getSignalSemaphore(
+    vk::Semaphore semaphore)
+{
+    return findOrAddSubmit(signal_semaphores, semaphore);
+}
+
+void CompilePass::removeDuplicates()
+{
+    sortAndUnique(pre_ext_buffer_barriers);
+    sortAndUnique(pre_ext_image_barriers);
+    sortAndUnique(post_ext_buffer_barriers);
+    sortAndUnique(post_ext_image_barriers);
+    uniqueByRecord(pre_buffer_barriers);
+    uniqueByRecord(pre_image_barriers);
+}
+
 CompileBufferUsage::operator Pass::BufferUsage() const
 {
     return Pass::BufferUsage{
@@ -44,9 +147,22 @@ CompileImageUsage::operator Pass::ImageUsage() const
     };
 }
 
+CompileEvent::CompileEvent(
+    std::pmr::memory_resource &memory,
+    CompilePass               *signal_pass,
+    CompilePass               *wait_pass)
+    : signal_pass(signal_pass),
+      wait_pass(wait_pass),
+      buffer_barriers(&memory),
+      image_barriers(&memory)
+{
+    
+}
+
 CompileGroup::CompileGroup(std::pmr::memory_resource &memory)
     : queue(nullptr),
       passes(&memory),
+      events(&memory),
       need_tail_semaphore(false),
       tails(&memory),
       heads(&memory),
@@ -55,16 +171,99 @@ CompileGroup::CompileGroup(std::pmr::memory_resource &memory)
     
 }
 
-CompileBuffer::CompileBuffer(std::pmr::memory_resource &memory)
-    : usages(&memory), pass_to_usage(&memory)
+CompileBuffer::CompileBuffer(
+    std::pmr::memory_resource &memory, int index, const Buffer &resource)
+    : index(index), resource(resource), usages(&memory)
 {
     
 }
 
-CompileImage::CompileImage(std::pmr::memory_resource &memory)
-    : usages(&memory), pass_to_usage(&memory)
+CompileImage::CompileImage(
+    std::pmr::memory_resource   &memory,
+    int                          index,
+    const ImageSubresourceRange &resource)
+    : index(index), resource(resource), usages(&memory)
 {
     
 }
 
+const ResourceState &getResourceState(const Buffer &buffer)
+{
+    return buffer.getState();
+}
+
+const ResourceState &getResourceState(const ImageSubresourceRange &image_range)
+{
+    return image_range.image.getState(vk::ImageSubresource{
+        .aspectMask = image_range.range.aspectMask,
+        .mipLevel   = image_range.range.baseMipLevel,
+        .arrayLayer = image_range.range.baseArrayLayer
+    });
+}
+
+bool isSameState(const ResourceState &a, const ResourceState &b)
+{
+    return a.match(
+        [&](const FreeState &s)
+    {
+        return b.is<FreeState>() && b.as<FreeState>().layout == s.layout;
+    },
+        [&](const UsingState &s)
+    {
+        if(!b.is<UsingState>())
+            return false;
+        auto &t = b.as<UsingState>();
+        return s.queue  == t.queue  &&
+               s.stages == t.stages &&
+               s.access == t.access &&
+               s.layout == t.layout;
+    },
+        [&](const ReleasedState &s)
+    {
+        if(!b.is<ReleasedState>())
+            return false;
+        auto &t = b.as<ReleasedState>();
+        return s.src_queue  == t.src_queue  &&
+               s.dst_queue  == t.dst_queue  &&
+               s.old_layout == t.old_layout &&
+               s.new_layout == t.new_layout;
+    });
+}
+
+bool isSharedRead(const Pass::BufferUsage &usage)
+{
+    // usages without access only wait for others, e.g. generated passes
+    return usage.access && GroupBarrierOptimizer::isReadOnly(usage.access);
+}
+
+bool isSharedRead(const Pass::ImageUsage &usage)
+{
+    return usage.access && GroupBarrierOptimizer::isReadOnly(usage.access) &&
+           usage.layout == usage.exit_layout;
+}
+
+bool isSameRun(const CompileBufferUsage &a, const CompileBufferUsage &b)
+{
+    return a.pass->queue == b.pass->queue &&
+           isSharedRead(a) && isSharedRead(b);
+}
+
+bool isSameRun(const CompileImageUsage &a, const CompileImageUsage &b)
+{
+    return a.pass->queue == b.pass->queue &&
+           a.layout == b.layout &&
+           isSharedRead(a) && isSharedRead(b);
+}
+
+bool hasLayoutTransition(const CompileBufferUsage &, const CompileBufferUsage &)
+{
+    return false;
+}
+
+bool hasLayoutTransition(
+    const CompileImageUsage &prev, const CompileImageUsage &usage)
+{
+    return prev.exit_layout != usage.layout;
+}
+
 VKPT_GRAPH_END
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <queue>
 #include <ranges>
+#include <type_traits>
 
 #include <vkpt/graph/compiler.h>
 #include <vkpt/graph/group_barrier_generator.h>
@@ -8,16 +11,181 @@
 
 VKPT_GRAPH_BEGIN
 
+struct Compiler::IncrementalState
+{
+    struct ExtBarriers
+    {
+        explicit ExtBarriers(std::pmr::memory_resource &memory)
+            : pre_buffer_barriers(&memory),
+              pre_image_barriers(&memory),
+              post_buffer_barriers(&memory),
+              post_image_barriers(&memory)
+        {
+            
+        }
+
+        Vector<vk::BufferMemoryBarrier2KHR> pre_buffer_barriers;
+        Vector<vk::ImageMemoryBarrier2KHR>  pre_image_barriers;
+        Vector<vk::BufferMemoryBarrier2KHR> post_buffer_barriers;
+        Vector<vk::ImageMemoryBarrier2KHR>  post_image_barriers;
+    };
+
+    explicit IncrementalState(std::pmr::memory_resource &memory)
+        : memory(memory),
+          raw_passes(&memory),
+          removed_passes(&memory),
+          buffer_usages(&memory),
+          image_usages(&memory),
+          buffer_states(&memory),
+          image_states(&memory),
+          buffer_final_states(&memory),
+          image_final_states(&memory),
+          ext_barriers(&memory),
+          group_passes(&memory),
+          group_indices(&memory),
+          releases(&memory)
+    {
+        
+    }
+
+    void saveUsages(const ResourceRecords &records)
+    {
+        for(auto &record : records.getBuffers())
+            buffer_usages.emplace_back(record.usages);
+        for(auto &record : records.getImages())
+            image_usages.emplace_back(record.usages);
+    }
+
+    void saveStates(
+        const ResourceRecords                           &records,
+        const Map<Buffer, ResourceState>                &signaled_buffer_states,
+        const Map<ImageSubresourceRange, ResourceState> &signaled_image_states)
+    {
+        for(auto &record : records.getBuffers())
+            buffer_states.push_back(getResourceState(record.resource));
+        for(auto &record : records.getImages())
+            image_states.push_back(getResourceState(record.resource));
+
+        buffer_final_states = signaled_buffer_states;
+        image_final_states  = signaled_image_states;
+    }
+
+    template<typename Passes>
+    void saveExtBarriers(const Passes &passes)
+    {
+        for(auto pass : passes)
+        {
+            if(pass->pre_ext_buffer_barriers.empty() &&
+               pass->pre_ext_image_barriers.empty() &&
+               pass->post_ext_buffer_barriers.empty() &&
+               pass->post_ext_image_barriers.empty())
+                continue;
+
+            auto &barriers = ext_barriers.try_emplace(pass, memory).first->second;
+            barriers.pre_buffer_barriers.assign(
+                pass->pre_ext_buffer_barriers.begin(),
+                pass->pre_ext_buffer_barriers.end());
+            barriers.pre_image_barriers.assign(
+                pass->pre_ext_image_barriers.begin(),
+                pass->pre_ext_image_barriers.end());
+            barriers.post_buffer_barriers.assign(
+                pass->post_ext_buffer_barriers.begin(),
+                pass->post_ext_buffer_barriers.end());
+            barriers.post_image_barriers.assign(
+                pass->post_ext_image_barriers.begin(),
+                pass->post_ext_image_barriers.end());
+        }
+    }
+
+    void restoreExtBarriers(CompilePass *pass) const
+    {
+        pass->pre_ext_buffer_barriers.clear();
+        pass->pre_ext_image_barriers.clear();
+        pass->post_ext_buffer_barriers.clear();
+        pass->post_ext_image_barriers.clear();
+
+        auto it = ext_barriers.find(pass);
+        if(it == ext_barriers.end())
+            return;
+
+        auto &barriers = it->second;
+        pass->pre_ext_buffer_barriers.assign(
+            barriers.pre_buffer_barriers.begin(),
+            barriers.pre_buffer_barriers.end());
+        pass->pre_ext_image_barriers.assign(
+            barriers.pre_image_barriers.begin(),
+            barriers.pre_image_barriers.end());
+        pass->post_ext_buffer_barriers.assign(
+            barriers.post_buffer_barriers.begin(),
+            barriers.post_buffer_barriers.end());
+        pass->post_ext_image_barriers.assign(
+            barriers.post_image_barriers.begin(),
+            barriers.post_image_barriers.end());
+    }
+
+    void saveGroups(const Vector<CompileGroup *> &groups)
+    {
+        for(size_t i = 0; i < groups.size(); ++i)
+        {
+            group_passes.emplace_back(groups[i]->passes);
+            group_indices[groups[i]] = static_cast<int>(i);
+        }
+    }
+
+    std::pmr::memory_resource &memory;
+
+    // compile pass of each raw pass, by index
+    Vector<CompilePass *> raw_passes;
+    Set<CompilePass *>    removed_passes;
+
+    // usages of each record before runs are merged and dummy passes are
+    // added. records using removable passes have no semaphores, so these
+    // are all of their usages
+    Vector<List<CompileBufferUsage>> buffer_usages;
+    Vector<List<CompileImageUsage>>  image_usages;
+
+    // incoming states of records and final states of signaled ones
+    Vector<ResourceState>                     buffer_states;
+    Vector<ResourceState>                     image_states;
+    Map<Buffer, ResourceState>                buffer_final_states;
+    Map<ImageSubresourceRange, ResourceState> image_final_states;
+
+    // ext barriers added by semaphore handlers
+    HashMap<const CompilePass *, ExtBarriers> ext_barriers;
+
+    // passes of each group with every pass enabled
+    Vector<Vector<CompilePass *>>      group_passes;
+    HashMap<const CompileGroup *, int> group_indices;
+
+    Vector<GroupBarrierGenerator::ReleaseBarriers> releases;
+};
+
 Compiler::Compiler()
-    : compile_passes_(&memory_),
+    : Compiler(*std::pmr::get_default_resource())
+{
+
+}
+
+Compiler::Compiler(
+    std::pmr::memory_resource &upstream, ThreadPool *thread_pool)
+    : memory_(thread_pool ?
+          static_cast<std::pmr::memory_resource &>(
+              synchronized_memory_.emplace(&upstream)) :
+          unsynchronized_memory_.emplace(&upstream)),
+      arena_(memory_),
+      thread_pool_(thread_pool),
+      output_memory_(&memory_),
+      canonical_queues_(&memory_),
+      compile_passes_(&memory_),
       sorted_compile_passes_(&memory_),
       compile_groups_(&memory_),
       closure_(nullptr),
       generated_pre_passes_(&memory_),
       generated_post_passes_(&memory_),
-      resource_records_(memory_),
+      resource_records_(memory_, this),
       buffer_final_states_(&memory_),
-      image_final_states_(&memory_)
+      image_final_states_(&memory_),
+      incremental_(nullptr)
 {
 
 }
@@ -26,17 +194,53 @@ ExecutableGraph Compiler::compile(
     SemaphoreAllocator &semaphore_allocator,
     const Graph        &graph)
 {
+    return compile(semaphore_allocator, graph, memory_);
+}
+
+ExecutableGraph Compiler::compile(
+    SemaphoreAllocator        &semaphore_allocator,
+    const Graph               &graph,
+    std::pmr::memory_resource &output_memory)
+{
+    output_memory_ = &output_memory;
+
     initializeCompilePasses(graph);
+    if(!incremental_)
+        removeDisabledPasses(graph);
+    if(graph.dependency_inference_enabled_)
+        inferDependencies();
+    if(graph.culling_enabled_)
+        cullDeadPasses(graph);
     topologySortCompilePasses();
+    assignQueues(graph);
+
+    collectResourceUsages(graph);
+    mergeNeighboringReadOnlyUsages(graph);
+
+    // the closure is only needed to place semaphore waits/signals, and to
+    // validate the order of resource users in debug builds
+
+    const bool has_semaphores =
+        !graph.buffer_waits_.empty() || !graph.image_waits_.empty() ||
+        !graph.buffer_signals_.empty() || !graph.image_signals_.empty();
+
+#ifdef VKPT_DEBUG
     buildTransitiveClosure();
+    validateResourceUsageOrder();
+#else
+    if(has_semaphores)
+        buildTransitiveClosure();
+#endif
 
-    collectResourceUsages();
+    if(incremental_)
+        incremental_->saveUsages(resource_records_);
 
     {
         GroupBarrierOptimizer optimizer;
-        optimizer.optimize(resource_records_);
+        optimizer.optimize(resource_records_, thread_pool_);
     }
 
+    if(has_semaphores)
     {
         auto create_pre_pass = [&]
         {
@@ -48,10 +252,12 @@ ExecutableGraph Compiler::compile(
         SemaphoreWaitHandler semaphore_wait_handler(
             memory_, this, closure_, create_pre_pass);
 
-        semaphore_wait_handler.collectWaitingSemaphores(graph);
+        semaphore_wait_handler.collectWaitingSemaphores(
+            graph, resource_records_);
         semaphore_wait_handler.processWaitingSemaphores(resource_records_);
     }
 
+    if(has_semaphores)
     {
         auto create_post_pass = [&]
         {
@@ -61,66 +267,108 @@ ExecutableGraph Compiler::compile(
         };
 
         SemaphoreSignalHandler semaphore_signal_handler(
-            memory_, closure_,
+            memory_, this, closure_,
             buffer_final_states_, image_final_states_,
             create_post_pass);
 
-        semaphore_signal_handler.collectSignalingSemaphores(graph);
+        semaphore_signal_handler.collectSignalingSemaphores(
+            graph, resource_records_);
         semaphore_signal_handler.processSignalingSemaphores(
             resource_records_, graph);
     }
 
-    for(auto &[buffer, _] : resource_records_.getBuffers())
-        processUnwaitedFirstUsage(buffer);
+    if(has_semaphores)
+        canonicalizeGeneratedPassQueues();
 
-    for(auto &[image_subrsc, _] : resource_records_.getImages())
-        processUnwaitedFirstUsage(image_subrsc);
+    if(incremental_)
+    {
+        incremental_->saveStates(
+            resource_records_, buffer_final_states_, image_final_states_);
+        incremental_->saveExtBarriers(compile_passes_);
+        incremental_->saveExtBarriers(generated_pre_passes_);
+        incremental_->saveExtBarriers(generated_post_passes_);
+    }
 
-    for(auto &[buffer, _] : resource_records_.getBuffers())
-        processUnsignaledFinalState(buffer);
+    for(auto &record : resource_records_.getBuffers())
+        processUnwaitedFirstUsage(record, getResourceState(record.resource));
 
-    for(auto &[image_subrsc, _] : resource_records_.getImages())
-        processUnsignaledFinalState(image_subrsc);
+    for(auto &record : resource_records_.getImages())
+        processUnwaitedFirstUsage(record, getResourceState(record.resource));
 
-    mergeNeighboringReadOnlyUsages();
+    for(auto &record : resource_records_.getBuffers())
+        processUnsignaledFinalState(record);
 
-    mergeGeneratedPreAndPostPasses();
+    for(auto &record : resource_records_.getImages())
+        processUnsignaledFinalState(record);
 
+    if(isSingleQueue())
+    {
+        // all passes form one group without inter-group synchronization
+        buildSingleGroup();
+    }
+    else
     {
+        mergeGeneratedPreAndPostPasses();
+
         generateGroupFlags();
         auto unsorted_groups = generateGroups();
         fillInterGroupArcs(unsorted_groups);
         topologySortGroups(unsorted_groups);
-    }
 
-    for(auto group : compile_groups_)
-        topologySortPassesInGroup(group);
+        for(auto group : compile_groups_)
+            topologySortPassesInGroup(group);
 
-    fillInterGroupSemaphores(semaphore_allocator);
+        fillInterGroupSemaphores(semaphore_allocator);
+    }
 
-    for(auto &record : std::views::values(resource_records_.getBuffers()))
-        buildPassToUsage(record);
+    if(incremental_)
+        incremental_->saveGroups(compile_groups_);
 
-    for(auto &record : std::views::values(resource_records_.getImages()))
-        buildPassToUsage(record);
+    resource_records_.buildPassUsages();
 
     {
-        GroupBarrierGenerator group_barrier_generator(memory_, resource_records_);
-        for(auto group : compile_groups_)
-            group_barrier_generator.fillBarriers(group);
+        // generators don't touch the shared groups.
+        // release barriers are applied in group order afterwards, so that
+        // the result is the same as filling groups sequentially
+
+        auto generators = createBarrierGenerators(graph);
+
+        Vector<GroupBarrierGenerator::ReleaseBarriers> releases(&memory_);
+        releases.reserve(compile_groups_.size());
+        for(size_t i = 0; i < compile_groups_.size(); ++i)
+            releases.emplace_back(memory_);
+
+        parallelFor(
+            thread_pool_, compile_groups_.size(),
+            [&](uint32_t thread, size_t i)
+        {
+            generators[thread].fillBarriers(compile_groups_[i], releases[i]);
+        });
+
+        for(auto &group_releases : releases)
+            group_releases.apply();
+
+        if(incremental_)
+            incremental_->releases = std::move(releases);
     }
 
+    parallelFor(thread_pool_, compile_groups_.size(), [&](uint32_t, size_t i)
     {
         GroupBarrierOptimizer group_barrier_optimizer;
-        for(auto group : compile_groups_)
-            group_barrier_optimizer.optimize(group);
-    }
+        group_barrier_optimizer.optimize(compile_groups_[i]);
+    });
+
+    ExecutableGraph result(*output_memory_);
 
-    ExecutableGraph result(memory_);
+    result.groups.resize(
+        compile_groups_.size(), ExecutableGroup(*output_memory_));
 
-    result.groups.resize(compile_groups_.size(), ExecutableGroup(memory_));
-    for(size_t i = 0; i < compile_groups_.size(); ++i)
+    parallelFor(
+        output_memory_ == &memory_ ? thread_pool_ : nullptr,
+        compile_groups_.size(), [&](uint32_t, size_t i)
+    {
         fillExecutableGroup(*compile_groups_[i], result.groups[i]);
+    });
 
     result.buffer_final_states = std::move(buffer_final_states_);
     result.image_final_states  = std::move(image_final_states_);
@@ -128,6 +376,255 @@ ExecutableGraph Compiler::compile(
     return result;
 }
 
+void Compiler::setIncremental(bool incremental)
+{
+    if(!incremental)
+        incremental_ = nullptr;
+    else if(!incremental_)
+        incremental_ = arena_.create<IncrementalState>(memory_);
+}
+
+bool Compiler::recompile(
+    const Graph     &graph,
+    ExecutableGraph &result,
+    Vector<int>     &dirty_groups)
+{
+    assert(incremental_);
+    assert(result.groups.size() == compile_groups_.size());
+    auto &state = *incremental_;
+
+    dirty_groups.clear();
+
+    // the compiled graph may be gone, so raw passes are found by index
+
+    assert(graph.passes_.size() == state.raw_passes.size());
+    for(auto raw_pass : graph.passes_)
+        state.raw_passes[raw_pass->index_]->raw_pass = raw_pass;
+
+    // passes holding semaphores of the compiled graph are kept
+
+    auto removed_passes = findDisabledPasses(graph);
+    std::erase_if(removed_passes, [](const CompilePass *pass)
+    {
+        return !pass->wait_semaphores.empty() ||
+               !pass->signal_semaphores.empty();
+    });
+
+    if(graph.culling_enabled_)
+    {
+        auto live_passes = findLivePasses(graph, removed_passes);
+        for(auto pass : compile_passes_)
+        {
+            if(!live_passes.contains(pass))
+                removed_passes.insert(pass);
+        }
+    }
+
+    Set<CompilePass *> toggled_passes(&memory_);
+    std::ranges::set_symmetric_difference(
+        removed_passes, state.removed_passes,
+        std::inserter(toggled_passes, toggled_passes.end()));
+    if(toggled_passes.empty())
+        return true;
+
+    // records using toggled passes get their usages from the compiled ones.
+    // runs losing passes keep their joins, whose stages may now cover more
+    // than needed
+
+    GlobalGroupDependencyLUT dependencies(memory_);
+
+    auto collect_usages = [&](
+        auto &records, const auto &all_usages, const auto &states, auto &output)
+    {
+        for(size_t i = 0; i < records.size(); ++i)
+        {
+            auto &record = records[i];
+            auto &base_usages = all_usages[i];
+
+            const bool is_touched = std::ranges::any_of(
+                base_usages, [&](const auto &usage)
+            {
+                return toggled_passes.contains(usage.pass);
+            });
+            if(!is_touched)
+                continue;
+
+            auto &[output_record, usages] = output.emplace_back();
+            output_record = &record;
+            if(record.has_dummy_pass)
+                usages.push_back(record.usages.front());
+            for(auto &usage : base_usages)
+            {
+                if(!removed_passes.contains(usage.pass))
+                    usages.push_back(usage);
+            }
+
+            if(!keepsStructure(usages, states[i], dependencies))
+                return false;
+        }
+        return true;
+    };
+
+    auto &buffers = resource_records_.getBuffers();
+    auto &images  = resource_records_.getImages();
+
+    Vector<std::pair<CompileBuffer *, List<CompileBufferUsage>>>
+        new_buffer_usages(&memory_);
+    Vector<std::pair<CompileImage *, List<CompileImageUsage>>>
+        new_image_usages(&memory_);
+
+    if(!collect_usages(
+            buffers, state.buffer_usages, state.buffer_states,
+            new_buffer_usages) ||
+       !collect_usages(
+            images, state.image_usages, state.image_states,
+            new_image_usages))
+        return false;
+
+    state.removed_passes.swap(removed_passes);
+
+    // groups of passes that used or use a touched record, and of toggled
+    // passes, are filled again
+
+    Set<CompileGroup *> dirty(&memory_);
+    for(auto pass : toggled_passes)
+        dirty.insert(pass->group);
+
+    auto replace_usages = [&](auto &new_usages)
+    {
+        GroupBarrierOptimizer optimizer;
+        for(auto &[record, usages] : new_usages)
+        {
+            for(auto &usage : record->usages)
+                dirty.insert(usage.pass->group);
+            for(auto &usage : usages)
+                dirty.insert(usage.pass->group);
+
+            record->usages.swap(usages);
+            optimizer.mergeNeighboringUsages(*record);
+        }
+    };
+
+    replace_usages(new_buffer_usages);
+    replace_usages(new_image_usages);
+
+    for(auto pass : compile_passes_)
+    {
+        pass->buffer_usages.clear();
+        pass->image_usages.clear();
+    }
+    resource_records_.buildPassUsages();
+
+    for(auto group : dirty)
+    {
+        const int index = state.group_indices.at(group);
+        dirty_groups.push_back(index);
+
+        group->passes.clear();
+        for(auto pass : state.group_passes[index])
+        {
+            if(!state.removed_passes.contains(pass))
+                group->passes.push_back(pass);
+        }
+
+        for(size_t i = 0; i < group->passes.size(); ++i)
+        {
+            auto pass = group->passes[i];
+            pass->sorted_index_in_group = static_cast<int>(i);
+            pass->pre_buffer_barriers.clear();
+            pass->pre_image_barriers.clear();
+            pass->pre_memory_barrier.reset();
+            pass->post_memory_barrier.reset();
+            pass->set_events.clear();
+            pass->wait_events.clear();
+        }
+
+        group->events.clear();
+        for(auto &stages : std::views::values(group->heads))
+            stages = {};
+    }
+
+    std::ranges::sort(dirty_groups);
+
+    // barriers for incoming states are added again to every first run, as
+    // ext barriers are moved between passes of a group by the optimizer
+
+    for(auto &passes : state.group_passes)
+    {
+        for(auto pass : passes)
+            state.restoreExtBarriers(pass);
+    }
+
+    for(size_t i = 0; i < buffers.size(); ++i)
+    {
+        if(!buffers[i].usages.empty())
+            processUnwaitedFirstUsage(buffers[i], state.buffer_states[i]);
+    }
+
+    for(size_t i = 0; i < images.size(); ++i)
+    {
+        if(!images[i].usages.empty())
+            processUnwaitedFirstUsage(images[i], state.image_states[i]);
+    }
+
+    {
+        auto generators = createBarrierGenerators(graph);
+
+        for(int index : dirty_groups)
+        {
+            state.releases[index].buffer_barriers.clear();
+            state.releases[index].image_barriers.clear();
+        }
+
+        parallelFor(
+            thread_pool_, dirty_groups.size(),
+            [&](uint32_t thread, size_t i)
+        {
+            const int index = dirty_groups[i];
+            generators[thread].fillBarriers(
+                compile_groups_[index], state.releases[index]);
+        });
+
+        for(auto &group_releases : state.releases)
+            group_releases.apply(dirty);
+    }
+
+    parallelFor(thread_pool_, dirty_groups.size(), [&](uint32_t, size_t i)
+    {
+        GroupBarrierOptimizer group_barrier_optimizer;
+        group_barrier_optimizer.optimize(compile_groups_[dirty_groups[i]]);
+    });
+
+    parallelFor(
+        output_memory_ == &memory_ ? thread_pool_ : nullptr,
+        dirty_groups.size(), [&](uint32_t, size_t i)
+    {
+        const int index = dirty_groups[i];
+        result.groups[index] = ExecutableGroup(*output_memory_);
+        fillExecutableGroup(*compile_groups_[index], result.groups[index]);
+    });
+
+    buffer_final_states_ = state.buffer_final_states;
+    image_final_states_  = state.image_final_states;
+
+    for(auto &record : buffers)
+    {
+        if(!record.usages.empty())
+            processUnsignaledFinalState(record);
+    }
+
+    for(auto &record : images)
+    {
+        if(!record.usages.empty())
+            processUnsignaledFinalState(record);
+    }
+
+    result.buffer_final_states = std::move(buffer_final_states_);
+    result.image_final_states  = std::move(image_final_states_);
+
+    return true;
+}
+
 void Compiler::setMessenger(std::function<void(const std::string &)> func)
 {
     if(func)
@@ -136,6 +633,23 @@ void Compiler::setMessenger(std::function<void(const std::string &)> func)
         msg_ = [](const std::string &) {};
 }
 
+const Queue *Compiler::getCanonicalQueue(const Queue *queue)
+{
+    const VkQueue raw_queue = queue->getRaw();
+    return canonical_queues_.try_emplace(raw_queue, queue).first->second;
+}
+
+void Compiler::canonicalizeGeneratedPassQueues()
+{
+    // queues of waits/signals are taken as given by the semaphore handlers
+
+    for(auto pass : generated_pre_passes_)
+        pass->queue = getCanonicalQueue(pass->queue);
+
+    for(auto pass : generated_post_passes_)
+        pass->queue = getCanonicalQueue(pass->queue);
+}
+
 void Compiler::initializeCompilePasses(const Graph &graph)
 {
     Vector<CompilePass *> raw_to_compile(&memory_);
@@ -153,12 +667,15 @@ void Compiler::initializeCompilePasses(const Graph &graph)
         compile_pass->queue    = raw_pass->getPassQueue();
         if(!compile_pass->queue)
             fatal("pass {}'s queue is nil", raw_pass->getPassName());
+        compile_pass->queue = getCanonicalQueue(compile_pass->queue);
 
-        compile_passes_.insert(compile_pass);
+        compile_passes_.push_back(compile_pass);
         raw_to_compile.push_back(compile_pass);
-
     }
 
+    if(incremental_)
+        incremental_->raw_passes = raw_to_compile;
+
     // copy heads/tails
 
     for(auto compile_pass : compile_passes_)
@@ -172,6 +689,307 @@ void Compiler::initializeCompilePasses(const Graph &graph)
     }
 }
 
+Set<CompilePass *> Compiler::findDisabledPasses(const Graph &graph)
+{
+    // passes using waited/signaled resources are kept, as their semaphores
+    // need a usage to be handled, and so are passes with fences, which must
+    // still be signaled. the executor skips their callbacks
+
+    Set<VkImage> synced_images(&memory_);
+    for(auto &image_range : std::views::keys(graph.image_waits_))
+        synced_images.insert(static_cast<VkImage>(image_range.get()));
+    for(auto &image_range : std::views::keys(graph.image_signals_))
+        synced_images.insert(static_cast<VkImage>(image_range.get()));
+
+    auto is_removable = [&](const CompilePass *pass)
+    {
+        auto raw_pass = pass->raw_pass;
+        if(raw_pass->isEnabled() || !raw_pass->_getFences().empty())
+            return false;
+
+        for(auto &buffer : std::views::keys(raw_pass->_getBufferUsages()))
+        {
+            if(graph.buffer_waits_.contains(buffer) ||
+               graph.buffer_signals_.contains(buffer))
+                return false;
+        }
+
+        for(auto &image_range : std::views::keys(raw_pass->_getImageUsages()))
+        {
+            if(synced_images.contains(static_cast<VkImage>(image_range.get())))
+                return false;
+        }
+
+        return true;
+    };
+
+    Set<CompilePass *> result(&memory_);
+    for(auto pass : compile_passes_)
+    {
+        if(pass->raw_pass && is_removable(pass))
+            result.insert(pass);
+    }
+    return result;
+}
+
+void Compiler::removeDisabledPasses(const Graph &graph)
+{
+    // a disabled pass is dropped with its heads connected to its tails, so
+    // that the order of the remaining passes is kept
+
+    auto removed_passes = findDisabledPasses(graph);
+    if(removed_passes.empty())
+        return;
+
+    for(auto pass : compile_passes_)
+    {
+        if(!removed_passes.contains(pass))
+            continue;
+
+        for(auto head : pass->heads)
+        {
+            head->tails.erase(pass);
+            for(auto tail : pass->tails)
+            {
+                head->tails.insert(tail);
+                tail->heads.insert(head);
+            }
+        }
+
+        for(auto tail : pass->tails)
+            tail->heads.erase(pass);
+    }
+
+    std::erase_if(compile_passes_, [&](CompilePass *pass)
+    {
+        return removed_passes.contains(pass);
+    });
+}
+
+void Compiler::inferDependencies()
+{
+    // conflicting usages are ordered by pass registration order. two usages
+    // conflict unless both are shared reads in the same layout: a read that
+    // transitions the layout is ordered like a write. readers between two
+    // writes stay unordered, and the usage walk treats them as one run
+
+    auto add_arc = [](CompilePass *head, CompilePass *tail)
+    {
+        if(head != tail)
+        {
+            head->tails.insert(tail);
+            tail->heads.insert(head);
+        }
+    };
+
+    struct BufferAccess
+    {
+        explicit BufferAccess(std::pmr::memory_resource &memory)
+            : writer(nullptr), readers(&memory)
+        {
+            
+        }
+
+        CompilePass          *writer;
+        Vector<CompilePass *> readers;
+    };
+
+    struct ImageAccess
+    {
+        CompilePass              *pass;
+        vk::ImageSubresourceRange range;
+        vk::ImageLayout           exit_layout;
+        bool                      is_write;
+    };
+
+    auto overlaps = [](
+        const vk::ImageSubresourceRange &a, const vk::ImageSubresourceRange &b)
+    {
+        return (a.aspectMask & b.aspectMask) &&
+               a.baseMipLevel < b.baseMipLevel + b.levelCount &&
+               b.baseMipLevel < a.baseMipLevel + a.levelCount &&
+               a.baseArrayLayer < b.baseArrayLayer + b.layerCount &&
+               b.baseArrayLayer < a.baseArrayLayer + a.layerCount;
+    };
+
+    auto contains = [](
+        const vk::ImageSubresourceRange &a, const vk::ImageSubresourceRange &b)
+    {
+        return (a.aspectMask & b.aspectMask) == b.aspectMask &&
+               a.baseMipLevel <= b.baseMipLevel &&
+               b.baseMipLevel + b.levelCount <= a.baseMipLevel + a.levelCount &&
+               a.baseArrayLayer <= b.baseArrayLayer &&
+               b.baseArrayLayer + b.layerCount <=
+                    a.baseArrayLayer + a.layerCount;
+    };
+
+    HashMap<VkBuffer, BufferAccess>       buffers(&memory_);
+    HashMap<VkImage, Vector<ImageAccess>> images(&memory_);
+
+    for(auto pass : compile_passes_)
+    {
+        auto raw_pass = pass->raw_pass;
+
+        for(auto &[buffer, usage] : raw_pass->_getBufferUsages())
+        {
+            auto &access = buffers.try_emplace(
+                static_cast<VkBuffer>(buffer.get()), memory_).first->second;
+
+            if(isSharedRead(usage))
+            {
+                if(access.writer)
+                    add_arc(access.writer, pass);
+                access.readers.push_back(pass);
+                continue;
+            }
+
+            // readers are ordered after the last writer
+
+            if(access.readers.empty() && access.writer)
+                add_arc(access.writer, pass);
+            for(auto reader : access.readers)
+                add_arc(reader, pass);
+            access.readers.clear();
+            access.writer = pass;
+        }
+
+        for(auto &[image_range, usage] : raw_pass->_getImageUsages())
+        {
+            auto &accesses = images.try_emplace(
+                static_cast<VkImage>(image_range.get()),
+                Vector<ImageAccess>(&memory_)).first->second;
+
+            auto &range = image_range.range;
+
+            bool is_write = !isSharedRead(usage);
+            for(auto &access : accesses)
+            {
+                if(overlaps(access.range, range) &&
+                   access.exit_layout != usage.layout)
+                    is_write = true;
+            }
+
+            for(auto &access : accesses)
+            {
+                if(overlaps(access.range, range) &&
+                   (is_write || access.is_write))
+                    add_arc(access.pass, pass);
+            }
+
+            // accesses covered by a write are ordered before it, and so
+            // before anything conflicting with them later. a read can't
+            // replace them, as later reads are not ordered after it
+
+            if(is_write)
+            {
+                std::erase_if(accesses, [&](const ImageAccess &access)
+                {
+                    return contains(range, access.range);
+                });
+            }
+
+            accesses.push_back({ pass, range, usage.exit_layout, is_write });
+        }
+    }
+}
+
+Set<CompilePass *> Compiler::findLivePasses(
+    const Graph              &graph,
+    const Set<CompilePass *> &removed_passes)
+{
+    // waited/signaled resources must keep at least one usage for their
+    // semaphores to be handled, so any usage of them makes a pass live.
+    // other outputs only keep the passes writing them.
+    // generated passes and passes holding semaphores only exist when
+    // recompiling, and are kept as they are
+
+    Set<VkImage> synced_images(&memory_);
+    Set<VkImage> output_images(&memory_);
+
+    for(auto &image_range : std::views::keys(graph.image_waits_))
+        synced_images.insert(static_cast<VkImage>(image_range.get()));
+    for(auto &image_range : std::views::keys(graph.image_signals_))
+        synced_images.insert(static_cast<VkImage>(image_range.get()));
+    for(auto &image : graph.output_images_)
+        output_images.insert(static_cast<VkImage>(image.get()));
+
+    auto is_root = [&](const CompilePass *pass)
+    {
+        auto raw_pass = pass->raw_pass;
+        if(!raw_pass || !pass->wait_semaphores.empty() ||
+           !pass->signal_semaphores.empty())
+            return true;
+
+        if(!raw_pass->_getFences().empty())
+            return true;
+
+        for(auto &[buffer, usage] : raw_pass->_getBufferUsages())
+        {
+            if(graph.buffer_waits_.contains(buffer) ||
+               graph.buffer_signals_.contains(buffer))
+                return true;
+            if(!GroupBarrierOptimizer::isReadOnly(usage.access) &&
+               graph.output_buffers_.contains(buffer))
+                return true;
+        }
+
+        for(auto &[image_range, usage] : raw_pass->_getImageUsages())
+        {
+            const auto image = static_cast<VkImage>(image_range.get());
+            if(synced_images.contains(image))
+                return true;
+            if(!GroupBarrierOptimizer::isReadOnly(usage.access) &&
+               output_images.contains(image))
+                return true;
+        }
+
+        return false;
+    };
+
+    // every ancestor of a live pass is live
+
+    Set<CompilePass *> live_passes(&memory_);
+    PmrQueue<CompilePass *> next_passes(&memory_);
+
+    for(auto pass : compile_passes_)
+    {
+        if(!removed_passes.contains(pass) && is_root(pass))
+            next_passes.push(pass);
+    }
+
+    while(!next_passes.empty())
+    {
+        auto pass = next_passes.front();
+        next_passes.pop();
+        if(!live_passes.insert(pass).second)
+            continue;
+        for(auto head : pass->heads)
+            next_passes.push(head);
+    }
+
+    return live_passes;
+}
+
+void Compiler::cullDeadPasses(const Graph &graph)
+{
+    auto live_passes = findLivePasses(graph, Set<CompilePass *>(&memory_));
+    if(live_passes.size() == compile_passes_.size())
+        return;
+
+    std::erase_if(compile_passes_, [&](CompilePass *pass)
+    {
+        return !live_passes.contains(pass);
+    });
+
+    for(auto pass : compile_passes_)
+    {
+        std::erase_if(pass->tails, [&](CompilePass *tail)
+        {
+            return !live_passes.contains(tail);
+        });
+    }
+}
+
 void Compiler::topologySortCompilePasses()
 {
     PmrQueue<CompilePass *> next_passes(&memory_);
@@ -202,11 +1020,127 @@ void Compiler::topologySortCompilePasses()
         }
     }
 
-    assert(sorted_compile_passes_.size() == compile_passes_.size());
+    // explicit dependencies may contradict inferred ones
+
+    if(sorted_compile_passes_.size() != compile_passes_.size())
+        fatal("pass dependencies contain a cycle");
+
     for(size_t i = 0; i < sorted_compile_passes_.size(); ++i)
         sorted_compile_passes_[i]->sorted_index = static_cast<int>(i);
 }
 
+void Compiler::assignQueues(const Graph &graph)
+{
+    const bool has_alternative = std::ranges::any_of(
+        sorted_compile_passes_, [](const CompilePass *pass)
+    {
+        return pass->raw_pass->getAlternativeQueue() != nullptr;
+    });
+    if(!has_alternative && graph.equivalent_queues_.empty())
+        return;
+
+    // queue -> queues it can be replaced with
+
+    HashMap<const Queue *, Vector<const Queue *>> equivalent_queues(&memory_);
+    for(auto &queues : graph.equivalent_queues_)
+    {
+        for(auto queue : queues)
+        {
+            auto &candidates = equivalent_queues[getCanonicalQueue(queue)];
+            for(auto candidate : queues)
+                candidates.push_back(getCanonicalQueue(candidate));
+        }
+    }
+
+    // greedy list scheduling in topological order: each pass goes to the
+    // queue where it is estimated to finish earliest, accounting for
+    // semaphores with heads on other queues and ownership transfers of
+    // resources last used on other queues
+
+    HashMap<const Queue *, float>       queue_available_time(&memory_);
+    HashMap<const CompilePass *, float> finish_times(&memory_);
+    HashMap<VkBuffer, const Queue *>    buffer_queues(&memory_);
+    HashMap<VkImage, const Queue *>     image_queues(&memory_);
+
+    auto estimate = [&](const CompilePass *pass, const Queue *queue)
+    {
+        float ready_time = queue_available_time[queue];
+        for(auto head : pass->heads)
+        {
+            float head_time = finish_times.at(head);
+            if(head->queue != queue)
+                head_time += graph.semaphore_cost_;
+            ready_time = (std::max)(ready_time, head_time);
+        }
+
+        int transfer_count = 0;
+        for(auto &[buffer, _] : pass->raw_pass->_getBufferUsages())
+        {
+            auto it = buffer_queues.find(static_cast<VkBuffer>(buffer.get()));
+            if(it != buffer_queues.end() &&
+               it->second->getFamilyIndex() != queue->getFamilyIndex())
+                ++transfer_count;
+        }
+        for(auto &[image_range, _] : pass->raw_pass->_getImageUsages())
+        {
+            auto it = image_queues.find(
+                static_cast<VkImage>(image_range.get()));
+            if(it != image_queues.end() &&
+               it->second->getFamilyIndex() != queue->getFamilyIndex())
+                ++transfer_count;
+        }
+
+        return ready_time +
+               transfer_count * graph.transfer_cost_ +
+               pass->raw_pass->getEstimatedDuration();
+    };
+
+    for(auto pass : sorted_compile_passes_)
+    {
+        float finish_time = estimate(pass, pass->queue);
+
+        auto try_queue = [&](const Queue *queue)
+        {
+            if(queue == pass->queue)
+                return;
+            const float queue_finish_time = estimate(pass, queue);
+            if(queue_finish_time < finish_time)
+            {
+                pass->queue = queue;
+                finish_time = queue_finish_time;
+            }
+        };
+
+        auto try_equivalent_queues = [&](const Queue *queue)
+        {
+            if(auto it = equivalent_queues.find(queue);
+               it != equivalent_queues.end())
+            {
+                for(auto candidate : it->second)
+                    try_queue(candidate);
+            }
+        };
+
+        const Queue *original_queue = pass->queue;
+        try_equivalent_queues(original_queue);
+
+        if(const Queue *alternative = pass->raw_pass->getAlternativeQueue())
+        {
+            alternative = getCanonicalQueue(alternative);
+            try_queue(alternative);
+            try_equivalent_queues(alternative);
+        }
+
+        finish_times[pass] = finish_time;
+        queue_available_time[pass->queue] = finish_time;
+
+        for(auto &[buffer, _] : pass->raw_pass->_getBufferUsages())
+            buffer_queues[static_cast<VkBuffer>(buffer.get())] = pass->queue;
+        for(auto &[image_range, _] : pass->raw_pass->_getImageUsages())
+            image_queues[static_cast<VkImage>(image_range.get())] = pass->queue;
+    }
+}
+
 void Compiler::buildTransitiveClosure()
 {
     closure_ = arena_.create<DAGTransitiveClosure>(
@@ -221,60 +1155,151 @@ void Compiler::buildTransitiveClosure()
     closure_->computeClosure();
 }
 
-void Compiler::collectResourceUsages()
+void Compiler::collectResourceUsages(const Graph &graph)
 {
-    resource_records_.build(sorted_compile_passes_);
+    // waited/signaled ranges must not be split across image records
 
-#ifdef VKPT_DEBUG
+    Vector<ImageSubresourceRange> extra_image_ranges(&memory_);
+    for(auto &image_range : std::views::keys(graph.image_waits_))
+        extra_image_ranges.push_back(image_range);
+    for(auto &image_range : std::views::keys(graph.image_signals_))
+        extra_image_ranges.push_back(image_range);
+
+    resource_records_.build(
+        sorted_compile_passes_, extra_image_ranges, thread_pool_);
+}
 
-    for(auto &[buffer, record] : resource_records_.getBuffers())
+void Compiler::validateResourceUsageOrder()
+{
+    // every user of a record must be after all passes of the previous run
+
+    auto validate = [&](auto &usages, const char *type, const std::string &name)
     {
-        for(auto it = std::next(record.usages.begin());
-            it != record.usages.end(); ++it)
+        for(auto it = usages.begin(); it != usages.end(); ++it)
         {
-            auto prev = std::prev(it);
-            if(!closure_->isReachable(
-                prev->pass->sorted_index, it->pass->sorted_index))
+            auto [prev_begin, prev_end] = getPrevRun(usages, it);
+            for(auto jt = prev_begin; jt != prev_end; ++jt)
             {
-                fatal(
-                    "users of buffer {} are not ordered", buffer.getName());
+                if(!closure_->isReachable(
+                    jt->pass->sorted_index, it->pass->sorted_index))
+                    fatal("users of {} {} are not ordered", type, name);
             }
         }
-    }
+    };
+
+    for(auto &record : resource_records_.getBuffers())
+        validate(record.usages, "buffer", record.resource.getName());
+
+    for(auto &record : resource_records_.getImages())
+        validate(record.usages, "image", record.resource.image.getName());
+}
+
+template<typename Usage>
+bool Compiler::needsEntryJoin(
+    const ResourceState &state, const Usage &first_usage)
+{
+    constexpr bool is_buffer = std::is_same_v<Usage, CompileBufferUsage>;
+
+    // only a plain barrier from the same queue can be repeated for every
+    // pass of the run. see processUnwaitedFirstUsage
 
-    for(auto &[image_subrsc, record] : resource_records_.getImages())
+    return state.match(
+        [&](const FreeState &s)
     {
-        for(auto it = std::next(record.usages.begin());
-            it != record.usages.end(); ++it)
+        if constexpr(is_buffer)
+            return false;
+        else
+            return s.layout != first_usage.layout;
+    },
+        [&](const UsingState &s)
+    {
+        if(getCanonicalQueue(s.queue) != first_usage.pass->queue)
+            return true;
+        if constexpr(is_buffer)
+            return false;
+        else
+            return s.layout != first_usage.layout;
+    },
+        [&](const ReleasedState &)
+    {
+        return true;
+    });
+}
+
+template<typename Usages>
+bool Compiler::keepsStructure(
+    Usages                   &usages,
+    const ResourceState      &state,
+    GlobalGroupDependencyLUT &dependencies)
+{
+    // joins, dummy passes and inter-group arcs are those of the compiled
+    // graph, so the remaining usages must not need others:
+    //    1. a first run of several passes needs no entry join
+    //    2. the incoming state needs no dummy pass on another queue
+    //    3. ownership is only transferred between single-pass runs
+    //    4. neighboring runs on different queues are connected by group arcs
+
+    if(usages.empty())
+        return true;
+
+    auto &first_usage = usages.front();
+    if(std::next(usages.begin()) != getRunEnd(usages, usages.begin()) &&
+       needsEntryJoin(state, first_usage))
+        return false;
+
+    if(state.is<UsingState>() &&
+       getCanonicalQueue(state.as<UsingState>().queue) !=
+            first_usage.pass->queue)
+        return false;
+
+    for(auto first = usages.begin();;)
+    {
+        auto last = getRunEnd(usages, first);
+        if(last == usages.end())
+            break;
+        auto next_last = getRunEnd(usages, last);
+
+        auto prev_queue = first->pass->queue;
+        auto queue = last->pass->queue;
+        if(prev_queue != queue)
         {
-            auto prev = std::prev(it);
-            if(!closure_->isReachable(
-                prev->pass->sorted_index, it->pass->sorted_index))
+            if(prev_queue->getFamilyIndex() != queue->getFamilyIndex() &&
+               (std::next(first) != last || std::next(last) != next_last))
+                return false;
+
+            for(auto it = first; it != last; ++it)
             {
-                fatal(
-                    "users of image {} are not ordered",
-                    image_subrsc.image.getName());
+                for(auto jt = last; jt != next_last; ++jt)
+                {
+                    if(!dependencies.findDependency(
+                        it->pass->group, jt->pass->group))
+                        return false;
+                }
             }
         }
+
+        first = last;
     }
 
-#endif
+    return true;
 }
 
-template<typename Rsc>
-void Compiler::processUnwaitedFirstUsage(const Rsc &resource)
+template<typename Record>
+void Compiler::processUnwaitedFirstUsage(
+    Record &record, const ResourceState &state)
 {
-    constexpr bool is_buffer = std::is_same_v<Rsc, Buffer>;
+    constexpr bool is_buffer = std::is_same_v<Record, CompileBuffer>;
 
-    auto &record = resource_records_.getRecord(resource);
-    if(record.has_wait_semaphore)
+    // a dummy pass already stands for the incoming state
+    if(record.has_wait_semaphore || record.has_dummy_pass)
         return;
 
+    auto &resource = record.resource;
+
     assert(!record.usages.empty());
     auto &first_usage = record.usages.front();
     CompilePass *first_pass = first_usage.pass;
 
-    const ResourceState &state = resource.getState();
     state.match(
         [&](const FreeState &s)
     {
@@ -282,7 +1307,7 @@ void Compiler::processUnwaitedFirstUsage(const Rsc &resource)
         {
             if(s.layout != first_usage.layout)
             {
-                first_pass->pre_ext_image_barriers.insert(
+                first_pass->pre_ext_image_barriers.push_back(
                     vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = vk::PipelineStageFlagBits2KHR::eBottomOfPipe,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -293,55 +1318,64 @@ void Compiler::processUnwaitedFirstUsage(const Rsc &resource)
                         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                         .image               = resource.get(),
-                        .subresourceRange    = subrscToRange(resource.subrsc)
+                        .subresourceRange    = resource.range
                     });
             }
         }
     },
         [&](const UsingState &s)
     {
-        if(s.queue == first_usage.pass->queue)
+        const Queue *state_queue = getCanonicalQueue(s.queue);
+        if(state_queue == first_usage.pass->queue)
         {
-            if constexpr(is_buffer)
-            {
-                first_pass->pre_ext_buffer_barriers.insert(
-                    vk::BufferMemoryBarrier2KHR{
-                        .srcStageMask        = s.stages,
-                        .srcAccessMask       = s.access,
-                        .dstStageMask        = first_usage.stages,
-                        .dstAccessMask       = first_usage.access,
-                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .buffer              = resource.get(),
-                        .offset              = 0,
-                        .size                = VK_WHOLE_SIZE
-                    });
-            }
-            else
+            // every pass of a first run waits for the previous user. the
+            // first run has a join pass if a layout transition is needed
+
+            auto run_end = getRunEnd(record.usages, record.usages.begin());
+            for(auto it = record.usages.begin(); it != run_end; ++it)
             {
-                first_pass->pre_ext_image_barriers.insert(
-                    vk::ImageMemoryBarrier2KHR{
-                        .srcStageMask        = s.stages,
-                        .srcAccessMask       = s.access,
-                        .dstStageMask        = first_usage.stages,
-                        .dstAccessMask       = first_usage.access,
-                        .oldLayout           = s.layout,
-                        .newLayout           = first_usage.layout,
-                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .image               = resource.get(),
-                        .subresourceRange    = subrscToRange(resource.subrsc)
-                    });
+                if constexpr(is_buffer)
+                {
+                    it->pass->pre_ext_buffer_barriers.push_back(
+                        vk::BufferMemoryBarrier2KHR{
+                            .srcStageMask        = s.stages,
+                            .srcAccessMask       = s.access,
+                            .dstStageMask        = it->stages,
+                            .dstAccessMask       = it->access,
+                            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .buffer              = resource.get(),
+                            .offset              = 0,
+                            .size                = VK_WHOLE_SIZE
+                        });
+                }
+                else
+                {
+                    it->pass->pre_ext_image_barriers.push_back(
+                        vk::ImageMemoryBarrier2KHR{
+                            .srcStageMask        = s.stages,
+                            .srcAccessMask       = s.access,
+                            .dstStageMask        = it->stages,
+                            .dstAccessMask       = it->access,
+                            .oldLayout           = s.layout,
+                            .newLayout           = it->layout,
+                            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                            .image               = resource.get(),
+                            .subresourceRange    = resource.range
+                        });
+                }
             }
         }
         else
         {
             auto dummy_pass = arena_.create<CompilePass>(memory_);
-            dummy_pass->queue = s.queue;
+            dummy_pass->queue = state_queue;
             generated_pre_passes_.push_back(dummy_pass);
 
             dummy_pass->tails.insert(first_pass);
             first_pass->heads.insert(dummy_pass);
+            record.has_dummy_pass = true;
 
             if constexpr(is_buffer)
             {
@@ -350,8 +1384,6 @@ void Compiler::processUnwaitedFirstUsage(const Rsc &resource)
                     .stages = s.stages,
                     .access = s.access
                 });
-                dummy_pass->generated_buffer_usages[resource] =
-                    record.usages.front();
             }
             else
             {
@@ -362,8 +1394,6 @@ void Compiler::processUnwaitedFirstUsage(const Rsc &resource)
                     .layout      = s.layout,
                     .exit_layout = s.layout
                 });
-                dummy_pass->generated_image_usages[resource] =
-                    record.usages.front();
             }
         }
     },
@@ -375,15 +1405,16 @@ void Compiler::processUnwaitedFirstUsage(const Rsc &resource)
     });
 }
 
-template<typename Rsc>
-void Compiler::processUnsignaledFinalState(const Rsc &rsc)
+template<typename Record>
+void Compiler::processUnsignaledFinalState(Record &record)
 {
-    constexpr bool is_buffer = std::is_same_v<Rsc, Buffer>;
+    constexpr bool is_buffer = std::is_same_v<Record, CompileBuffer>;
 
-    auto &record = resource_records_.getRecord(rsc);
     if(record.has_signal_semaphore)
         return;
 
+    auto &rsc = record.resource;
+
     assert(!record.usages.empty());
     auto &last_usage = record.usages.back();
 
@@ -406,9 +1437,189 @@ void Compiler::processUnsignaledFinalState(const Rsc &rsc)
     }
 }
 
-void Compiler::mergeNeighboringReadOnlyUsages()
+void Compiler::mergeNeighboringReadOnlyUsages(const Graph &graph)
 {
-    // TODO
+    // passes of a run are not ordered, so whatever must happen once for a
+    // run gets a join pass of its own, inserted next to the run: waits and
+    // initial state transitions before a first run, signals after a last
+    // run, and queue family ownership transfers between runs. neighboring
+    // runs of reads on different queues are ordered here, as dependency
+    // inference happens before queues are assigned
+
+    auto add_arc = [](CompilePass *head, CompilePass *tail)
+    {
+        head->tails.insert(tail);
+        tail->heads.insert(head);
+    };
+
+    // joins are inserted before the pass with the given sorted index
+
+    Vector<std::pair<int, CompilePass *>> joins(&memory_);
+
+    auto create_join = [&](const Queue *queue, int sorted_index)
+    {
+        auto join = arena_.create<CompilePass>(memory_);
+        join->queue = queue;
+        compile_passes_.push_back(join);
+        joins.push_back({ sorted_index, join });
+        return join;
+    };
+
+    auto join_usage = [](CompilePass *join, auto first, auto last)
+    {
+        auto result = *first;
+        result.pass   = join;
+        result.access = vk::AccessFlagBits2KHR::eNone;
+        for(auto it = std::next(first); it != last; ++it)
+            result.stages |= it->stages;
+        return result;
+    };
+
+    auto process_record = [&](auto &record, bool waited, bool signaled)
+    {
+        auto &usages = record.usages;
+        using It = std::remove_cvref_t<decltype(usages.begin())>;
+
+        Vector<std::pair<It, It>> runs(&memory_);
+        for(auto first = usages.begin(); first != usages.end();)
+        {
+            auto last = getRunEnd(usages, first);
+            runs.push_back({ first, last });
+            first = last;
+        }
+
+        for(size_t i = 1; i < runs.size(); ++i)
+        {
+            auto [prev_first, prev_last] = runs[i - 1];
+            auto [first, last] = runs[i];
+
+            auto prev_queue = prev_first->pass->queue;
+            auto queue = first->pass->queue;
+            if(prev_queue == queue)
+                continue;
+
+            const bool is_prev_joined = std::next(prev_first) != prev_last;
+            const bool is_joined = std::next(first) != last;
+
+            if(prev_queue->getFamilyIndex() != queue->getFamilyIndex() &&
+               (is_prev_joined || is_joined))
+            {
+                CompilePass *head = prev_first->pass;
+                if(is_prev_joined)
+                {
+                    head = create_join(prev_queue, first->pass->sorted_index);
+                    for(auto it = prev_first; it != prev_last; ++it)
+                        add_arc(it->pass, head);
+                    usages.insert(first, join_usage(head, prev_first, prev_last));
+                }
+
+                CompilePass *tail = first->pass;
+                if(is_joined)
+                {
+                    tail = create_join(queue, first->pass->sorted_index);
+                    for(auto it = first; it != last; ++it)
+                        add_arc(tail, it->pass);
+                    usages.insert(first, join_usage(tail, first, last));
+                }
+
+                add_arc(head, tail);
+            }
+            else if(isSharedRead(*prev_first) && isSharedRead(*first))
+            {
+                for(auto it = prev_first; it != prev_last; ++it)
+                {
+                    for(auto jt = first; jt != last; ++jt)
+                        add_arc(it->pass, jt->pass);
+                }
+            }
+        }
+
+        auto [entry_first, entry_last] = runs.front();
+        if(std::next(entry_first) != entry_last &&
+           (waited || needsEntryJoin(
+               getResourceState(record.resource), *entry_first)))
+        {
+            auto join = create_join(
+                entry_first->pass->queue, entry_first->pass->sorted_index);
+            for(auto it = entry_first; it != entry_last; ++it)
+                add_arc(join, it->pass);
+            usages.push_front(join_usage(join, entry_first, entry_last));
+        }
+
+        auto [exit_first, exit_last] = runs.back();
+        if(std::next(exit_first) != exit_last && signaled)
+        {
+            auto join = create_join(
+                exit_first->pass->queue,
+                std::prev(exit_last)->pass->sorted_index + 1);
+            for(auto it = exit_first; it != exit_last; ++it)
+                add_arc(it->pass, join);
+            usages.push_back(join_usage(join, exit_first, exit_last));
+        }
+    };
+
+    auto &images = resource_records_.getImages();
+
+    Vector<int> indices(&memory_);
+    Vector<bool> waited_images(images.size(), false, &memory_);
+    Vector<bool> signaled_images(images.size(), false, &memory_);
+
+    for(auto &image_range : std::views::keys(graph.image_waits_))
+    {
+        indices.clear();
+        resource_records_.getRecords(image_range, indices);
+        for(int index : indices)
+            waited_images[index] = true;
+    }
+
+    for(auto &image_range : std::views::keys(graph.image_signals_))
+    {
+        indices.clear();
+        resource_records_.getRecords(image_range, indices);
+        for(int index : indices)
+            signaled_images[index] = true;
+    }
+
+    for(auto &record : resource_records_.getBuffers())
+    {
+        process_record(
+            record,
+            graph.buffer_waits_.contains(record.resource),
+            graph.buffer_signals_.contains(record.resource));
+    }
+
+    for(auto &record : images)
+    {
+        process_record(
+            record,
+            waited_images[record.index],
+            signaled_images[record.index]);
+    }
+
+    if(joins.empty())
+        return;
+
+    // passes stay in topological order, as each join is placed after its
+    // heads and before its tails
+
+    std::ranges::stable_sort(joins, {}, &std::pair<int, CompilePass *>::first);
+
+    Vector<CompilePass *> new_sorted_compile_passes(&memory_);
+    new_sorted_compile_passes.reserve(
+        sorted_compile_passes_.size() + joins.size());
+
+    auto join_it = joins.begin();
+    for(int i = 0; i <= static_cast<int>(sorted_compile_passes_.size()); ++i)
+    {
+        for(; join_it != joins.end() && join_it->first == i; ++join_it)
+            new_sorted_compile_passes.push_back(join_it->second);
+        if(i < static_cast<int>(sorted_compile_passes_.size()))
+            new_sorted_compile_passes.push_back(sorted_compile_passes_[i]);
+    }
+
+    sorted_compile_passes_ = std::move(new_sorted_compile_passes);
+    for(size_t i = 0; i < sorted_compile_passes_.size(); ++i)
+        sorted_compile_passes_[i]->sorted_index = static_cast<int>(i);
 }
 
 void Compiler::mergeGeneratedPreAndPostPasses()
@@ -416,12 +1627,12 @@ void Compiler::mergeGeneratedPreAndPostPasses()
     std::copy(
         generated_pre_passes_.begin(),
         generated_pre_passes_.end(),
-        agz::misc::direct_inserter(compile_passes_));
+        std::back_inserter(compile_passes_));
 
     std::copy(
         generated_post_passes_.begin(),
         generated_post_passes_.end(),
-        agz::misc::direct_inserter(compile_passes_));
+        std::back_inserter(compile_passes_));
 
     Vector<CompilePass *> new_sorted_compile_passes(&memory_);
     new_sorted_compile_passes.reserve(
@@ -471,7 +1682,7 @@ void Compiler::addGroupFlag(CompilePass *entry, size_t bit_index)
                 next_passes.push(succ);
         }
 
-        pass->group_flags.set(bit_index, true);
+        pass->group_flags.set(bit_index);
     }
 }
 
@@ -604,7 +1815,29 @@ void Compiler::topologySortGroups(const List<CompileGroup *> &groups)
 
 void Compiler::topologySortPassesInGroup(CompileGroup *group)
 {
-    PmrQueue<CompilePass *> next_passes(&memory_);
+    // list scheduling. among ready passes, the one whose latest in-group
+    // head was scheduled earliest goes first, so that consumers are placed
+    // as far as possible from their producers and consumers of the same
+    // producers tend to be adjacent, sharing one batched barrier.
+    // ties are broken by the global topology order
+
+    struct ReadyPass
+    {
+        int          last_head_index;
+        int          sorted_index;
+        CompilePass *pass;
+
+        bool operator<(const ReadyPass &rhs) const
+        {
+            // std::priority_queue pops the largest element
+            return std::tie(last_head_index, sorted_index) >
+                   std::tie(rhs.last_head_index, rhs.sorted_index);
+        }
+    };
+
+    std::priority_queue<ReadyPass, Vector<ReadyPass>> next_passes(
+        std::less<ReadyPass>(), Vector<ReadyPass>(&memory_));
+
     for(auto pass : group->passes)
     {
         int head_count = 0;
@@ -613,7 +1846,7 @@ void Compiler::topologySortPassesInGroup(CompileGroup *group)
         pass->unprocessed_head_count = head_count;
 
         if(!head_count)
-            next_passes.push(pass);
+            next_passes.push({ -1, pass->sorted_index, pass });
     }
 
     Vector<CompilePass *> sorted_passes(&memory_);
@@ -621,26 +1854,61 @@ void Compiler::topologySortPassesInGroup(CompileGroup *group)
 
     while(!next_passes.empty())
     {
-        auto pass = next_passes.front();
+        auto pass = next_passes.top().pass;
         next_passes.pop();
 
         assert(!pass->unprocessed_head_count);
+        pass->sorted_index_in_group = static_cast<int>(sorted_passes.size());
         sorted_passes.push_back(pass);
 
         for(auto tail : pass->tails)
         {
-            if(tail->group == group && !--tail->unprocessed_head_count)
-                next_passes.push(tail);
+            if(tail->group != group || --tail->unprocessed_head_count)
+                continue;
+
+            // all in-group heads of tail are scheduled, and pass is the
+            // latest of them
+            next_passes.push({
+                pass->sorted_index_in_group, tail->sorted_index, tail
+            });
         }
     }
 
-    for(size_t i = 0; i < sorted_passes.size(); ++i)
-        sorted_passes[i]->sorted_index_in_group = static_cast<int>(i);
-
     assert(sorted_passes.size() == group->passes.size());
     group->passes.swap(sorted_passes);
 }
 
+bool Compiler::isSingleQueue() const
+{
+    // passes generated for semaphores or resources coming from other queues
+    // need inter-group synchronization
+
+    if(!generated_pre_passes_.empty() || !generated_post_passes_.empty())
+        return false;
+
+    return std::ranges::all_of(compile_passes_, [&](const CompilePass *pass)
+    {
+        return pass->queue == compile_passes_.front()->queue;
+    });
+}
+
+void Compiler::buildSingleGroup()
+{
+    if(sorted_compile_passes_.empty())
+        return;
+
+    auto group = arena_.create<CompileGroup>(memory_);
+    group->queue = sorted_compile_passes_.front()->queue;
+    group->passes.assign(
+        sorted_compile_passes_.begin(), sorted_compile_passes_.end());
+
+    for(auto pass : group->passes)
+        pass->group = group;
+
+    compile_groups_.push_back(group);
+    topologySortPassesInGroup(group);
+}
+
 void Compiler::fillInterGroupSemaphores(SemaphoreAllocator &allocator)
 {
     for(auto group : compile_groups_)
@@ -653,18 +1921,20 @@ void Compiler::fillInterGroupSemaphores(SemaphoreAllocator &allocator)
     }
 }
 
-void Compiler::buildPassToUsage(CompileBuffer &record)
+Vector<GroupBarrierGenerator> Compiler::createBarrierGenerators(
+    const Graph &graph)
 {
-    assert(record.pass_to_usage.empty());
-    for(auto it = record.usages.begin(); it != record.usages.end(); ++it)
-        record.pass_to_usage.insert({ it->pass, it });
-}
+    const uint32_t thread_count =
+        thread_pool_ ? thread_pool_->getThreadCount() : 1;
 
-void Compiler::buildPassToUsage(CompileImage &record)
-{
-    assert(record.pass_to_usage.empty());
-    for(auto it = record.usages.begin(); it != record.usages.end(); ++it)
-        record.pass_to_usage.insert({ it->pass, it });
+    Vector<GroupBarrierGenerator> generators(&memory_);
+    generators.reserve(thread_count);
+    for(uint32_t i = 0; i < thread_count; ++i)
+    {
+        generators.emplace_back(
+            memory_, resource_records_, graph.event_allocator_ != nullptr);
+    }
+    return generators;
 }
 
 void Compiler::fillExecutableGroup(
@@ -673,9 +1943,19 @@ void Compiler::fillExecutableGroup(
     output.queue = group.queue;
     output.passes.reserve(group.passes.size());
 
+    output.events.reserve(group.events.size());
+    for(auto &event : group.events)
+    {
+        output.events.emplace_back(*output_memory_);
+        output.events.back().buffer_barriers.assign(
+            event.buffer_barriers.begin(), event.buffer_barriers.end());
+        output.events.back().image_barriers.assign(
+            event.image_barriers.begin(), event.image_barriers.end());
+    }
+
     for(auto pass : group.passes)
     {
-        output.passes.emplace_back(memory_);
+        output.passes.emplace_back(*output_memory_);
         auto &output_pass = output.passes.back();
 
         output_pass.pass = pass->raw_pass;
@@ -702,29 +1982,28 @@ void Compiler::fillExecutableGroup(
             pass->pre_ext_image_barriers.end(),
             std::back_inserter(output_pass.pre_image_barriers));
 
-        output_pass.post_buffer_barriers.reserve(
-            pass->post_ext_buffer_barriers.size());
-        std::copy(
+        output_pass.post_buffer_barriers.assign(
             pass->post_ext_buffer_barriers.begin(),
-            pass->post_ext_buffer_barriers.end(),
-            std::back_inserter(output_pass.post_buffer_barriers));
+            pass->post_ext_buffer_barriers.end());
 
-        output_pass.post_image_barriers.reserve(
-            pass->post_ext_image_barriers.size());
-        std::copy(
+        output_pass.post_image_barriers.assign(
             pass->post_ext_image_barriers.begin(),
-            pass->post_ext_image_barriers.end(),
-            std::back_inserter(output_pass.post_image_barriers));
+            pass->post_ext_image_barriers.end());
 
         if(pass->pre_memory_barrier)
             output_pass.pre_memory_barrier = *pass->pre_memory_barrier;
         if(pass->post_memory_barrier)
             output_pass.post_memory_barrier = *pass->post_memory_barrier;
 
-        for(auto &[_, submit] : pass->wait_semaphores)
-            output.wait_semaphores.push_back(submit);
+        output_pass.set_events.assign(
+            pass->set_events.begin(), pass->set_events.end());
+        output_pass.wait_events.assign(
+            pass->wait_events.begin(), pass->wait_events.end());
+
+        std::ranges::copy(
+            pass->wait_semaphores, std::back_inserter(output.wait_semaphores));
 
-        for(auto &[_, submit] : pass->signal_semaphores)
+        for(auto &submit : pass->signal_semaphores)
         {
             output.signal_semaphores.push_back(vk::SemaphoreSubmitInfoKHR{
                 .semaphore = submit.semaphore,
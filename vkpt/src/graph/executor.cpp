@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <memory_resource>
+
 #include <vkpt/graph/executor.h>
 
 VKPT_GRAPH_BEGIN
@@ -6,13 +9,23 @@ ExecutablePass::ExecutablePass(std::pmr::memory_resource &memory)
     : pre_buffer_barriers(&memory),
       pre_image_barriers(&memory),
       post_buffer_barriers(&memory),
-      post_image_barriers(&memory)
+      post_image_barriers(&memory),
+      set_events(&memory),
+      wait_events(&memory)
+{
+    
+}
+
+ExecutableEvent::ExecutableEvent(std::pmr::memory_resource &memory)
+    : buffer_barriers(&memory),
+      image_barriers(&memory)
 {
     
 }
 
 ExecutableGroup::ExecutableGroup(std::pmr::memory_resource &memory)
     : passes(&memory),
+      events(&memory),
       wait_semaphores(&memory),
       signal_semaphores(&memory),
       signal_fences(&memory)
@@ -29,106 +42,364 @@ ExecutableGraph::ExecutableGraph(std::pmr::memory_resource &memory)
 }
 
 Executor::Executor()
-    : group_results_(&memory_)
+    : Executor(own_memory_)
+{
+    
+}
+
+Executor::Executor(std::pmr::memory_resource &memory)
+    : event_allocator_(nullptr), frame_synchronizer_(nullptr),
+      memory_(memory), group_results_(&memory_)
 {
     
 }
 
+void Executor::setEventAllocator(EventAllocator *event_allocator)
+{
+    event_allocator_ = event_allocator;
+}
+
+void Executor::setFrameSynchronizer(FrameSynchronizer *frame_synchronizer)
+{
+    frame_synchronizer_ = frame_synchronizer;
+}
+
 void Executor::record(
     CommandBufferAllocator &command_buffer_allocator,
     const ExecutableGraph  &graph)
 {
-    assert(group_results_.empty());
-    group_results_.resize(graph.groups.size());
+    initializeGroupResults(graph);
 
     for(size_t i = 0; i < graph.groups.size(); ++i)
     {
         auto &group = graph.groups[i];
         auto &result = group_results_[i];
 
-        result.group = &group;
-        result.command_buffers =
-            Vector<vk::CommandBufferSubmitInfoKHR>(&memory_);
-
         PassContext context(
             group.queue->getType(),
             command_buffer_allocator,
             result.command_buffers);
 
         for(auto &pass : group.passes)
+            recordPass(context, result, pass);
+
+        context.getCommandBuffer().end();
+    }
+
+    applyFinalStates(graph);
+}
+
+void Executor::record(
+    ThreadPool                               &thread_pool,
+    std::span<CommandBufferAllocator *const>  thread_allocators,
+    const ExecutableGraph                    &graph,
+    size_t                                    passes_per_task)
+{
+    assert(thread_allocators.size() >= thread_pool.getThreadCount());
+    assert(passes_per_task > 0);
+
+    // events are allocated before recording as the allocator is not
+    // required to be thread-safe
+
+    initializeGroupResults(graph);
+
+    struct Task
+    {
+        size_t group;
+        size_t pass_beg;
+        size_t pass_end;
+        Vector<vk::CommandBufferSubmitInfoKHR> command_buffers;
+    };
+
+    // task outputs are allocated from worker threads
+
+    std::pmr::synchronized_pool_resource task_memory(&memory_);
+
+    Vector<Task> tasks(&memory_);
+    for(size_t gi = 0; gi < graph.groups.size(); ++gi)
+    {
+        const size_t pass_count = graph.groups[gi].passes.size();
+        size_t beg = 0;
+        do
+        {
+            const size_t end = (std::min)(beg + passes_per_task, pass_count);
+            tasks.push_back(Task{
+                gi, beg, end,
+                Vector<vk::CommandBufferSubmitInfoKHR>(&task_memory)
+            });
+            beg = end;
+        } while(beg < pass_count);
+    }
+
+    thread_pool.parallelFor(tasks.size(), [&](uint32_t thread, size_t ti)
+    {
+        auto &task = tasks[ti];
+        auto &group = graph.groups[task.group];
+        auto &result = group_results_[task.group];
+
+        PassContext context(
+            group.queue->getType(),
+            *thread_allocators[thread],
+            task.command_buffers);
+
+        for(size_t i = task.pass_beg; i < task.pass_end; ++i)
+            recordPass(context, result, group.passes[i]);
+
+        context.getCommandBuffer().end();
+    });
+
+    for(auto &task : tasks)
+    {
+        auto &output = group_results_[task.group].command_buffers;
+        output.insert(
+            output.end(),
+            task.command_buffers.begin(),
+            task.command_buffers.end());
+    }
+
+    applyFinalStates(graph);
+}
+
+void Executor::submit()
+{
+    // consecutive groups on the same queue are submitted with one call,
+    // their order being kept by the submit order and their semaphores.
+    // a batch ends at a group signaling fences, as the fence of a call
+    // covers all of its submits
+
+    Vector<vk::SubmitInfo2KHR> submits(&memory_);
+
+    // the last group on each queue is followed by a submit signaling the
+    // frame timeline of that queue. a signal covers all previous submits
+    // of the queue
+
+    Vector<bool> is_last_on_queue(group_results_.size(), false, &memory_);
+    if(frame_synchronizer_)
+    {
+        Set<const Queue *> visited_queues(&memory_);
+        for(size_t j = group_results_.size(); j > 0; --j)
         {
-            if(pass.pre_memory_barrier ||
-              !pass.pre_buffer_barriers.empty() ||
-              !pass.pre_image_barriers.empty())
+            const Queue *queue = group_results_[j - 1].group->queue;
+            is_last_on_queue[j - 1] = visited_queues.insert(queue).second;
+        }
+    }
+
+    vk::SemaphoreSubmitInfoKHR frame_signal;
+
+    size_t i = 0;
+    while(i < group_results_.size())
+    {
+        const Queue *queue = group_results_[i].group->queue;
+        const ExecutableGroup *last_group = nullptr;
+
+        submits.clear();
+        while(i < group_results_.size() &&
+              group_results_[i].group->queue == queue)
+        {
+            auto &result = group_results_[i++];
+            auto &group = *result.group;
+
+            submits.push_back(vk::SubmitInfo2KHR{
+                .waitSemaphoreInfoCount   =
+                    static_cast<uint32_t>(group.wait_semaphores.size()),
+                .pWaitSemaphoreInfos      = group.wait_semaphores.data(),
+                .commandBufferInfoCount   =
+                    static_cast<uint32_t>(result.command_buffers.size()),
+                .pCommandBufferInfos      = result.command_buffers.data(),
+                .signalSemaphoreInfoCount =
+                    static_cast<uint32_t>(group.signal_semaphores.size()),
+                .pSignalSemaphoreInfos    = group.signal_semaphores.data()
+            });
+
+            if(is_last_on_queue[i - 1])
             {
-                vk::ArrayProxy<const vk::MemoryBarrier2KHR> memory_barrier;
-                if(pass.pre_memory_barrier)
-                {
-                    memory_barrier = vk::ArrayProxy<const vk::MemoryBarrier2KHR>
-                        { *pass.pre_memory_barrier };
-                }
-
-                context.getCommandBuffer().pipelineBarrier(
-                    memory_barrier,
-                    pass.pre_buffer_barriers,
-                    pass.pre_image_barriers);
+                frame_signal = frame_synchronizer_->newQueueSignal(queue);
+                submits.push_back(vk::SubmitInfo2KHR{
+                    .signalSemaphoreInfoCount = 1,
+                    .pSignalSemaphoreInfos    = &frame_signal
+                });
             }
 
-            if(pass.pass)
-                pass.pass->onPassRender(context);
-            
-            if(pass.post_memory_barrier ||
-              !pass.post_buffer_barriers.empty() ||
-              !pass.post_image_barriers.empty())
+            if(!group.signal_fences.empty())
             {
-                vk::ArrayProxy<const vk::MemoryBarrier2KHR> memory_barrier;
-                if(pass.pre_memory_barrier)
-                {
-                    memory_barrier = vk::ArrayProxy<const vk::MemoryBarrier2KHR>
-                    { *pass.pre_memory_barrier };
-                }
-
-                context.getCommandBuffer().pipelineBarrier(
-                    memory_barrier,
-                    pass.post_buffer_barriers,
-                    pass.post_image_barriers);
+                last_group = &group;
+                break;
             }
         }
 
-        context.getCommandBuffer().end();
+        if(!last_group)
+        {
+            queue->submit(submits, nullptr);
+            continue;
+        }
+
+        // a call signals only one fence, so the other ones are signaled by
+        // empty submits, which don't carry any work
+
+        queue->submit(submits, last_group->signal_fences.front());
+        for(size_t j = 1; j < last_group->signal_fences.size(); ++j)
+        {
+            queue->submit(
+                vk::ArrayProxy<const vk::SubmitInfo2KHR>{},
+                last_group->signal_fences[j]);
+        }
     }
+}
 
-    for(auto &[buffer, state] : graph.buffer_final_states)
+void Executor::initializeGroupResults(const ExecutableGraph &graph)
+{
+    assert(group_results_.empty());
+    group_results_.resize(graph.groups.size());
+
+    for(size_t i = 0; i < graph.groups.size(); ++i)
     {
-        auto b = buffer;
-        b.getState() = state;
+        auto &group = graph.groups[i];
+        auto &result = group_results_[i];
+
+        result.group = &group;
+        result.command_buffers =
+            Vector<vk::CommandBufferSubmitInfoKHR>(&memory_);
+        result.events = Vector<vk::Event>(&memory_);
+
+        if(event_allocator_)
+        {
+            result.events.reserve(group.events.size());
+            for(size_t j = 0; j < group.events.size(); ++j)
+                result.events.push_back(event_allocator_->newEvent());
+        }
+    }
+}
+
+void Executor::recordPass(
+    PassContext          &context,
+    const GroupResult    &result,
+    const ExecutablePass &pass)
+{
+    if(!pass.wait_events.empty())
+        waitEvents(context, result, pass);
+
+    if(pass.pre_memory_barrier ||
+      !pass.pre_buffer_barriers.empty() ||
+      !pass.pre_image_barriers.empty())
+    {
+        vk::ArrayProxy<const vk::MemoryBarrier2KHR> memory_barrier;
+        if(pass.pre_memory_barrier)
+        {
+            memory_barrier = vk::ArrayProxy<const vk::MemoryBarrier2KHR>
+                { *pass.pre_memory_barrier };
+        }
+
+        context.getCommandBuffer().pipelineBarrier(
+            memory_barrier,
+            pass.pre_buffer_barriers,
+            pass.pre_image_barriers);
     }
 
-    for(auto &[image, state] : graph.image_final_states)
+    if(pass.pass && pass.pass->isEnabled())
     {
-        auto i = image;
-        i.getState() = state;
+        pass.pass->onPassRender(context);
+
+        // render pass inheritance is only valid inside that render pass,
+        // which onPassRender has already ended
+        if(context._hasPendingRenderPassSecondaries())
+        {
+            throw VKPTException(
+                "secondary command buffers of a render pass are not executed "
+                "in pass {}", pass.pass->getPassName());
+        }
+        context.executeSecondaryCommandBuffers();
+    }
+
+    if(pass.post_memory_barrier ||
+      !pass.post_buffer_barriers.empty() ||
+      !pass.post_image_barriers.empty())
+    {
+        vk::ArrayProxy<const vk::MemoryBarrier2KHR> memory_barrier;
+        if(pass.post_memory_barrier)
+        {
+            memory_barrier = vk::ArrayProxy<const vk::MemoryBarrier2KHR>
+                { *pass.post_memory_barrier };
+        }
+
+        context.getCommandBuffer().pipelineBarrier(
+            memory_barrier,
+            pass.post_buffer_barriers,
+            pass.post_image_barriers);
+    }
+
+    if(!result.events.empty())
+    {
+        for(int index : pass.set_events)
+        {
+            auto &event = result.group->events[index];
+            context.getCommandBuffer().setEvent(
+                result.events[index],
+                event.buffer_barriers,
+                event.image_barriers);
+        }
     }
 }
 
-void Executor::submit()
+void Executor::waitEvents(
+    PassContext          &context,
+    const GroupResult    &result,
+    const ExecutablePass &pass)
 {
-    for(auto &result : group_results_)
+    auto &events = result.group->events;
+
+    if(result.events.empty())
+    {
+        for(int index : pass.wait_events)
+        {
+            context.getCommandBuffer().pipelineBarrier(
+                {}, events[index].buffer_barriers, events[index].image_barriers);
+        }
+        return;
+    }
+
+    std::vector<vk::Event>             handles;
+    std::vector<vk::DependencyInfoKHR> dependency_infos;
+    handles.reserve(pass.wait_events.size());
+    dependency_infos.reserve(pass.wait_events.size());
+
+    for(int index : pass.wait_events)
     {
-        auto &group = *result.group;
+        auto &event = events[index];
+        handles.push_back(result.events[index]);
+        dependency_infos.push_back(vk::DependencyInfoKHR{
+            .bufferMemoryBarrierCount =
+                static_cast<uint32_t>(event.buffer_barriers.size()),
+            .pBufferMemoryBarriers    = event.buffer_barriers.data(),
+            .imageMemoryBarrierCount  =
+                static_cast<uint32_t>(event.image_barriers.size()),
+            .pImageMemoryBarriers     = event.image_barriers.data()
+        });
+    }
 
-        group.queue->submit(
-            group.wait_semaphores,
-            group.signal_semaphores,
-            result.command_buffers,
-            group.signal_fences.empty() ?
-                nullptr : group.signal_fences.front());
+    context.getCommandBuffer().waitEvents(handles, dependency_infos);
+}
 
-        for(size_t i = 1; i < group.signal_fences.size(); ++i)
+void Executor::applyFinalStates(const ExecutableGraph &graph)
+{
+    for(auto &[buffer, state] : graph.buffer_final_states)
+    {
+        auto b = buffer;
+        b.getState() = state;
+    }
+
+    for(auto &[image_range, state] : graph.image_final_states)
+    {
+        auto image = image_range.image;
+        auto aspects = image_range.range.aspectMask;
+        foreachAspect(aspects, [&](vk::ImageAspectFlagBits aspect)
         {
-            group.queue->submit(
-                {}, {}, {}, group.signal_fences[i]);
-        }
+            auto range = image_range.range;
+            range.aspectMask = aspect;
+            foreachSubrsc(range, [&](const vk::ImageSubresource &subrsc)
+            {
+                image.getState(subrsc) = state;
+            });
+        });
     }
 }
 
@@ -11,10 +11,24 @@ GlobalGroupDependencyLUT::GlobalGroupDependencyLUT(
 
 const GlobalGroupDependency &GlobalGroupDependencyLUT::getDependency(
     const CompileGroup *start, const CompileGroup *end)
+{
+    return getDependencies(start).at(end);
+}
+
+const GlobalGroupDependency *GlobalGroupDependencyLUT::findDependency(
+    const CompileGroup *start, const CompileGroup *end)
+{
+    auto &map = getDependencies(start);
+    auto it = map.find(end);
+    return it != map.end() ? &it->second : nullptr;
+}
+
+const Map<const CompileGroup *, GlobalGroupDependency> &
+    GlobalGroupDependencyLUT::getDependencies(const CompileGroup *start)
 {
     if(auto it = dependencies_.find(start);
        it != dependencies_.end())
-        return it->second.at(end);
+        return it->second;
 
     auto &map = dependencies_.insert(
         { start, Map<const CompileGroup *, GlobalGroupDependency>(&memory_) })
@@ -23,26 +37,17 @@ const GlobalGroupDependency &GlobalGroupDependencyLUT::getDependency(
     struct DependencySearchInfo
     {
         const CompileGroup *start_exit_tail;
-        const CompileGroup *end_entry_head;
-        CompileGroup *current;
+        const CompileGroup *current;
     };
 
-    const int traversal_flag = -++traversal_index_;
-    auto set_flag = [traversal_flag](CompileGroup *group)
-    {
-        assert(group->unprocessed_head_count != traversal_flag);
-        group->unprocessed_head_count = traversal_flag;
-    };
-    auto test_flag = [traversal_flag](const CompileGroup *group)
-    {
-        return group->unprocessed_head_count == traversal_flag;
-    };
+    // map doubles as the visited set, so that no state is written to the
+    // groups and LUTs of different threads don't interfere
 
     PmrQueue<DependencySearchInfo> next_groups(&memory_);
     for(auto tail : start->tails)
     {
-        set_flag(tail);
-        next_groups.push({ tail, start, tail });
+        if(map.insert({ tail, { tail, start } }).second)
+            next_groups.push({ tail, tail });
     }
 
     while(!next_groups.empty())
@@ -50,21 +55,17 @@ const GlobalGroupDependency &GlobalGroupDependencyLUT::getDependency(
         auto info = next_groups.front();
         next_groups.pop();
 
-        assert(test_flag(info.current));
-        map.insert(
-            { info.current, { info.start_exit_tail, info.end_entry_head } });
-
         for(auto tail : info.current->tails)
         {
-            if(!test_flag(tail))
-            {
-                set_flag(tail);
-                next_groups.push({ info.start_exit_tail, info.current, tail });
-            }
+            const GlobalGroupDependency dependency = {
+                info.start_exit_tail, info.current
+            };
+            if(map.insert({ tail, dependency }).second)
+                next_groups.push({ info.start_exit_tail, tail });
         }
     }
 
-    return map.at(end);
+    return map;
 }
 
 VKPT_GRAPH_END
@@ -1,9 +1,31 @@
 #include <vkpt/graph/compiler.h>
+#include <vkpt/graph/graph_cache.h>
+#include <vkpt/graph/transient_resource_pool.h>
 
 VKPT_GRAPH_BEGIN
 
+namespace
+{
+
+    // resolve VK_REMAINING_* so that equal ranges have equal keys
+    ImageSubresourceRange makeImageRange(
+        const Image &image, const vk::ImageSubresourceRange &range)
+    {
+        auto &desc = image.getDescription();
+        ImageSubresourceRange result = { image, range };
+        if(range.levelCount == VK_REMAINING_MIP_LEVELS)
+            result.range.levelCount = desc.mip_levels - range.baseMipLevel;
+        if(range.layerCount == VK_REMAINING_ARRAY_LAYERS)
+            result.range.layerCount = desc.array_layers - range.baseArrayLayer;
+        return result;
+    }
+
+} // namespace anonymous
+
 void PassContext::newCommandBuffer()
 {
+    getCommandBuffer().end();
+
     auto new_command_buffer =
         command_buffer_allocator_.newCommandBuffer(queue_type_);
     new_command_buffer.begin(true);
@@ -18,6 +40,59 @@ CommandBuffer PassContext::getCommandBuffer()
     return CommandBuffer(command_buffers_.back().commandBuffer);
 }
 
+std::vector<CommandBuffer> PassContext::newSecondaryCommandBuffers(
+    std::span<CommandBufferAllocator *const> allocators,
+    const vk::CommandBufferInheritanceInfo  &inheritance)
+{
+    std::vector<CommandBuffer> result;
+    result.reserve(allocators.size());
+
+    for(auto allocator : allocators)
+    {
+        auto command_buffer =
+            allocator->newSecondaryCommandBuffer(queue_type_);
+        command_buffer.beginSecondary(inheritance, true);
+        secondary_command_buffers_.push_back(command_buffer.getRaw());
+        if(inheritance.renderPass)
+            pending_render_pass_secondaries_ = true;
+        result.push_back(command_buffer);
+    }
+
+    return result;
+}
+
+std::vector<CommandBuffer> PassContext::newSecondaryCommandBuffers(
+    std::span<CommandBufferAllocator *const> allocators,
+    const Pipeline                          &pipeline,
+    const Framebuffer                       &framebuffer,
+    uint32_t                                 subpass)
+{
+    const vk::CommandBufferInheritanceInfo inheritance = {
+        .renderPass  = pipeline.getRenderPass(),
+        .subpass     = subpass,
+        .framebuffer = framebuffer
+    };
+    return newSecondaryCommandBuffers(allocators, inheritance);
+}
+
+void PassContext::executeSecondaryCommandBuffers()
+{
+    if(secondary_command_buffers_.empty())
+        return;
+
+    for(auto command_buffer : secondary_command_buffers_)
+        command_buffer.end();
+
+    getCommandBuffer().executeCommands(secondary_command_buffers_);
+    secondary_command_buffers_.clear();
+    pending_render_pass_secondaries_ = false;
+}
+
+bool PassContext::_hasPendingRenderPassSecondaries() const
+{
+    return pending_render_pass_secondaries_;
+}
+
 PassContext::PassContext(
     Queue::Type                             queue_type,
     CommandBufferAllocator                 &command_buffer_allocator,
@@ -39,19 +114,50 @@ PassBase::PassBase(std::pmr::memory_resource &memory)
       heads_(&memory),
       buffer_usages_(&memory),
       image_usages_(&memory),
+      buffer_usage_order_(&memory),
+      image_usage_order_(&memory),
       fences_(&memory)
 {
     
 }
 
+void PassBase::setEnabled(bool enabled)
+{
+    enabled_ = enabled;
+}
+
+bool PassBase::isEnabled() const
+{
+    return enabled_;
+}
+
+void PassBase::setAlternativeQueue(
+    const Queue *queue, float estimated_duration)
+{
+    alternative_queue_  = queue;
+    estimated_duration_ = estimated_duration;
+}
+
+const Queue *PassBase::getAlternativeQueue() const
+{
+    return alternative_queue_;
+}
+
+float PassBase::getEstimatedDuration() const
+{
+    return estimated_duration_;
+}
+
 void PassBase::clearBufferUsages()
 {
     buffer_usages_.clear();
+    buffer_usage_order_.clear();
 }
 
 void PassBase::clearImageUsages()
 {
     image_usages_.clear();
+    image_usage_order_.clear();
 }
 
 void PassBase::clearFences()
@@ -62,13 +168,16 @@ void PassBase::clearFences()
 void PassBase::addBufferUsage(const Buffer &buffer, const BufferUsage &usage)
 {
     assert(!buffer_usages_.contains(buffer));
-    buffer_usages_.insert({ buffer, usage });
+    buffer_usage_order_.push_back(
+        buffer_usages_.insert({ buffer, usage }).first);
 }
 
-void PassBase::addImageUsage(const ImageSubresource &image, const ImageUsage &usage)
+void PassBase::addImageUsage(
+    const ImageSubresourceRange &image, const ImageUsage &usage)
 {
     assert(!image_usages_.contains(image));
-    image_usages_.insert({ image, usage });
+    image_usage_order_.push_back(
+        image_usages_.insert({ image, usage }).first);
 }
 
 void PassBase::addFence(vk::Fence fence)
@@ -83,14 +192,7 @@ void Pass::use(
     const ResourceUsage        &usage,
     vk::ImageLayout             exit_layout)
 {
-    if(exit_layout == vk::ImageLayout::eUndefined)
-        use(image, subrsc, usage, usage.layout);
-    else
-    {
-        addImageUsage(
-            { image, subrsc },
-            { usage.stages, usage.access, usage.layout, exit_layout });
-    }
+    use(image, subrscToRange(subrsc), usage, exit_layout);
 }
 
 void Pass::use(
@@ -136,10 +238,11 @@ void Pass::use(
     const ResourceUsage             &usage,
     vk::ImageLayout                  exit_layout)
 {
-    foreachSubrsc(range, [&](const vk::ImageSubresource &subrsc)
-    {
-        use(image, subrsc, usage, exit_layout);
-    });
+    if(exit_layout == vk::ImageLayout::eUndefined)
+        exit_layout = usage.layout;
+    addImageUsage(
+        makeImageRange(image, range),
+        { usage.stages, usage.access, usage.layout, exit_layout });
 }
 
 void Pass::use(
@@ -192,12 +295,33 @@ Pass::Pass(std::pmr::memory_resource &memory)
 }
 
 Graph::Graph()
-    : arena_(memory_),
+    : Graph(own_memory_)
+{
+    
+}
+
+Graph::Graph(std::pmr::memory_resource &memory)
+    : memory_(memory),
+      arena_(memory_),
       passes_(&memory_),
       buffer_waits_(&memory_),
       image_waits_(&memory_),
       buffer_signals_(&memory_),
-      image_signals_(&memory_)
+      image_signals_(&memory_),
+      dependency_inference_enabled_(false),
+      culling_enabled_(false),
+      output_buffers_(&memory_),
+      output_images_(&memory_),
+      transient_resource_pool_(nullptr),
+      event_allocator_(nullptr),
+      frame_synchronizer_(nullptr),
+      compile_thread_pool_(nullptr),
+      record_thread_pool_(nullptr),
+      record_thread_allocators_(&memory_),
+      record_passes_per_task_(16),
+      semaphore_cost_(0.5f),
+      transfer_cost_(0.1f),
+      equivalent_queues_(&memory_)
 {
     
 }
@@ -241,9 +365,7 @@ void Graph::waitBeforeFirstUsage(
     const vk::ImageSubresource &subrsc,
     Semaphore                   semaphore)
 {
-    ImageSubresource image_subrsc = { image, subrsc };
-    assert(!image_waits_.contains(image_subrsc));
-    image_waits_.insert({ image_subrsc, semaphore });
+    waitBeforeFirstUsage(image, subrscToRange(subrsc), semaphore);
 }
 
 void Graph::waitBeforeFirstUsage(const Image &image, Semaphore semaphore)
@@ -292,10 +414,9 @@ void Graph::waitBeforeFirstUsage(
     const vk::ImageSubresourceRange &range,
     Semaphore                        semaphore)
 {
-    foreachSubrsc(range, [&](const vk::ImageSubresource &subrsc)
-    {
-        waitBeforeFirstUsage(image, subrsc, semaphore);
-    });
+    const auto image_range = makeImageRange(image, range);
+    assert(!image_waits_.contains(image_range));
+    image_waits_.insert({ image_range, semaphore });
 }
 
 void Graph::signalAfterLastUsage(
@@ -306,12 +427,9 @@ void Graph::signalAfterLastUsage(
     vk::ImageLayout             next_layout,
     bool                        release_only)
 {
-    ImageSubresource image_subrsc = { image, subrsc };
-    assert(!image_signals_.contains(image_subrsc));
-    image_signals_.insert({
-        image_subrsc,
-        { semaphore, next_queue, next_layout, release_only }
-    });
+    signalAfterLastUsage(
+        image, subrscToRange(subrsc), semaphore,
+        next_queue, next_layout, release_only);
 }
 
 void Graph::signalAfterLastUsage(
@@ -377,23 +495,124 @@ void Graph::signalAfterLastUsage(
     vk::ImageLayout                  next_layout,
     bool                             release_only)
 {
-    foreachSubrsc(range, [&](const vk::ImageSubresource &subrsc)
-    {
-        signalAfterLastUsage(
-            image, subrsc, semaphore, next_queue, next_layout, release_only);
+    const auto image_range = makeImageRange(image, range);
+    assert(!image_signals_.contains(image_range));
+    image_signals_.insert({
+        image_range,
+        { semaphore, next_queue, next_layout, release_only }
     });
 }
 
+void Graph::setDependencyInferenceEnabled(bool enabled)
+{
+    dependency_inference_enabled_ = enabled;
+}
+
+void Graph::setCullingEnabled(bool enabled)
+{
+    culling_enabled_ = enabled;
+}
+
+void Graph::markOutput(const Buffer &buffer)
+{
+    output_buffers_.insert(buffer);
+}
+
+void Graph::markOutput(const Image &image)
+{
+    output_images_.insert(image);
+}
+
+void Graph::setQueueAssignmentCosts(float semaphore_cost, float transfer_cost)
+{
+    semaphore_cost_ = semaphore_cost;
+    transfer_cost_  = transfer_cost;
+}
+
+void Graph::addEquivalentQueues(std::span<const Queue *const> queues)
+{
+    equivalent_queues_.emplace_back(queues.begin(), queues.end());
+}
+
+void Graph::setTransientResourcePool(TransientResourcePool *pool)
+{
+    transient_resource_pool_ = pool;
+}
+
+void Graph::setEventAllocator(EventAllocator *event_allocator)
+{
+    event_allocator_ = event_allocator;
+}
+
+void Graph::setFrameSynchronizer(FrameSynchronizer *frame_synchronizer)
+{
+    frame_synchronizer_ = frame_synchronizer;
+}
+
+void Graph::setCompileThreadPool(ThreadPool *thread_pool)
+{
+    compile_thread_pool_ = thread_pool;
+}
+
+void Graph::setRecordThreadPool(
+    ThreadPool                               *thread_pool,
+    std::span<CommandBufferAllocator *const>  thread_allocators,
+    size_t                                    passes_per_task)
+{
+    record_thread_pool_ = thread_pool;
+    record_thread_allocators_.assign(
+        thread_allocators.begin(), thread_allocators.end());
+    record_passes_per_task_ = passes_per_task;
+}
+
 void Graph::execute(
     SemaphoreAllocator          &semaphore_allocator,
     CommandBufferAllocator      &command_buffer_allocator,
     const std::function<void()> &after_record_callback)
 {
-    Compiler compiler;
+    Compiler compiler(memory_, compile_thread_pool_);
     auto exec = compiler.compile(semaphore_allocator, *this);
+    executeCompiled(exec, command_buffer_allocator, after_record_callback);
+}
+
+void Graph::execute(
+    GraphCache                  &graph_cache,
+    SemaphoreAllocator          &semaphore_allocator,
+    CommandBufferAllocator      &command_buffer_allocator,
+    const std::function<void()> &after_record_callback)
+{
+    auto &exec = graph_cache.getExecutableGraph(semaphore_allocator, *this);
+    executeCompiled(exec, command_buffer_allocator, after_record_callback);
+}
+
+void Graph::executeCompiled(
+    ExecutableGraph             &exec,
+    CommandBufferAllocator      &command_buffer_allocator,
+    const std::function<void()> &after_record_callback)
+{
+    if(transient_resource_pool_)
+        transient_resource_pool_->allocate(*this, exec);
+    AGZ_SCOPE_FAIL{
+        if(transient_resource_pool_)
+            transient_resource_pool_->restoreBarriers();
+    };
+
+    Executor executor(memory_);
+    executor.setEventAllocator(event_allocator_);
+    executor.setFrameSynchronizer(
+        frame_synchronizer_ ?
+        frame_synchronizer_ : command_buffer_allocator._getFrameSynchronizer());
+    if(record_thread_pool_)
+    {
+        executor.record(
+            *record_thread_pool_, record_thread_allocators_, exec,
+            record_passes_per_task_);
+    }
+    else
+        executor.record(command_buffer_allocator, exec);
 
-    Executor executor;
-    executor.record(command_buffer_allocator, exec);
+    if(transient_resource_pool_)
+        transient_resource_pool_->restoreBarriers();
 
     if(after_record_callback)
         after_record_callback();
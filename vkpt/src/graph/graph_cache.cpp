@@ -0,0 +1,951 @@
+#include <algorithm>
+#include <bit>
+#include <memory_resource>
+#include <tuple>
+
+#include <vkpt/graph/compiler.h>
+#include <vkpt/graph/graph_cache.h>
+
+VKPT_GRAPH_BEGIN
+
+namespace
+{
+
+    template<typename T>
+    uint64_t toKey(vk::Flags<T> flags)
+    {
+        return static_cast<typename vk::Flags<T>::MaskType>(flags);
+    }
+
+    template<typename T> requires std::is_enum_v<T>
+    uint64_t toKey(T e)
+    {
+        return static_cast<uint64_t>(e);
+    }
+
+    uint64_t toKey(const void *ptr)
+    {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr));
+    }
+
+    uint64_t hashKey(const std::vector<uint64_t> &key)
+    {
+        // fnv-1a
+
+        uint64_t result = 14695981039346656037ull;
+        for(uint64_t word : key)
+        {
+            for(int i = 0; i < 8; ++i)
+            {
+                result ^= (word >> (8 * i)) & 0xff;
+                result *= 1099511628211ull;
+            }
+        }
+        return result;
+    }
+
+    // entries of maps keyed by resources are ordered by handle address,
+    // which is not stable across frames. they are added to the key ordered
+    // by resource slot instead
+
+    template<typename T>
+    struct SlotItem
+    {
+        int                       slot;
+        vk::ImageSubresourceRange range;
+        const T                  *value;
+    };
+
+    template<typename T>
+    void sortBySlot(std::vector<SlotItem<T>> &items)
+    {
+        std::ranges::sort(items, [](const SlotItem<T> &a, const SlotItem<T> &b)
+        {
+            return std::tie(a.slot, a.range) < std::tie(b.slot, b.range);
+        });
+    }
+
+} // namespace anonymous
+
+struct GraphCache::Bindings
+{
+    struct SemaphoreBinding
+    {
+        Semaphore semaphore;
+        bool      is_signaled = false;
+    };
+
+    std::vector<uint64_t> key;
+    std::vector<bool>     enabled;
+
+    std::vector<PassBase *>       passes;
+    std::vector<Buffer>           buffers;
+    std::vector<Image>            images;
+    std::vector<SemaphoreBinding> semaphores;
+
+    std::unordered_map<VkBuffer, int>    buffer_slots;
+    std::unordered_map<VkImage, int>     image_slots;
+    std::unordered_map<VkSemaphore, int> semaphore_slots;
+
+    std::vector<int> tail_indices;
+
+    void clear()
+    {
+        key.clear();
+        enabled.clear();
+        passes.clear();
+        buffers.clear();
+        images.clear();
+        semaphores.clear();
+        buffer_slots.clear();
+        image_slots.clear();
+        semaphore_slots.clear();
+    }
+
+    void add(uint64_t value)
+    {
+        key.push_back(value);
+    }
+
+    void addEnableStates()
+    {
+        for(size_t i = 0; i < enabled.size(); i += 64)
+        {
+            uint64_t word = 0;
+            for(size_t j = i; j < (std::min)(i + 64, enabled.size()); ++j)
+                word |= uint64_t(enabled[j]) << (j - i);
+            add(word);
+        }
+    }
+
+    void addState(const ResourceState &state)
+    {
+        state.match(
+            [&](const FreeState &s)
+        {
+            add(0);
+            add(toKey(s.layout));
+        },
+            [&](const UsingState &s)
+        {
+            add(1);
+            add(toKey(s.queue));
+            add(toKey(s.stages));
+            add(toKey(s.access));
+            add(toKey(s.layout));
+        },
+            [&](const ReleasedState &s)
+        {
+            add(2);
+            add(toKey(s.src_queue));
+            add(toKey(s.dst_queue));
+            add(toKey(s.old_layout));
+            add(toKey(s.new_layout));
+        });
+    }
+
+    int getBufferSlot(const Buffer &buffer)
+    {
+        auto [it, is_new] = buffer_slots.try_emplace(
+            static_cast<VkBuffer>(buffer.get()),
+            static_cast<int>(buffers.size()));
+        if(is_new)
+            buffers.push_back(buffer);
+        return it->second;
+    }
+
+    int getImageSlot(const Image &image)
+    {
+        auto [it, is_new] = image_slots.try_emplace(
+            static_cast<VkImage>(image.get()),
+            static_cast<int>(images.size()));
+        if(is_new)
+            images.push_back(image);
+        return it->second;
+    }
+
+    void addRange(const vk::ImageSubresourceRange &range)
+    {
+        add(toKey(range.aspectMask));
+        add(range.baseMipLevel);
+        add(range.levelCount);
+        add(range.baseArrayLayer);
+        add(range.layerCount);
+    }
+
+    // states of all subresources as runs of equal states, so that an image
+    // with uniform states adds one state no matter its mip/layer counts
+
+    void addImageStates(const Image &image)
+    {
+        auto &desc = image.getDescription();
+
+        vk::ImageAspectFlags aspects = {};
+        if(hasDepthAspect(desc.format))
+            aspects |= vk::ImageAspectFlagBits::eDepth;
+        if(hasStencilAspect(desc.format))
+            aspects |= vk::ImageAspectFlagBits::eStencil;
+        if(!aspects)
+            aspects = vk::ImageAspectFlagBits::eColor;
+
+        foreachAspect(aspects, [&](vk::ImageAspectFlagBits aspect)
+        {
+            const ResourceState *run_state = nullptr;
+            uint64_t run_length = 0;
+
+            const vk::ImageSubresourceRange range = {
+                .aspectMask     = aspect,
+                .baseMipLevel   = 0,
+                .levelCount     = desc.mip_levels,
+                .baseArrayLayer = 0,
+                .layerCount     = desc.array_layers
+            };
+            foreachSubrsc(range, [&](const vk::ImageSubresource &subrsc)
+            {
+                auto &state = image.getState(subrsc);
+                if(run_state && isSameState(*run_state, state))
+                {
+                    ++run_length;
+                    return;
+                }
+                if(run_state)
+                {
+                    add(run_length);
+                    addState(*run_state);
+                }
+                run_state = &state;
+                run_length = 1;
+            });
+
+            add(run_length);
+            addState(*run_state);
+        });
+    }
+
+    void addSemaphore(const Semaphore &semaphore, bool is_signaled)
+    {
+        auto [it, is_new] = semaphore_slots.try_emplace(
+            static_cast<VkSemaphore>(getRaw(semaphore)),
+            static_cast<int>(semaphores.size()));
+        if(is_new)
+            semaphores.push_back({ semaphore, false });
+        semaphores[it->second].is_signaled |= is_signaled;
+
+        add(it->second);
+        add(semaphore.is<BinarySemaphore>() ? 0 : 1);
+    }
+};
+
+struct GraphCache::Entry
+{
+    struct PassSite
+    {
+        uint32_t group;
+        uint32_t pass;
+        int      pass_index;
+    };
+
+    // event >= 0 refers to a barrier of the event with that index,
+    // in which case pass and is_post are unused
+
+    struct BarrierSite
+    {
+        uint32_t group;
+        uint32_t pass;
+        uint32_t barrier;
+        bool     is_post;
+        int      event;
+    };
+
+    struct SemaphoreSite
+    {
+        uint32_t group;
+        uint32_t submit;
+        bool     is_signal;
+        int      slot;
+    };
+
+    struct ImageFinalState
+    {
+        int                       slot;
+        vk::ImageSubresourceRange range;
+        ResourceState             state;
+    };
+
+    std::vector<uint64_t> key;
+    uint64_t              last_use = 0;
+
+    // groups filled again by the compiler release their old storage
+    std::pmr::unsynchronized_pool_resource memory;
+    std::optional<ExecutableGraph>         graph;
+
+    // incremental entries keep their compiler to apply new enable states.
+    // other entries are compiled for the enable states in their keys
+    std::unique_ptr<Compiler> compiler;
+    std::vector<bool>         enabled;
+
+    // slots of the handles the graph was compiled with, which are used by
+    // groups filled again
+    std::unordered_map<VkBuffer, int>    buffer_slots;
+    std::unordered_map<VkImage, int>     image_slots;
+    std::unordered_map<VkSemaphore, int> semaphore_slots;
+    std::unordered_map<VkSemaphore, int> internal_semaphore_slots;
+
+    std::vector<PassSite> pass_sites;
+
+    // barrier sites are grouped by resource slot so that only resources
+    // whose handles actually changed need to be patched
+
+    std::vector<vk::Buffer>               buffers;
+    std::vector<vk::Image>                images;
+    std::vector<std::vector<BarrierSite>> buffer_sites;
+    std::vector<std::vector<BarrierSite>> image_sites;
+
+    // slots >= external_semaphore_count refer to semaphores allocated by
+    // the compiler for inter-group synchronization
+
+    int                        external_semaphore_count = 0;
+    int                        internal_semaphore_count = 0;
+    std::vector<SemaphoreSite> semaphore_sites;
+
+    std::vector<std::pair<int, ResourceState>> buffer_final_states;
+    std::vector<ImageFinalState>               image_final_states;
+};
+
+GraphCache::GraphCache(size_t max_entry_count)
+    : max_entry_count_((std::max)(max_entry_count, size_t(1))),
+      use_counter_(0),
+      bindings_(std::make_unique<Bindings>())
+{
+
+}
+
+GraphCache::~GraphCache() = default;
+
+ExecutableGraph &GraphCache::getExecutableGraph(
+    SemaphoreAllocator &semaphore_allocator,
+    const Graph        &graph)
+{
+    buildBindings(graph);
+
+    // a structure is compiled incrementally when all its passes are
+    // enabled, and other enable states are applied to it afterwards
+
+    const uint64_t hash = hashKey(bindings_->key);
+    auto entry = findEntry(hash);
+    if(entry && applyEnableStates(*entry, graph))
+    {
+        rebind(semaphore_allocator, *entry);
+        entry->last_use = ++use_counter_;
+        return *entry->graph;
+    }
+
+    auto &enabled = bindings_->enabled;
+    if(!entry && std::ranges::find(enabled, false) == enabled.end())
+        return *createEntry(semaphore_allocator, graph, hash, true).graph;
+
+    // otherwise the graph is compiled for its enable states, which are
+    // part of the key. such keys never equal keys without them, as they
+    // are longer
+
+    bindings_->addEnableStates();
+
+    const uint64_t fixed_hash = hashKey(bindings_->key);
+    if(auto fixed_entry = findEntry(fixed_hash))
+    {
+        rebind(semaphore_allocator, *fixed_entry);
+        fixed_entry->last_use = ++use_counter_;
+        return *fixed_entry->graph;
+    }
+
+    return *createEntry(semaphore_allocator, graph, fixed_hash, false).graph;
+}
+
+void GraphCache::clear()
+{
+    entries_.clear();
+}
+
+size_t GraphCache::getEntryCount() const
+{
+    return entries_.size();
+}
+
+void GraphCache::buildBindings(const Graph &graph)
+{
+    auto &b = *bindings_;
+    b.clear();
+
+    b.passes.assign(graph.passes_.begin(), graph.passes_.end());
+    b.add(b.passes.size());
+
+    std::vector<SlotItem<PassBase::BufferUsage>> buffer_usages;
+    std::vector<SlotItem<PassBase::ImageUsage>>  image_usages;
+
+    for(auto pass : b.passes)
+    {
+        b.add(toKey(pass->getPassQueue()));
+        b.add(toKey(pass->getAlternativeQueue()));
+        if(pass->getAlternativeQueue())
+            b.add(std::bit_cast<uint32_t>(pass->getEstimatedDuration()));
+
+        // fences are re-collected by rebind, but a pass with fences is never
+        // culled, so their presence changes the compiled structure
+        b.add(!pass->fences_.empty());
+        b.enabled.push_back(pass->enabled_);
+
+        // tails are ordered by address, which is not stable across frames
+
+        b.tail_indices.clear();
+        for(auto tail : pass->tails_)
+            b.tail_indices.push_back(tail->index_);
+        std::ranges::sort(b.tail_indices);
+
+        b.add(b.tail_indices.size());
+        for(int tail_index : b.tail_indices)
+            b.add(tail_index);
+
+        // new resources get their slots in declaration order
+
+        buffer_usages.clear();
+        for(auto it : pass->buffer_usage_order_)
+            buffer_usages.push_back({ b.getBufferSlot(it->first), {}, &it->second });
+        sortBySlot(buffer_usages);
+
+        b.add(buffer_usages.size());
+        for(auto &item : buffer_usages)
+        {
+            b.add(item.slot);
+            b.add(toKey(item.value->stages));
+            b.add(toKey(item.value->access));
+        }
+
+        image_usages.clear();
+        for(auto it : pass->image_usage_order_)
+        {
+            image_usages.push_back({
+                b.getImageSlot(it->first.image), it->first.range, &it->second
+            });
+        }
+        sortBySlot(image_usages);
+
+        b.add(image_usages.size());
+        for(auto &item : image_usages)
+        {
+            b.add(item.slot);
+            b.addRange(item.range);
+            b.add(toKey(item.value->stages));
+            b.add(toKey(item.value->access));
+            b.add(toKey(item.value->layout));
+            b.add(toKey(item.value->exit_layout));
+        }
+    }
+
+    // waits/signals of resources not used by any pass get slots in map
+    // order. such resources only cause cache misses, never wrong hits
+
+    using WaitItem   = SlotItem<Semaphore>;
+    using SignalItem = SlotItem<decltype(graph.buffer_signals_)::mapped_type>;
+
+    std::vector<WaitItem> waits;
+    for(auto &[buffer, semaphore] : graph.buffer_waits_)
+        waits.push_back({ b.getBufferSlot(buffer), {}, &semaphore });
+    sortBySlot(waits);
+
+    b.add(waits.size());
+    for(auto &item : waits)
+    {
+        b.add(item.slot);
+        b.addSemaphore(*item.value, false);
+    }
+
+    waits.clear();
+    for(auto &[image_range, semaphore] : graph.image_waits_)
+    {
+        waits.push_back({
+            b.getImageSlot(image_range.image), image_range.range, &semaphore
+        });
+    }
+    sortBySlot(waits);
+
+    b.add(waits.size());
+    for(auto &item : waits)
+    {
+        b.add(item.slot);
+        b.addRange(item.range);
+        b.addSemaphore(*item.value, false);
+    }
+
+    std::vector<SignalItem> signals;
+    for(auto &[buffer, signal] : graph.buffer_signals_)
+        signals.push_back({ b.getBufferSlot(buffer), {}, &signal });
+    sortBySlot(signals);
+
+    b.add(signals.size());
+    for(auto &item : signals)
+    {
+        b.add(item.slot);
+        b.addSemaphore(item.value->semaphore, true);
+        b.add(toKey(item.value->queue));
+        b.add(item.value->release_only);
+    }
+
+    signals.clear();
+    for(auto &[image_range, signal] : graph.image_signals_)
+    {
+        signals.push_back({
+            b.getImageSlot(image_range.image), image_range.range, &signal
+        });
+    }
+    sortBySlot(signals);
+
+    b.add(signals.size());
+    for(auto &item : signals)
+    {
+        b.add(item.slot);
+        b.addRange(item.range);
+        b.addSemaphore(item.value->semaphore, true);
+        b.add(toKey(item.value->queue));
+        b.add(toKey(item.value->layout));
+        b.add(item.value->release_only);
+    }
+
+    b.add(std::bit_cast<uint32_t>(graph.semaphore_cost_));
+    b.add(std::bit_cast<uint32_t>(graph.transfer_cost_));
+
+    b.add(graph.equivalent_queues_.size());
+    for(auto &queues : graph.equivalent_queues_)
+    {
+        b.add(queues.size());
+        for(auto queue : queues)
+            b.add(toKey(queue));
+    }
+
+    b.add(graph.event_allocator_ != nullptr);
+    b.add(graph.dependency_inference_enabled_);
+
+    b.add(graph.culling_enabled_);
+    if(graph.culling_enabled_)
+    {
+        std::vector<int> output_slots;
+        for(auto &buffer : graph.output_buffers_)
+            output_slots.push_back(b.getBufferSlot(buffer));
+        std::ranges::sort(output_slots);
+
+        b.add(output_slots.size());
+        for(int slot : output_slots)
+            b.add(slot);
+
+        output_slots.clear();
+        for(auto &image : graph.output_images_)
+            output_slots.push_back(b.getImageSlot(image));
+        std::ranges::sort(output_slots);
+
+        b.add(output_slots.size());
+        for(int slot : output_slots)
+            b.add(slot);
+    }
+
+    // incoming states, once per resource
+
+    b.add(b.buffers.size());
+    for(auto &buffer : b.buffers)
+        b.addState(buffer.getState());
+
+    b.add(b.images.size());
+    for(auto &image : b.images)
+        b.addImageStates(image);
+}
+
+GraphCache::Entry *GraphCache::findEntry(uint64_t hash) const
+{
+    auto [beg, end] = entries_.equal_range(hash);
+    for(auto it = beg; it != end; ++it)
+    {
+        if(it->second->key == bindings_->key)
+            return it->second.get();
+    }
+    return nullptr;
+}
+
+GraphCache::Entry &GraphCache::createEntry(
+    SemaphoreAllocator &semaphore_allocator,
+    const Graph        &graph,
+    uint64_t            hash,
+    bool                incremental)
+{
+    auto entry = std::make_unique<Entry>();
+    entry->key = bindings_->key;
+
+    entry->compiler = std::make_unique<Compiler>(
+        *std::pmr::get_default_resource(), graph.compile_thread_pool_);
+    entry->compiler->setIncremental(incremental);
+    entry->graph.emplace(entry->compiler->compile(
+        semaphore_allocator, graph, entry->memory));
+
+    if(incremental)
+        entry->enabled.assign(bindings_->enabled.size(), true);
+    else
+        entry->compiler.reset();
+
+    createPatchSites(*entry);
+    entry->last_use = ++use_counter_;
+
+    if(entries_.size() >= max_entry_count_)
+        evict();
+
+    auto &result = *entry;
+    entries_.insert({ hash, std::move(entry) });
+    return result;
+}
+
+bool GraphCache::applyEnableStates(Entry &entry, const Graph &graph) const
+{
+    auto &b = *bindings_;
+    if(entry.enabled == b.enabled)
+        return true;
+
+    Vector<int> dirty_groups;
+    if(!entry.compiler->recompile(graph, *entry.graph, dirty_groups))
+        return false;
+
+    entry.enabled = b.enabled;
+    updatePatchSites(entry, dirty_groups);
+    return true;
+}
+
+void GraphCache::createPatchSites(Entry &entry) const
+{
+    auto &b = *bindings_;
+    auto &exec = *entry.graph;
+
+    entry.buffers.resize(b.buffers.size());
+    for(size_t i = 0; i < b.buffers.size(); ++i)
+        entry.buffers[i] = b.buffers[i].get();
+
+    entry.images.resize(b.images.size());
+    for(size_t i = 0; i < b.images.size(); ++i)
+        entry.images[i] = b.images[i].get();
+
+    entry.buffer_slots    = b.buffer_slots;
+    entry.image_slots     = b.image_slots;
+    entry.semaphore_slots = b.semaphore_slots;
+
+    entry.buffer_sites.resize(b.buffers.size());
+    entry.image_sites.resize(b.images.size());
+
+    entry.external_semaphore_count = static_cast<int>(b.semaphores.size());
+
+    for(uint32_t gi = 0; gi < exec.groups.size(); ++gi)
+        addGroupSites(entry, gi);
+
+    collectFinalStates(entry);
+}
+
+void GraphCache::addGroupSites(Entry &entry, uint32_t group_index) const
+{
+    auto &group = entry.graph->groups[group_index];
+    const uint32_t gi = group_index;
+
+    // barriers refer to the handles the graph was compiled with, and are
+    // patched to the last bound ones
+
+    auto add_buffer_sites = [&](
+        Vector<vk::BufferMemoryBarrier2KHR> &barriers,
+        uint32_t pass_index, bool is_post, int event_index = -1)
+    {
+        for(size_t i = 0; i < barriers.size(); ++i)
+        {
+            const int slot = entry.buffer_slots.at(
+                static_cast<VkBuffer>(barriers[i].buffer));
+            barriers[i].buffer = entry.buffers[slot];
+            entry.buffer_sites[slot].push_back({
+                gi, pass_index, static_cast<uint32_t>(i),
+                is_post, event_index
+            });
+        }
+    };
+
+    auto add_image_sites = [&](
+        Vector<vk::ImageMemoryBarrier2KHR> &barriers,
+        uint32_t pass_index, bool is_post, int event_index = -1)
+    {
+        for(size_t i = 0; i < barriers.size(); ++i)
+        {
+            const int slot = entry.image_slots.at(
+                static_cast<VkImage>(barriers[i].image));
+            barriers[i].image = entry.images[slot];
+            entry.image_sites[slot].push_back({
+                gi, pass_index, static_cast<uint32_t>(i),
+                is_post, event_index
+            });
+        }
+    };
+
+    auto get_semaphore_slot = [&](vk::Semaphore semaphore)
+    {
+        const auto raw = static_cast<VkSemaphore>(semaphore);
+        if(auto it = entry.semaphore_slots.find(raw);
+           it != entry.semaphore_slots.end())
+            return it->second;
+        auto it = entry.internal_semaphore_slots.try_emplace(
+            raw, entry.external_semaphore_count +
+                 static_cast<int>(entry.internal_semaphore_slots.size())).first;
+        return it->second;
+    };
+
+    for(uint32_t pi = 0; pi < group.passes.size(); ++pi)
+    {
+        auto &pass = group.passes[pi];
+        if(pass.pass)
+            entry.pass_sites.push_back({ gi, pi, pass.pass->index_ });
+
+        add_buffer_sites(pass.pre_buffer_barriers, pi, false);
+        add_buffer_sites(pass.post_buffer_barriers, pi, true);
+        add_image_sites(pass.pre_image_barriers, pi, false);
+        add_image_sites(pass.post_image_barriers, pi, true);
+    }
+
+    for(uint32_t ei = 0; ei < group.events.size(); ++ei)
+    {
+        auto &event = group.events[ei];
+        const int event_index = static_cast<int>(ei);
+        add_buffer_sites(event.buffer_barriers, 0, false, event_index);
+        add_image_sites(event.image_barriers, 0, false, event_index);
+    }
+
+    for(uint32_t i = 0; i < group.wait_semaphores.size(); ++i)
+    {
+        entry.semaphore_sites.push_back({
+            gi, i, false,
+            get_semaphore_slot(group.wait_semaphores[i].semaphore)
+        });
+    }
+
+    for(uint32_t i = 0; i < group.signal_semaphores.size(); ++i)
+    {
+        entry.semaphore_sites.push_back({
+            gi, i, true,
+            get_semaphore_slot(group.signal_semaphores[i].semaphore)
+        });
+    }
+
+    entry.internal_semaphore_count =
+        static_cast<int>(entry.internal_semaphore_slots.size());
+}
+
+void GraphCache::updatePatchSites(
+    Entry &entry, const Vector<int> &dirty_groups) const
+{
+    auto is_dirty = [&](const auto &site)
+    {
+        return std::ranges::binary_search(
+            dirty_groups, static_cast<int>(site.group));
+    };
+
+    std::erase_if(entry.pass_sites, is_dirty);
+    for(auto &sites : entry.buffer_sites)
+        std::erase_if(sites, is_dirty);
+    for(auto &sites : entry.image_sites)
+        std::erase_if(sites, is_dirty);
+    std::erase_if(entry.semaphore_sites, is_dirty);
+
+    for(int gi : dirty_groups)
+        addGroupSites(entry, static_cast<uint32_t>(gi));
+
+    // final states are keyed by the handles the graph was compiled with
+
+    entry.buffer_final_states.clear();
+    entry.image_final_states.clear();
+    collectFinalStates(entry);
+}
+
+void GraphCache::collectFinalStates(Entry &entry) const
+{
+    auto &exec = *entry.graph;
+
+    for(auto &[buffer, state] : exec.buffer_final_states)
+    {
+        entry.buffer_final_states.push_back({
+            entry.buffer_slots.at(static_cast<VkBuffer>(buffer.get())), state
+        });
+    }
+
+    for(auto &[image_range, state] : exec.image_final_states)
+    {
+        entry.image_final_states.push_back({
+            entry.image_slots.at(static_cast<VkImage>(image_range.get())),
+            image_range.range,
+            state
+        });
+    }
+}
+
+void GraphCache::rebind(
+    SemaphoreAllocator &semaphore_allocator, Entry &entry) const
+{
+    auto &b = *bindings_;
+    auto &exec = *entry.graph;
+
+    // passes
+
+    for(auto &site : entry.pass_sites)
+        exec.groups[site.group].passes[site.pass].pass = b.passes[site.pass_index];
+
+    // resource handles
+
+    for(size_t slot = 0; slot < b.buffers.size(); ++slot)
+    {
+        const vk::Buffer handle = b.buffers[slot].get();
+        if(handle == entry.buffers[slot])
+            continue;
+        entry.buffers[slot] = handle;
+
+        for(auto &site : entry.buffer_sites[slot])
+        {
+            auto &group = exec.groups[site.group];
+            if(site.event >= 0)
+            {
+                group.events[site.event]
+                    .buffer_barriers[site.barrier].buffer = handle;
+                continue;
+            }
+
+            auto &pass = group.passes[site.pass];
+            auto &barriers = site.is_post ?
+                pass.post_buffer_barriers : pass.pre_buffer_barriers;
+            barriers[site.barrier].buffer = handle;
+        }
+    }
+
+    for(size_t slot = 0; slot < b.images.size(); ++slot)
+    {
+        const vk::Image handle = b.images[slot].get();
+        if(handle == entry.images[slot])
+            continue;
+        entry.images[slot] = handle;
+
+        for(auto &site : entry.image_sites[slot])
+        {
+            auto &group = exec.groups[site.group];
+            if(site.event >= 0)
+            {
+                group.events[site.event]
+                    .image_barriers[site.barrier].image = handle;
+                continue;
+            }
+
+            auto &pass = group.passes[site.pass];
+            auto &barriers = site.is_post ?
+                pass.post_image_barriers : pass.pre_image_barriers;
+            barriers[site.barrier].image = handle;
+        }
+    }
+
+    // semaphores
+    // waits must observe values before any signal of this graph, which
+    // matches the order in which the compiler handles them
+
+    struct SemaphoreValues
+    {
+        vk::Semaphore semaphore;
+        uint64_t      wait_value   = 0;
+        uint64_t      signal_value = 0;
+    };
+
+    std::vector<SemaphoreValues> values(
+        entry.external_semaphore_count + entry.internal_semaphore_count);
+
+    for(int i = 0; i < entry.external_semaphore_count; ++i)
+    {
+        b.semaphores[i].semaphore.match(
+            [&](const BinarySemaphore &binary)
+        {
+            values[i].semaphore = binary.get();
+        },
+            [&](const TimelineSemaphore &timeline)
+        {
+            values[i].semaphore  = timeline.get();
+            values[i].wait_value = timeline.getLastSignalValue();
+        });
+    }
+
+    for(int i = 0; i < entry.external_semaphore_count; ++i)
+    {
+        if(!b.semaphores[i].is_signaled)
+            continue;
+
+        b.semaphores[i].semaphore.match(
+            [&](const BinarySemaphore &) { },
+            [&](TimelineSemaphore &timeline)
+        {
+            values[i].signal_value = timeline.nextSignalValue();
+        });
+    }
+
+    for(int i = 0; i < entry.internal_semaphore_count; ++i)
+    {
+        auto timeline = semaphore_allocator.newTimelineSemaphore();
+        const uint64_t value = timeline.nextSignalValue();
+
+        auto &v = values[entry.external_semaphore_count + i];
+        v.semaphore    = timeline.get();
+        v.wait_value   = value;
+        v.signal_value = value;
+    }
+
+    for(auto &site : entry.semaphore_sites)
+    {
+        auto &group = exec.groups[site.group];
+        auto &submit = site.is_signal ?
+            group.signal_semaphores[site.submit] :
+            group.wait_semaphores[site.submit];
+
+        auto &v = values[site.slot];
+        submit.semaphore = v.semaphore;
+        submit.value     = site.is_signal ? v.signal_value : v.wait_value;
+    }
+
+    // fences
+
+    for(auto &group : exec.groups)
+    {
+        group.signal_fences.clear();
+        for(auto &pass : group.passes)
+        {
+            if(!pass.pass)
+                continue;
+            std::copy(
+                pass.pass->_getFences().begin(),
+                pass.pass->_getFences().end(),
+                std::back_inserter(group.signal_fences));
+        }
+    }
+
+    // final states
+
+    exec.buffer_final_states.clear();
+    for(auto &[slot, state] : entry.buffer_final_states)
+        exec.buffer_final_states.insert({ b.buffers[slot], state });
+
+    exec.image_final_states.clear();
+    for(auto &s : entry.image_final_states)
+    {
+        exec.image_final_states.insert(
+            { ImageSubresourceRange{ b.images[s.slot], s.range }, s.state });
+    }
+}
+
+void GraphCache::evict()
+{
+    auto victim = entries_.begin();
+    for(auto it = entries_.begin(); it != entries_.end(); ++it)
+    {
+        if(it->second->last_use < victim->second->last_use)
+            victim = it;
+    }
+    if(victim != entries_.end())
+        entries_.erase(victim);
+}
+
+VKPT_GRAPH_END
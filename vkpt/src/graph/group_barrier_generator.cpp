@@ -3,14 +3,49 @@
 
 VKPT_GRAPH_BEGIN
 
+GroupBarrierGenerator::ReleaseBarriers::ReleaseBarriers(
+    std::pmr::memory_resource &memory)
+    : buffer_barriers(&memory), image_barriers(&memory)
+{
+    
+}
+
+void GroupBarrierGenerator::ReleaseBarriers::apply()
+{
+    for(auto &[pass, barrier] : buffer_barriers)
+        pass->post_ext_buffer_barriers.push_back(barrier);
+    for(auto &[pass, barrier] : image_barriers)
+        pass->post_ext_image_barriers.push_back(barrier);
+}
+
+void GroupBarrierGenerator::ReleaseBarriers::apply(
+    const Set<CompileGroup *> &groups)
+{
+    for(auto &[pass, barrier] : buffer_barriers)
+    {
+        if(groups.contains(pass->group))
+            pass->post_ext_buffer_barriers.push_back(barrier);
+    }
+    for(auto &[pass, barrier] : image_barriers)
+    {
+        if(groups.contains(pass->group))
+            pass->post_ext_image_barriers.push_back(barrier);
+    }
+}
+
 GroupBarrierGenerator::GroupBarrierGenerator(
-    std::pmr::memory_resource &memory, const ResourceRecords &resource_records)
-    : dependencies_(memory), resource_records_(resource_records)
+    std::pmr::memory_resource &memory,
+    const ResourceRecords     &resource_records,
+    bool                       split_barriers)
+    : dependencies_(memory),
+      resource_records_(resource_records),
+      split_barriers_(split_barriers)
 {
     
 }
 
-void GroupBarrierGenerator::fillBarriers(CompileGroup *group)
+void GroupBarrierGenerator::fillBarriers(
+    CompileGroup *group, ReleaseBarriers &releases)
 {
     last_pass_with_pre_barrier_ = nullptr;
 
@@ -19,20 +54,13 @@ void GroupBarrierGenerator::fillBarriers(CompileGroup *group)
         auto pass = group->passes[pass_i];
         assert(pass->sorted_index_in_group == static_cast<int>(pass_i));
 
-        for(auto &[buffer, usage] : pass->generated_buffer_usages)
-            handleResource(pass, buffer, usage);
-
-        for(auto &[image_subrsc, usage] : pass->generated_image_usages)
-            handleResource(pass, image_subrsc, usage);
+        auto &buffers = resource_records_.getBuffers();
+        for(auto &ref : pass->buffer_usages)
+            handleResource(pass, buffers[ref.record], ref.usage, releases);
 
-        if(!pass->raw_pass)
-            continue;
-
-        for(auto &[buffer, usage] : pass->raw_pass->_getBufferUsages())
-            handleResource(pass, buffer, usage);
-
-        for(auto &[image_subrsc, usage] : pass->raw_pass->_getImageUsages())
-            handleResource(pass, image_subrsc, usage);
+        auto &images = resource_records_.getImages();
+        for(auto &ref : pass->image_usages)
+            handleResource(pass, images[ref.record], ref.usage, releases);
     }
 }
 
@@ -49,7 +77,12 @@ CompilePass *GroupBarrierGenerator::getBarrierPass(CompilePass *A, CompilePass *
     if(!A)
         return last_pass_with_pre_barrier_;
 
-    if(last_pass_with_pre_barrier_->sorted_index <= A->sorted_index)
+    // passes are reordered within groups, so the global order can't be used.
+    // every pass of this group is after A if A is in a previous group
+
+    if(A->group == B->group &&
+       last_pass_with_pre_barrier_->sorted_index_in_group <=
+       A->sorted_index_in_group)
     {
         last_pass_with_pre_barrier_ = B;
         return B;
@@ -58,6 +91,22 @@ CompilePass *GroupBarrierGenerator::getBarrierPass(CompilePass *A, CompilePass *
     return last_pass_with_pre_barrier_;
 }
 
+CompileEvent &GroupBarrierGenerator::getEvent(CompilePass *A, CompilePass *B)
+{
+    auto &events = B->group->events;
+    for(int index : B->wait_events)
+    {
+        if(events[index].signal_pass == A)
+            return events[index];
+    }
+
+    const int index = static_cast<int>(events.size());
+    events.emplace_back(*events.get_allocator().resource(), A, B);
+    A->set_events.push_back(index);
+    B->wait_events.push_back(index);
+    return events.back();
+}
+
 bool GroupBarrierGenerator::shouldSkipBarrier(
     const Pass::BufferUsage &a, const Pass::BufferUsage &b) const
 {
@@ -75,63 +124,107 @@ bool GroupBarrierGenerator::shouldSkipBarrier(
            GroupBarrierOptimizer::isReadOnly(a.access);
 }
 
-template<typename Resource, typename PassUsage>
+template<typename Record, typename UsageIt>
 void GroupBarrierGenerator::handleResource(
-    CompilePass *pass, const Resource &rsc, const PassUsage &usage)
+    CompilePass     *pass,
+    const Record    &record,
+    UsageIt          usage_it,
+    ReleaseBarriers &releases)
 {
-    constexpr bool is_buffer = std::is_same_v<Resource, Buffer>;
+    constexpr bool is_buffer = std::is_same_v<Record, CompileBuffer>;
+
+    // the previous run may have several unordered passes. they are on one
+    // queue and have the same merged usage, so one barrier covers them all
 
-    auto &record = resource_records_.getRecord(rsc);
-    auto usage_it = record.pass_to_usage.at(pass);
-    if(usage_it == record.usages.begin())
+    auto [last_begin, last_end] = getPrevRun(record.usages, usage_it);
+    if(last_begin == last_end)
         return;
 
-    auto &last_usage = *std::prev(usage_it);
-    auto last_user = last_usage.pass;
+    auto &rsc = record.resource;
+    auto &usage = *usage_it;
+
+    auto &last_usage = *last_begin;
     CompileGroup *group = pass->group;
+
+    // the latest previous user in this group, if any
+
+    auto last_user = last_usage.pass;
+    for(auto it = std::next(last_begin); it != last_end; ++it)
+    {
+        auto user = it->pass;
+        if(user->group == group &&
+           (last_user->group != group ||
+            last_user->sorted_index_in_group < user->sorted_index_in_group))
+            last_user = user;
+    }
     CompileGroup *last_group = last_user->group;
 
     if(last_group->queue == group->queue)
     {
         assert(
-            last_user->sorted_index_in_group <
-            pass->sorted_index_in_group);
-        auto barrier_pass = getBarrierPass(last_user, pass);
+            last_group != group ||
+            last_user->sorted_index_in_group < pass->sorted_index_in_group);
 
-        if(!shouldSkipBarrier(last_usage, usage))
+        if(shouldSkipBarrier(last_usage, usage))
         {
-            if constexpr(is_buffer)
+            getBarrierPass(last_user, pass);
+            return;
+        }
+
+        // with independent passes in between, split the barrier so that they
+        // can overlap with the producer's flush and layout transition
+
+        const bool split =
+            split_barriers_ && last_group == group &&
+            pass->sorted_index_in_group - last_user->sorted_index_in_group > 1;
+
+        if constexpr(is_buffer)
+        {
+            const vk::BufferMemoryBarrier2KHR barrier = {
+                .srcStageMask        = last_usage.stages,
+                .srcAccessMask       = last_usage.access,
+                .dstStageMask        = usage.stages,
+                .dstAccessMask       = usage.access,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer              = rsc.get(),
+                .offset              = 0,
+                .size                = VK_WHOLE_SIZE
+            };
+
+            if(split)
             {
-                barrier_pass->pre_buffer_barriers.insert({
-                    rsc, vk::BufferMemoryBarrier2KHR{
-                        .srcStageMask        = last_usage.stages,
-                        .srcAccessMask       = last_usage.access,
-                        .dstStageMask        = usage.stages,
-                        .dstAccessMask       = usage.access,
-                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .buffer              = rsc.get(),
-                        .offset              = 0,
-                        .size                = VK_WHOLE_SIZE
-                    }
-                });
+                getEvent(last_user, pass).buffer_barriers.push_back(barrier);
             }
             else
             {
-                barrier_pass->pre_image_barriers.insert({
-                    rsc, vk::ImageMemoryBarrier2KHR{
-                        .srcStageMask        = last_usage.stages,
-                        .srcAccessMask       = last_usage.access,
-                        .dstStageMask        = usage.stages,
-                        .dstAccessMask       = usage.access,
-                        .oldLayout           = last_usage.exit_layout,
-                        .newLayout           = usage.layout,
-                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                        .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
-                    }
-                });
+                getBarrierPass(last_user, pass)->pre_buffer_barriers
+                    .push_back({ record.index, barrier });
+            }
+        }
+        else
+        {
+            const vk::ImageMemoryBarrier2KHR barrier = {
+                .srcStageMask        = last_usage.stages,
+                .srcAccessMask       = last_usage.access,
+                .dstStageMask        = usage.stages,
+                .dstAccessMask       = usage.access,
+                .oldLayout           = last_usage.exit_layout,
+                .newLayout           = usage.layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image               = rsc.image.get(),
+                .subresourceRange    = rsc.range
+            };
+
+            if(split)
+            {
+                getEvent(last_user, pass).image_barriers.push_back(barrier);
+            }
+            else
+            {
+                getBarrierPass(last_user, pass)->pre_image_barriers
+                    .push_back({ record.index, barrier });
             }
         }
     }
@@ -139,22 +232,30 @@ void GroupBarrierGenerator::handleResource(
     {
         // cross queue dependency
 
-        auto &global_group_dependency =
-            dependencies_.getDependency(last_group, group);
-        auto direct_head = global_group_dependency.end_entry_head;
+        for(auto it = last_begin; it != last_end; ++it)
+        {
+            auto &global_group_dependency =
+                dependencies_.getDependency(it->pass->group, group);
+            auto direct_head = global_group_dependency.end_entry_head;
 
-        assert(group->heads.contains(direct_head));
-        group->heads[direct_head] |= usage.stages;
+            assert(group->heads.contains(direct_head));
+            group->heads[direct_head] |= usage.stages;
+        }
 
         if(group->queue->getFamilyIndex() !=
            last_group->queue->getFamilyIndex())
         {
+            // ownership is released once, so the compiler joins runs of
+            // several passes before a transfer
+
+            assert(std::next(last_begin) == last_end);
+
             auto barrier_pass = getBarrierPass(nullptr, pass);
 
             if constexpr(is_buffer)
             {
-                barrier_pass->pre_buffer_barriers.insert({
-                    rsc, vk::BufferMemoryBarrier2KHR{
+                barrier_pass->pre_buffer_barriers.push_back({
+                    record.index, vk::BufferMemoryBarrier2KHR{
                         .srcStageMask        = usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
                         .dstStageMask        = usage.stages,
@@ -167,8 +268,8 @@ void GroupBarrierGenerator::handleResource(
                     }
                 });
                 
-                last_usage.pass->post_ext_buffer_barriers.insert(
-                    vk::BufferMemoryBarrier2KHR{
+                releases.buffer_barriers.push_back({
+                    last_usage.pass, vk::BufferMemoryBarrier2KHR{
                         .srcStageMask         = last_usage.stages,
                         .srcAccessMask        = last_usage.access,
                         .dstStageMask         = last_usage.stages,
@@ -178,12 +279,13 @@ void GroupBarrierGenerator::handleResource(
                         .buffer               = rsc.get(),
                         .offset               = 0,
                         .size                 = VK_WHOLE_SIZE
-                    });
+                    }
+                });
             }
             else
             {
-                barrier_pass->pre_image_barriers.insert({
-                    rsc, vk::ImageMemoryBarrier2KHR{
+                barrier_pass->pre_image_barriers.push_back({
+                    record.index, vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
                         .dstStageMask        = usage.stages,
@@ -193,12 +295,12 @@ void GroupBarrierGenerator::handleResource(
                         .srcQueueFamilyIndex = last_group->queue->getFamilyIndex(),
                         .dstQueueFamilyIndex = group->queue->getFamilyIndex(),
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
+                        .subresourceRange    = rsc.range
                     }
                 });
 
-                last_usage.pass->post_ext_image_barriers.insert(
-                    vk::ImageMemoryBarrier2KHR{
+                releases.image_barriers.push_back({
+                    last_usage.pass, vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = last_usage.stages,
                         .srcAccessMask       = last_usage.access,
                         .dstStageMask        = last_usage.stages,
@@ -208,8 +310,9 @@ void GroupBarrierGenerator::handleResource(
                         .srcQueueFamilyIndex = last_group->queue->getFamilyIndex(),
                         .dstQueueFamilyIndex = group->queue->getFamilyIndex(),
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
-                    });
+                        .subresourceRange    = rsc.range
+                    }
+                });
             }
         }
         else if constexpr(!is_buffer)
@@ -219,8 +322,8 @@ void GroupBarrierGenerator::handleResource(
             if(last_usage.layout != usage.layout)
             {
                 auto barrier_pass = getBarrierPass(nullptr, pass);
-                barrier_pass->pre_image_barriers.insert({
-                    rsc, vk::ImageMemoryBarrier2KHR{
+                barrier_pass->pre_image_barriers.push_back({
+                    record.index, vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
                         .dstStageMask        = usage.stages,
@@ -230,7 +333,7 @@ void GroupBarrierGenerator::handleResource(
                         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
+                        .subresourceRange    = rsc.range
                     }
                 });
             }
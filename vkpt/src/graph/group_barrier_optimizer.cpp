@@ -1,9 +1,188 @@
+#include <algorithm>
 #include <ranges>
+#include <tuple>
 
 #include <vkpt/graph/group_barrier_optimizer.h>
 
 VKPT_GRAPH_BEGIN
 
+namespace
+{
+
+    using RangeField = uint32_t vk::ImageSubresourceRange::*;
+
+    const vk::ImageMemoryBarrier2KHR &getImageBarrier(
+        const vk::ImageMemoryBarrier2KHR &barrier)
+    {
+        return barrier;
+    }
+
+    vk::ImageMemoryBarrier2KHR &getImageBarrier(
+        vk::ImageMemoryBarrier2KHR &barrier)
+    {
+        return barrier;
+    }
+
+    template<typename T>
+    auto &getImageBarrier(std::pair<int, T> &barrier)
+    {
+        return barrier.second;
+    }
+
+    template<typename T>
+    auto &getImageBarrier(const std::pair<int, T> &barrier)
+    {
+        return barrier.second;
+    }
+
+    // everything except the subresource range
+    auto getSyncKey(const vk::ImageMemoryBarrier2KHR &b)
+    {
+        return std::tie(
+            b.image,
+            b.srcStageMask, b.srcAccessMask,
+            b.dstStageMask, b.dstAccessMask,
+            b.oldLayout, b.newLayout,
+            b.srcQueueFamilyIndex, b.dstQueueFamilyIndex);
+    }
+
+    // merge barriers whose ranges are contiguous along (base, count) and
+    // identical in all other fields
+    template<typename T>
+    void mergeAlong(
+        Vector<T> &barriers,
+        RangeField base,       RangeField count,
+        RangeField other_base, RangeField other_count)
+    {
+        auto get_key = [&](const T &barrier)
+        {
+            auto &b = getImageBarrier(barrier);
+            auto &r = b.subresourceRange;
+            return std::tuple_cat(
+                getSyncKey(b),
+                std::tie(
+                    r.aspectMask, r.*other_base, r.*other_count, r.*base));
+        };
+
+        std::ranges::sort(barriers, [&](const T &a, const T &b)
+        {
+            return get_key(a) < get_key(b);
+        });
+
+        size_t output = 0;
+        for(size_t i = 0; i < barriers.size(); ++i)
+        {
+            if(output > 0)
+            {
+                auto &last = getImageBarrier(barriers[output - 1]);
+                auto &curr = getImageBarrier(barriers[i]);
+                auto &lr = last.subresourceRange;
+                auto &cr = curr.subresourceRange;
+                if(getSyncKey(last) == getSyncKey(curr) &&
+                   lr.aspectMask == cr.aspectMask &&
+                   lr.*other_base == cr.*other_base &&
+                   lr.*other_count == cr.*other_count &&
+                   lr.*base + lr.*count == cr.*base)
+                {
+                    lr.*count += cr.*count;
+                    continue;
+                }
+            }
+            if(output != i)
+                barriers[output] = barriers[i];
+            ++output;
+        }
+        barriers.resize(output);
+    }
+
+    // merge barriers that differ only in aspect
+    template<typename T>
+    void mergeAspects(Vector<T> &barriers)
+    {
+        auto get_key = [&](const T &barrier)
+        {
+            auto &b = getImageBarrier(barrier);
+            auto &r = b.subresourceRange;
+            return std::tuple_cat(
+                getSyncKey(b),
+                std::tie(
+                    r.baseMipLevel, r.levelCount,
+                    r.baseArrayLayer, r.layerCount));
+        };
+
+        std::ranges::sort(barriers, [&](const T &a, const T &b)
+        {
+            return get_key(a) < get_key(b);
+        });
+
+        size_t output = 0;
+        for(size_t i = 0; i < barriers.size(); ++i)
+        {
+            if(output > 0 &&
+               get_key(barriers[output - 1]) == get_key(barriers[i]))
+            {
+                auto &last = getImageBarrier(barriers[output - 1]);
+                auto &curr = getImageBarrier(barriers[i]);
+                last.subresourceRange.aspectMask |=
+                    curr.subresourceRange.aspectMask;
+                continue;
+            }
+            if(output != i)
+                barriers[output] = barriers[i];
+            ++output;
+        }
+        barriers.resize(output);
+    }
+
+    template<typename T>
+    void mergeImageBarrierRanges(Vector<T> &barriers)
+    {
+        using R = vk::ImageSubresourceRange;
+
+        if(barriers.size() < 2)
+            return;
+
+        mergeAlong(
+            barriers,
+            &R::baseMipLevel, &R::levelCount,
+            &R::baseArrayLayer, &R::layerCount);
+        mergeAlong(
+            barriers,
+            &R::baseArrayLayer, &R::layerCount,
+            &R::baseMipLevel, &R::levelCount);
+        mergeAspects(barriers);
+    }
+
+    // passes of a run are not ordered with each other. giving all of them
+    // the union of their stages and access makes the barriers around the
+    // run the same for every pass, so that they can be shared
+    template<typename Usages>
+    void mergeRuns(Usages &usages)
+    {
+        for(auto first = usages.begin(); first != usages.end();)
+        {
+            auto last = getRunEnd(usages, first);
+
+            auto stages = first->stages;
+            auto access = first->access;
+            for(auto it = std::next(first); it != last; ++it)
+            {
+                stages |= it->stages;
+                access |= it->access;
+            }
+
+            for(auto it = first; it != last; ++it)
+            {
+                it->stages = stages;
+                it->access = access;
+            }
+
+            first = last;
+        }
+    }
+
+} // namespace anonymous
+
 bool GroupBarrierOptimizer::isReadOnly(vk::AccessFlags2KHR access)
 {
     const vk::AccessFlagBits2KHR write_bits[] = {
@@ -33,12 +212,20 @@ bool GroupBarrierOptimizer::isReadOnly(vk::AccessFlags2KHR access)
     return true;
 }
 
-void GroupBarrierOptimizer::optimize(ResourceRecords &records)
+void GroupBarrierOptimizer::optimize(
+    ResourceRecords &records, ThreadPool *thread_pool)
 {
-    for(auto &record : std::views::values(records.getBuffers()))
-        mergeNeighboringUsages(record);
-    for(auto &record : std::views::values(records.getImages()))
-        mergeNeighboringUsages(record);
+    auto &buffers = records.getBuffers();
+    auto &images = records.getImages();
+
+    parallelFor(
+        thread_pool, buffers.size() + images.size(), [&](uint32_t, size_t i)
+    {
+        if(i < buffers.size())
+            mergeNeighboringUsages(buffers[i]);
+        else
+            mergeNeighboringUsages(images[i - buffers.size()]);
+    });
 }
 
 void GroupBarrierOptimizer::optimize(CompileGroup *group)
@@ -46,40 +233,22 @@ void GroupBarrierOptimizer::optimize(CompileGroup *group)
     movePreExtBarriers(group);
     movePostExtBarriers(group);
     mergePreAndPostBarriers(group);
+
+    for(auto pass : group->passes)
+        pass->removeDuplicates();
+
+    mergeImageBarriers(group);
     convertBufferBarrierToGlobalMemoryBarrier(group);
 }
 
 void GroupBarrierOptimizer::mergeNeighboringUsages(CompileBuffer &record)
 {
-    for(auto it = record.usages.begin(), jt = std::next(it);
-        jt != record.usages.end(); it = jt++)
-    {
-        auto &this_usage = *it, &next_usage = *jt;
-        if(isReadOnly(this_usage.access) && isReadOnly(next_usage.access))
-        {
-            this_usage.stages |= next_usage.stages;
-            this_usage.access |= next_usage.access;
-            next_usage.stages = this_usage.stages;
-            next_usage.access = this_usage.access;
-        }
-    }
+    mergeRuns(record.usages);
 }
 
 void GroupBarrierOptimizer::mergeNeighboringUsages(CompileImage &record)
 {
-    for(auto it = record.usages.begin(), jt = std::next(it);
-        jt != record.usages.end(); it = jt++)
-    {
-        auto &this_usage = *it, &next_usage = *jt;
-        if(isReadOnly(this_usage.access) && isReadOnly(next_usage.access) &&
-           this_usage.exit_layout == next_usage.layout)
-        {
-            this_usage.stages |= next_usage.stages;
-            this_usage.access |= next_usage.access;
-            next_usage.stages = this_usage.stages;
-            next_usage.access = this_usage.access;
-        }
-    }
+    mergeRuns(record.usages);
 }
 
 void GroupBarrierOptimizer::movePreExtBarriers(CompileGroup *group)
@@ -108,16 +277,16 @@ void GroupBarrierOptimizer::movePreExtBarriers(CompileGroup *group)
         if(!dst)
             continue;
 
-        std::copy(
+        dst->pre_ext_buffer_barriers.insert(
+            dst->pre_ext_buffer_barriers.end(),
             pass->pre_ext_buffer_barriers.begin(),
-            pass->pre_ext_buffer_barriers.end(),
-            agz::misc::direct_inserter(dst->pre_ext_buffer_barriers));
+            pass->pre_ext_buffer_barriers.end());
         pass->pre_ext_buffer_barriers.clear();
 
-        std::copy(
+        dst->pre_ext_image_barriers.insert(
+            dst->pre_ext_image_barriers.end(),
             pass->pre_ext_image_barriers.begin(),
-            pass->pre_ext_image_barriers.end(),
-            agz::misc::direct_inserter(dst->pre_ext_image_barriers));
+            pass->pre_ext_image_barriers.end());
         pass->pre_ext_image_barriers.clear();
     }
 }
@@ -152,30 +321,30 @@ void GroupBarrierOptimizer::movePostExtBarriers(CompileGroup *group)
            !dst->pre_ext_image_barriers.empty() ||
            !dst->pre_ext_buffer_barriers.empty())
         {
-            std::copy(
+            dst->pre_ext_buffer_barriers.insert(
+                dst->pre_ext_buffer_barriers.end(),
                 pass->post_ext_buffer_barriers.begin(),
-                pass->post_ext_buffer_barriers.end(),
-                agz::misc::direct_inserter(dst->pre_ext_buffer_barriers));
+                pass->post_ext_buffer_barriers.end());
 
-            std::copy(
+            dst->pre_ext_image_barriers.insert(
+                dst->pre_ext_image_barriers.end(),
                 pass->post_ext_image_barriers.begin(),
-                pass->post_ext_image_barriers.end(),
-                agz::misc::direct_inserter(dst->pre_ext_image_barriers));
+                pass->post_ext_image_barriers.end());
         }
         else
         {
             assert(!dst->post_ext_buffer_barriers.empty() ||
                    !dst->post_ext_image_barriers.empty());
 
-            std::copy(
+            dst->post_ext_buffer_barriers.insert(
+                dst->post_ext_buffer_barriers.end(),
                 pass->post_ext_buffer_barriers.begin(),
-                pass->post_ext_buffer_barriers.end(),
-                agz::misc::direct_inserter(dst->post_ext_buffer_barriers));
+                pass->post_ext_buffer_barriers.end());
 
-            std::copy(
+            dst->post_ext_image_barriers.insert(
+                dst->post_ext_image_barriers.end(),
                 pass->post_ext_image_barriers.begin(),
-                pass->post_ext_image_barriers.end(),
-                agz::misc::direct_inserter(dst->post_ext_image_barriers));
+                pass->post_ext_image_barriers.end());
         }
 
         pass->post_ext_buffer_barriers.clear();
@@ -194,21 +363,37 @@ void GroupBarrierOptimizer::mergePreAndPostBarriers(CompileGroup *group)
            last_pass->post_ext_image_barriers.empty())
             continue;
 
-        std::copy(
+        pass->pre_ext_buffer_barriers.insert(
+            pass->pre_ext_buffer_barriers.end(),
             last_pass->post_ext_buffer_barriers.begin(),
-            last_pass->post_ext_buffer_barriers.end(),
-            agz::misc::direct_inserter(pass->pre_ext_buffer_barriers));
+            last_pass->post_ext_buffer_barriers.end());
 
-        std::copy(
+        pass->post_ext_image_barriers.insert(
+            pass->post_ext_image_barriers.end(),
             last_pass->post_ext_image_barriers.begin(),
-            last_pass->post_ext_image_barriers.end(),
-            agz::misc::direct_inserter(pass->post_ext_image_barriers));
+            last_pass->post_ext_image_barriers.end());
 
         last_pass->post_ext_buffer_barriers.clear();
         last_pass->post_ext_image_barriers.clear();
     }
 }
 
+void GroupBarrierOptimizer::mergeImageBarriers(CompileGroup *group)
+{
+    // barriers in the same pipelineBarrier call are unordered,
+    // so they can be freely sorted and merged into ranges
+
+    for(auto pass : group->passes)
+    {
+        mergeImageBarrierRanges(pass->pre_image_barriers);
+        mergeImageBarrierRanges(pass->pre_ext_image_barriers);
+        mergeImageBarrierRanges(pass->post_ext_image_barriers);
+    }
+
+    for(auto &event : group->events)
+        mergeImageBarrierRanges(event.image_barriers);
+}
+
 void GroupBarrierOptimizer::convertBufferBarrierToGlobalMemoryBarrier(
     CompileGroup *group)
 {
@@ -229,29 +414,20 @@ void GroupBarrierOptimizer::convertBufferBarrierToGlobalMemoryBarrier(
 
     for(auto pass : group->passes)
     {
-        for(auto it = pass->pre_buffer_barriers.begin(), jt = it;
-            it != pass->pre_buffer_barriers.end(); it = jt)
+        std::erase_if(pass->pre_buffer_barriers, [&](const auto &barrier)
         {
-            ++jt;
-            if(process(it->second, pass->pre_memory_barrier))
-                pass->pre_buffer_barriers.erase(it);
-        }
+            return process(barrier.second, pass->pre_memory_barrier);
+        });
 
-        for(auto it = pass->pre_ext_buffer_barriers.begin(), jt = it;
-            it != pass->pre_ext_buffer_barriers.end(); it = jt)
+        std::erase_if(pass->pre_ext_buffer_barriers, [&](const auto &barrier)
         {
-            ++jt;
-            if(process(*it, pass->pre_memory_barrier))
-                pass->pre_ext_buffer_barriers.erase(it);
-        }
+            return process(barrier, pass->pre_memory_barrier);
+        });
 
-        for(auto it = pass->post_ext_buffer_barriers.begin(), jt = it;
-            it != pass->post_ext_buffer_barriers.end(); it = jt)
+        std::erase_if(pass->post_ext_buffer_barriers, [&](const auto &barrier)
         {
-            ++jt;
-            if(process(*it, pass->post_memory_barrier))
-                pass->post_ext_buffer_barriers.erase(it);
-        }
+            return process(barrier, pass->post_memory_barrier);
+        });
     }
 }
 
@@ -1,82 +1,383 @@
+#include <algorithm>
+#include <cassert>
+#include <ranges>
+
 #include <vkpt/graph/resource_records.h>
 
 VKPT_GRAPH_BEGIN
 
-ResourceRecords::ResourceRecords(std::pmr::memory_resource &memory)
-    : memory_(memory), compile_buffers_(&memory), compile_images_(&memory)
+namespace
+{
+
+    void sortAndUnique(Vector<uint32_t> &bounds)
+    {
+        std::sort(bounds.begin(), bounds.end());
+        bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    }
+
+    uint32_t findBound(const Vector<uint32_t> &bounds, uint32_t value)
+    {
+        auto it = std::lower_bound(bounds.begin(), bounds.end(), value);
+        assert(it != bounds.end() && *it == value);
+        return static_cast<uint32_t>(it - bounds.begin());
+    }
+
+} // namespace anonymous
+
+size_t ResourceRecords::ImagePartitionKeyHash::operator()(
+    const ImagePartitionKey &key) const
+{
+    return std::hash<VkImage>()(key.image) ^ (size_t(key.aspect) << 1);
+}
+
+ResourceRecords::ImagePartition::ImagePartition(
+    std::pmr::memory_resource &memory,
+    const Image               &image,
+    vk::ImageAspectFlagBits    aspect)
+    : image(image),
+      aspect(aspect),
+      mip_bounds(&memory),
+      layer_bounds(&memory),
+      records(&memory)
+{
+    
+}
+
+template<typename F>
+void ResourceRecords::ImagePartition::foreachCell(
+    const vk::ImageSubresourceRange &range, const F &f) const
+{
+    const uint32_t mip_beg = findBound(mip_bounds, range.baseMipLevel);
+    const uint32_t mip_end = findBound(
+        mip_bounds, range.baseMipLevel + range.levelCount);
+
+    const uint32_t layer_beg = findBound(layer_bounds, range.baseArrayLayer);
+    const uint32_t layer_end = findBound(
+        layer_bounds, range.baseArrayLayer + range.layerCount);
+
+    const uint32_t mip_cell_count =
+        static_cast<uint32_t>(mip_bounds.size() - 1);
+
+    for(uint32_t li = layer_beg; li < layer_end; ++li)
+    {
+        for(uint32_t mi = mip_beg; mi < mip_end; ++mi)
+        {
+            f(li * mip_cell_count + mi, vk::ImageSubresourceRange{
+                .aspectMask     = aspect,
+                .baseMipLevel   = mip_bounds[mi],
+                .levelCount     = mip_bounds[mi + 1] - mip_bounds[mi],
+                .baseArrayLayer = layer_bounds[li],
+                .layerCount     = layer_bounds[li + 1] - layer_bounds[li]
+            });
+        }
+    }
+}
+
+void ResourceRecords::ImagePartition::addStateBounds()
+{
+    // split cells wherever neighboring subresources have different initial
+    // states, so that every cell has a uniform state
+
+    const auto [mip_min, mip_max] = std::ranges::minmax(mip_bounds);
+    const auto [layer_min, layer_max] = std::ranges::minmax(layer_bounds);
+
+    auto get_state = [&](uint32_t mip, uint32_t layer) -> const ResourceState &
+    {
+        return image.getState(vk::ImageSubresource{
+            .aspectMask = aspect,
+            .mipLevel   = mip,
+            .arrayLayer = layer
+        });
+    };
+
+    for(uint32_t mip = mip_min + 1; mip < mip_max; ++mip)
+    {
+        for(uint32_t layer = layer_min; layer < layer_max; ++layer)
+        {
+            if(!isSameState(get_state(mip, layer), get_state(mip - 1, layer)))
+            {
+                mip_bounds.push_back(mip);
+                break;
+            }
+        }
+    }
+
+    for(uint32_t layer = layer_min + 1; layer < layer_max; ++layer)
+    {
+        for(uint32_t mip = mip_min; mip < mip_max; ++mip)
+        {
+            if(!isSameState(get_state(mip, layer), get_state(mip, layer - 1)))
+            {
+                layer_bounds.push_back(layer);
+                break;
+            }
+        }
+    }
+}
+
+void ResourceRecords::ImagePartition::finalizeBounds()
+{
+    sortAndUnique(mip_bounds);
+    sortAndUnique(layer_bounds);
+    records.assign((mip_bounds.size() - 1) * (layer_bounds.size() - 1), -1);
+}
+
+ResourceRecords::ResourceRecords(
+    std::pmr::memory_resource &memory, Messenger *messenger)
+    : memory_(memory),
+      messenger_(messenger),
+      compile_buffers_(&memory),
+      compile_images_(&memory),
+      buffer_indices_(&memory),
+      image_partitions_(&memory),
+      image_partition_indices_(&memory)
 {
     
 }
 
-void ResourceRecords::build(std::span<CompilePass*> sorted_passes)
+void ResourceRecords::build(
+    std::span<CompilePass *>               sorted_passes,
+    std::span<const ImageSubresourceRange> extra_image_ranges,
+    ThreadPool                            *thread_pool)
 {
     assert(compile_buffers_.empty() && compile_images_.empty());
 
-    auto create_compile_buffer = agz::misc::lazy_construct(
-        [this] { return CompileBuffer(memory_); });
+    // collect cell boundaries
+
+    auto add_bounds = [&](const ImageSubresourceRange &image_range)
+    {
+        auto &range = image_range.range;
+        foreachAspect(range.aspectMask, [&](vk::ImageAspectFlagBits aspect)
+        {
+            auto &partition = getPartition(image_range.image, aspect);
+            partition.mip_bounds.push_back(range.baseMipLevel);
+            partition.mip_bounds.push_back(
+                range.baseMipLevel + range.levelCount);
+            partition.layer_bounds.push_back(range.baseArrayLayer);
+            partition.layer_bounds.push_back(
+                range.baseArrayLayer + range.layerCount);
+        });
+    };
+
+    for(auto pass : sorted_passes)
+    {
+        for(auto &image_range : std::views::keys(
+            pass->raw_pass->_getImageUsages()))
+            add_bounds(image_range);
+    }
 
-    auto create_compile_image = agz::misc::lazy_construct(
-        [this] { return CompileImage(memory_); });
+    for(auto &image_range : extra_image_ranges)
+        add_bounds(image_range);
+
+    // partitions of large images scan the states of many subresources
+
+    parallelFor(thread_pool, image_partitions_.size(), [&](uint32_t, size_t i)
+    {
+        image_partitions_[i].addStateBounds();
+        image_partitions_[i].finalizeBounds();
+    });
+
+    // fill usages
 
     for(auto pass : sorted_passes)
     {
         for(auto &[buffer, usage] : pass->raw_pass->_getBufferUsages())
         {
-            auto &compile_buffer = compile_buffers_.try_emplace(
-                buffer, create_compile_buffer).first->second;
+            auto [it, is_new] = buffer_indices_.try_emplace(
+                static_cast<VkBuffer>(buffer.get()),
+                static_cast<int>(compile_buffers_.size()));
+            if(is_new)
+                compile_buffers_.emplace_back(memory_, it->second, buffer);
 
-            compile_buffer.usages.push_back(CompileBufferUsage{
+            compile_buffers_[it->second].usages.push_back(CompileBufferUsage{
                 .pass       = pass,
                 .stages     = usage.stages,
                 .access     = usage.access
             });
         }
 
-        for(auto &[image_subrsc, usage] : pass->raw_pass->_getImageUsages())
+        for(auto &[image_range, usage] : pass->raw_pass->_getImageUsages())
         {
-            auto &compile_image = compile_images_.try_emplace(
-                image_subrsc, create_compile_image).first->second;
-
-            compile_image.usages.push_back(CompileImageUsage{
-                .pass        = pass,
-                .stages      = usage.stages,
-                .access      = usage.access,
-                .layout      = usage.layout,
-                .exit_layout = usage.exit_layout
+            auto &range = image_range.range;
+            foreachAspect(range.aspectMask, [&](vk::ImageAspectFlagBits aspect)
+            {
+                auto &partition = getPartition(image_range.image, aspect);
+                partition.foreachCell(range, [&](
+                    uint32_t cell, const vk::ImageSubresourceRange &cell_range)
+                {
+                    int &index = partition.records[cell];
+                    if(index < 0)
+                    {
+                        index = static_cast<int>(compile_images_.size());
+                        compile_images_.emplace_back(
+                            memory_, index,
+                            ImageSubresourceRange{ image_range.image, cell_range });
+                    }
+
+                    auto &record = compile_images_[index];
+
+                    // overlapping ranges used by the same pass
+
+                    if(!record.usages.empty() && record.usages.back().pass == pass)
+                    {
+                        auto &last = record.usages.back();
+                        if(last.layout != usage.layout ||
+                           last.exit_layout != usage.exit_layout)
+                        {
+                            messenger_->fatal(
+                                "overlapping ranges of image {} are used with "
+                                "different layouts in pass {}",
+                                image_range.getName(),
+                                pass->raw_pass->getPassName());
+                        }
+                        last.stages |= usage.stages;
+                        last.access |= usage.access;
+                        return;
+                    }
+
+                    record.usages.push_back(CompileImageUsage{
+                        .pass        = pass,
+                        .stages      = usage.stages,
+                        .access      = usage.access,
+                        .layout      = usage.layout,
+                        .exit_layout = usage.exit_layout
+                    });
+                });
             });
         }
     }
 }
 
-Map<Buffer, CompileBuffer> &ResourceRecords::getBuffers()
+void ResourceRecords::buildPassUsages()
+{
+    for(auto &record : compile_buffers_)
+    {
+        for(auto it = record.usages.begin(); it != record.usages.end(); ++it)
+            it->pass->buffer_usages.push_back({ record.index, it });
+    }
+
+    for(auto &record : compile_images_)
+    {
+        for(auto it = record.usages.begin(); it != record.usages.end(); ++it)
+            it->pass->image_usages.push_back({ record.index, it });
+    }
+}
+
+Vector<CompileBuffer> &ResourceRecords::getBuffers()
+{
+    return compile_buffers_;
+}
+
+Vector<CompileImage> &ResourceRecords::getImages()
+{
+    return compile_images_;
+}
+
+const Vector<CompileBuffer> &ResourceRecords::getBuffers() const
 {
     return compile_buffers_;
 }
 
-Map<ImageSubresource, CompileImage> &ResourceRecords::getImages()
+const Vector<CompileImage> &ResourceRecords::getImages() const
 {
     return compile_images_;
 }
 
 CompileBuffer &ResourceRecords::getRecord(const Buffer &buffer)
 {
-    return compile_buffers_.at(buffer);
+    return compile_buffers_[
+        buffer_indices_.at(static_cast<VkBuffer>(buffer.get()))];
 }
 
-CompileImage &ResourceRecords::getRecord(const ImageSubresource &image_subrsc)
+CompileImage &ResourceRecords::getRecord(const ImageSubresourceRange &image_range)
 {
-    return compile_images_.at(image_subrsc);
+    return const_cast<CompileImage &>(
+        std::as_const(*this).getRecord(image_range));
 }
 
 const CompileBuffer &ResourceRecords::getRecord(const Buffer &buffer) const
 {
-    return compile_buffers_.at(buffer);
+    return compile_buffers_[
+        buffer_indices_.at(static_cast<VkBuffer>(buffer.get()))];
 }
 
 const CompileImage &ResourceRecords::getRecord(
-    const ImageSubresource &image_subrsc) const
+    const ImageSubresourceRange &image_range) const
 {
-    return compile_images_.at(image_subrsc);
+    auto partition = findPartition(
+        image_range.image,
+        static_cast<vk::ImageAspectFlagBits>(
+            static_cast<VkImageAspectFlags>(image_range.range.aspectMask)));
+    assert(partition);
+
+    int index = -1;
+    partition->foreachCell(image_range.range, [&](
+        uint32_t cell, const vk::ImageSubresourceRange &cell_range)
+    {
+        assert(cell_range == image_range.range);
+        index = partition->records[cell];
+    });
+
+    assert(index >= 0);
+    return compile_images_[index];
+}
+
+bool ResourceRecords::getRecords(
+    const ImageSubresourceRange &image_range, Vector<int> &output) const
+{
+    auto &range = image_range.range;
+
+    bool result = true;
+    foreachAspect(range.aspectMask, [&](vk::ImageAspectFlagBits aspect)
+    {
+        auto partition = findPartition(image_range.image, aspect);
+        if(!partition)
+        {
+            result = false;
+            return;
+        }
+
+        partition->foreachCell(range, [&](
+            uint32_t cell, const vk::ImageSubresourceRange &)
+        {
+            const int index = partition->records[cell];
+            if(index < 0)
+                result = false;
+            else
+                output.push_back(index);
+        });
+    });
+
+    return result;
+}
+
+ResourceRecords::ImagePartition &ResourceRecords::getPartition(
+    const Image &image, vk::ImageAspectFlagBits aspect)
+{
+    const ImagePartitionKey key = {
+        static_cast<VkImage>(image.get()),
+        static_cast<VkImageAspectFlags>(aspect)
+    };
+
+    auto [it, is_new] = image_partition_indices_.try_emplace(
+        key, static_cast<int>(image_partitions_.size()));
+    if(is_new)
+        image_partitions_.emplace_back(memory_, image, aspect);
+
+    return image_partitions_[it->second];
+}
+
+const ResourceRecords::ImagePartition *ResourceRecords::findPartition(
+    const Image &image, vk::ImageAspectFlagBits aspect) const
+{
+    const ImagePartitionKey key = {
+        static_cast<VkImage>(image.get()),
+        static_cast<VkImageAspectFlags>(aspect)
+    };
+
+    auto it = image_partition_indices_.find(key);
+    return it != image_partition_indices_.end() ?
+        &image_partitions_[it->second] : nullptr;
 }
 
 VKPT_GRAPH_END
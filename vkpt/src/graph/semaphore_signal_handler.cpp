@@ -3,13 +3,16 @@
 VKPT_GRAPH_BEGIN
 
 SemaphoreSignalHandler::SemaphoreSignalHandler(
-    std::pmr::memory_resource            &memory,
-    const DAGTransitiveClosure           *closure,
-    Map<Buffer, ResourceState>           &buffer_final_states,
-    Map<ImageSubresource, ResourceState> &image_final_states,
-    std::function<CompilePass *()>        create_post_pass)
+    std::pmr::memory_resource                 &memory,
+    Messenger                                 *messenger,
+    const DAGTransitiveClosure                *closure,
+    Map<Buffer, ResourceState>                &buffer_final_states,
+    Map<ImageSubresourceRange, ResourceState> &image_final_states,
+    std::function<CompilePass *()>             create_post_pass)
     : memory_(memory),
       signaling_semaphore_to_resources_(&memory),
+      image_signals_(&memory),
+      messenger_(messenger),
       closure_(closure),
       buffer_final_states_(buffer_final_states),
       image_final_states_(image_final_states),
@@ -18,7 +21,8 @@ SemaphoreSignalHandler::SemaphoreSignalHandler(
     
 }
 
-void SemaphoreSignalHandler::collectSignalingSemaphores(const Graph &graph)
+void SemaphoreSignalHandler::collectSignalingSemaphores(
+    const Graph &graph, const ResourceRecords &resource_records)
 {
     auto create_list = agz::misc::lazy_construct([&]
     {
@@ -31,11 +35,24 @@ void SemaphoreSignalHandler::collectSignalingSemaphores(const Graph &graph)
             signal.semaphore, create_list).first->second;
         resources.push_back(buffer);
     }
-    for(auto &[image_subrsc, signal] : graph.image_signals_)
+    Vector<int> records(&memory_);
+    for(auto &[image_range, signal] : graph.image_signals_)
     {
+        records.clear();
+        if(!resource_records.getRecords(image_range, records))
+        {
+            messenger_->fatal(
+                "image '{}' is declared with a signaling semaphore but is "
+                "not fully used by the graph.", image_range.getName());
+        }
+
         auto &resources = signaling_semaphore_to_resources_.try_emplace(
             signal.semaphore, create_list).first->second;
-        resources.push_back(image_subrsc);
+        for(int index : records)
+        {
+            resources.push_back(resource_records.getImages()[index].resource);
+            image_signals_[index] = &signal;
+        }
     }
 }
 
@@ -70,7 +87,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
     if constexpr(is_buffer)
         p_signal = &graph.buffer_signals_.at(rsc);
     else
-        p_signal = &graph.image_signals_.at(rsc);
+        p_signal = image_signals_.at(record.index);
     auto &signal = *p_signal;
 
     auto &last_usage = record.usages.back();
@@ -89,7 +106,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
 
             if constexpr(is_buffer)
             {
-                /*last_pass->post_ext_buffer_barriers.insert(
+                /*last_pass->post_ext_buffer_barriers.push_back(
                     vk::BufferMemoryBarrier2KHR{
                         .srcStageMask        = last_usage.end_stages,
                         .srcAccessMask       = last_usage.end_access,
@@ -112,7 +129,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
             {
                 if(last_usage.exit_layout != signal.layout)
                 {
-                    last_pass->post_ext_image_barriers.insert(
+                    last_pass->post_ext_image_barriers.push_back(
                         vk::ImageMemoryBarrier2KHR{
                             .srcStageMask        = last_usage.stages,
                             .srcAccessMask       = last_usage.access,
@@ -123,7 +140,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                             .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                             .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                             .image               = rsc.image.get(),
-                            .subresourceRange    = subrscToRange(rsc.subrsc)
+                            .subresourceRange    = rsc.range
                         });
                 }
 
@@ -146,7 +163,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
 
                 if constexpr(is_buffer)
                 {
-                    necessary_pass->post_ext_buffer_barriers.insert(
+                    necessary_pass->post_ext_buffer_barriers.push_back(
                         vk::BufferMemoryBarrier2KHR{
                             .srcStageMask        = last_usage.stages,
                             .srcAccessMask       = last_usage.access,
@@ -166,7 +183,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                 }
                 else
                 {
-                    necessary_pass->post_ext_image_barriers.insert(
+                    necessary_pass->post_ext_image_barriers.push_back(
                         vk::ImageMemoryBarrier2KHR{
                             .srcStageMask        = last_usage.stages,
                             .srcAccessMask       = last_usage.access,
@@ -177,7 +194,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                             .srcQueueFamilyIndex = last_family,
                             .dstQueueFamilyIndex = signal_family,
                             .image               = rsc.image.get(),
-                            .subresourceRange    = subrscToRange(rsc.subrsc)
+                            .subresourceRange    = rsc.range
                         });
 
                     image_final_states_[rsc] = ReleasedState{
@@ -212,8 +229,6 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                         .stages     = vk::PipelineStageFlagBits2KHR::eNone,
                         .access     = vk::AccessFlagBits2KHR::eNone
                     });
-                    dummy_pass->generated_buffer_usages[rsc] =
-                        record.usages.back();
 
                     buffer_final_states_[rsc] = UsingState{
                         .queue  = signal.queue,
@@ -230,8 +245,6 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                         .layout      = signal.layout,
                         .exit_layout = signal.layout
                     });
-                    dummy_pass->generated_image_usages[rsc] =
-                        record.usages.back();
 
                     image_final_states_[rsc] = UsingState{
                         .queue = signal.queue,
@@ -252,7 +265,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
 
         if constexpr(is_buffer)
         {
-            /*last_pass->post_ext_buffer_barriers.insert(
+            /*last_pass->post_ext_buffer_barriers.push_back(
                 vk::BufferMemoryBarrier2KHR{
                     .srcStageMask        = last_usage.end_stages,
                     .srcAccessMask       = last_usage.end_access,
@@ -275,7 +288,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
         {
             if(last_usage.exit_layout != signal.layout)
             {
-                last_pass->post_ext_image_barriers.insert(
+                last_pass->post_ext_image_barriers.push_back(
                     vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = last_usage.stages,
                         .srcAccessMask       = last_usage.access,
@@ -286,7 +299,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
+                        .subresourceRange    = rsc.range
                     });
             }
 
@@ -309,7 +322,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
         {
             if constexpr(is_buffer)
             {
-                last_pass->post_ext_buffer_barriers.insert(
+                last_pass->post_ext_buffer_barriers.push_back(
                     vk::BufferMemoryBarrier2KHR{
                         .srcStageMask        = last_usage.stages,
                         .srcAccessMask       = last_usage.access,
@@ -329,7 +342,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
             }
             else
             {
-                last_pass->post_ext_image_barriers.insert(
+                last_pass->post_ext_image_barriers.push_back(
                     vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = last_usage.stages,
                         .srcAccessMask       = last_usage.access,
@@ -340,7 +353,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                         .srcQueueFamilyIndex = last_family,
                         .dstQueueFamilyIndex = signal_family,
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
+                        .subresourceRange    = rsc.range
                     });
 
                 image_final_states_[rsc] = ReleasedState{
@@ -362,8 +375,6 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                     .stages     = vk::PipelineStageFlagBits2KHR::eNone,
                     .access     = vk::AccessFlagBits2KHR::eNone
                 });
-                necessary_pass->generated_buffer_usages[rsc] =
-                    record.usages.back();
 
                 buffer_final_states_[rsc] = UsingState{
                     .queue  = necessary_pass->queue,
@@ -380,8 +391,6 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                     .layout      = signal.layout,
                     .exit_layout = signal.layout
                 });
-                necessary_pass->generated_image_usages[rsc] =
-                    record.usages.back();
 
                 image_final_states_[rsc] = UsingState{
                     .queue  = necessary_pass->queue,
@@ -406,7 +415,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
 
             if constexpr(is_buffer)
             {
-                last_pass->post_ext_buffer_barriers.insert(
+                last_pass->post_ext_buffer_barriers.push_back(
                     vk::BufferMemoryBarrier2KHR{
                         .srcStageMask        = last_usage.stages,
                         .srcAccessMask       = last_usage.access,
@@ -426,7 +435,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
             }
             else
             {
-                last_pass->post_ext_image_barriers.insert(
+                last_pass->post_ext_image_barriers.push_back(
                     vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = last_usage.stages,
                         .srcAccessMask       = last_usage.access,
@@ -437,7 +446,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                         .srcQueueFamilyIndex = last_family,
                         .dstQueueFamilyIndex = signal_family,
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
+                        .subresourceRange    = rsc.range
                     });
 
                 image_final_states_[rsc] = ReleasedState{
@@ -472,8 +481,6 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                     .stages     = vk::PipelineStageFlagBits2KHR::eNone,
                     .access     = vk::AccessFlagBits2KHR::eNone
                 });
-                dummy_pass->generated_buffer_usages[rsc] =
-                    record.usages.back();
 
                 buffer_final_states_[rsc] = UsingState{
                     .queue  = dummy_pass->queue,
@@ -490,8 +497,6 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
                     .layout      = signal.layout,
                     .exit_layout = signal.layout
                 });
-                dummy_pass->generated_image_usages[rsc] =
-                    record.usages.back();
 
                 image_final_states_[rsc] = UsingState{
                     .queue  = dummy_pass->queue,
@@ -522,7 +527,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
             record.has_signal_semaphore = true;
             passes.insert(record.usages.back().pass);
         },
-            [&](const ImageSubresource &image)
+            [&](const ImageSubresourceRange &image)
         {
             auto &record = resource_records.getRecord(image);
             record.has_signal_semaphore = true;
@@ -563,7 +568,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
     assert(!emit_passes.empty());
     if(emit_passes.size() == 1)
     {
-        auto &submit = (*emit_passes.begin())->signal_semaphores[semaphore];
+        auto &submit = (*emit_passes.begin())->getSignalSemaphore(getRaw(semaphore));
         semaphore.match(
             [&](const BinarySemaphore &binary)
         {
@@ -600,7 +605,7 @@ void SemaphoreSignalHandler::processSignalingSemaphore(
             signal_pass->heads.insert(p);
         }
 
-        auto &submit = signal_pass->signal_semaphores[semaphore];
+        auto &submit = signal_pass->getSignalSemaphore(getRaw(semaphore));
         semaphore.match(
             [&](const BinarySemaphore &binary)
         {
@@ -16,7 +16,8 @@ SemaphoreWaitHandler::SemaphoreWaitHandler(
     
 }
 
-void SemaphoreWaitHandler::collectWaitingSemaphores(const Graph &graph)
+void SemaphoreWaitHandler::collectWaitingSemaphores(
+    const Graph &graph, const ResourceRecords &resource_records)
 {
     auto create_list = agz::misc::lazy_construct([&]
     {
@@ -30,11 +31,21 @@ void SemaphoreWaitHandler::collectWaitingSemaphores(const Graph &graph)
         resources.push_back(buffer);
     }
 
-    for(auto &[image_subrsc, semaphore] : graph.image_waits_)
+    Vector<int> records(&memory_);
+    for(auto &[image_range, semaphore] : graph.image_waits_)
     {
+        records.clear();
+        if(!resource_records.getRecords(image_range, records))
+        {
+            messenger_->fatal(
+                "image '{}' is declared with a waiting semaphore but is "
+                "not fully used by the graph.", image_range.getName());
+        }
+
         auto &resources = waiting_semaphore_to_resources_.try_emplace(
             semaphore, create_list).first->second;
-        resources.push_back(image_subrsc);
+        for(int index : records)
+            resources.push_back(resource_records.getImages()[index].resource);
     }
 }
 
@@ -66,11 +77,7 @@ void SemaphoreWaitHandler::processResourceWait(
     auto &first_usage = record.usages.front();
     CompilePass *first_pass = first_usage.pass;
 
-    ResourceState state;
-    if constexpr(is_buffer)
-        state = rsc.getState();
-    else
-        state = rsc.image.getState(rsc.subrsc);
+    const ResourceState &state = getResourceState(rsc);
 
     state.match(
         [&](const FreeState &)
@@ -83,14 +90,14 @@ void SemaphoreWaitHandler::processResourceWait(
     {
         if(s.queue->getFamilyIndex() == first_pass->queue->getFamilyIndex())
         {
-            auto &submit = first_pass->wait_semaphores[binary];
-            assert(!submit.semaphore);
+            auto &submit = first_pass->getWaitSemaphore(binary);
+            assert(!submit.stageMask);
             submit.semaphore = binary;
             submit.stageMask = first_usage.stages;
 
             if constexpr(std::is_same_v<Resource, Buffer>)
             {
-                /*first_pass->pre_ext_buffer_barriers.insert(
+                /*first_pass->pre_ext_buffer_barriers.push_back(
                     vk::BufferMemoryBarrier2KHR{
                         .srcStageMask        = first_usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -108,7 +115,7 @@ void SemaphoreWaitHandler::processResourceWait(
             {
                 if(s.layout != first_usage.layout)
                 {
-                    first_pass->pre_ext_image_barriers.insert(
+                    first_pass->pre_ext_image_barriers.push_back(
                         vk::ImageMemoryBarrier2KHR{
                             .srcStageMask        = first_usage.stages,
                             .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -119,7 +126,7 @@ void SemaphoreWaitHandler::processResourceWait(
                             .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                             .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                             .image               = rsc.image.get(),
-                            .subresourceRange    = subrscToRange(rsc.subrsc)
+                            .subresourceRange    = rsc.range
                         });
                 }
             }
@@ -134,7 +141,7 @@ void SemaphoreWaitHandler::processResourceWait(
             dummy_pass->tails.insert(first_pass);
             first_pass->heads.insert(dummy_pass);
 
-            auto &submit = dummy_pass->wait_semaphores[binary];
+            auto &submit = dummy_pass->getWaitSemaphore(binary);
             submit.semaphore = binary;
             submit.stageMask = first_usage.stages;
 
@@ -145,8 +152,6 @@ void SemaphoreWaitHandler::processResourceWait(
                     .stages     = first_usage.stages,
                     .access     = vk::AccessFlagBits2KHR::eNone
                 });
-                dummy_pass->generated_buffer_usages[rsc] =
-                    record.usages.back();
             }
             else
             {
@@ -157,8 +162,6 @@ void SemaphoreWaitHandler::processResourceWait(
                     .layout      = s.layout,
                     .exit_layout = s.layout
                 });
-                dummy_pass->generated_image_usages[rsc] =
-                    record.usages.back();
             }
         }
     },
@@ -172,14 +175,14 @@ void SemaphoreWaitHandler::processResourceWait(
                 std::is_same_v<Resource, Buffer> ? "buffer" : "image", name);
         }
         
-        auto &submit = first_pass->wait_semaphores[binary];
-        assert(!submit.semaphore);
+        auto &submit = first_pass->getWaitSemaphore(binary);
+        assert(!submit.stageMask);
         submit.semaphore = binary;
         submit.stageMask = first_usage.stages;
 
         if constexpr(std::is_same_v<Resource, Buffer>)
         {
-            first_pass->pre_ext_buffer_barriers.insert(
+            first_pass->pre_ext_buffer_barriers.push_back(
                 vk::BufferMemoryBarrier2KHR{
                     .srcStageMask        = first_usage.stages,
                     .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -194,7 +197,7 @@ void SemaphoreWaitHandler::processResourceWait(
         }
         else
         {
-            first_pass->pre_ext_image_barriers.insert(
+            first_pass->pre_ext_image_barriers.push_back(
                 vk::ImageMemoryBarrier2KHR{
                     .srcStageMask        = first_usage.stages,
                     .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -205,7 +208,7 @@ void SemaphoreWaitHandler::processResourceWait(
                     .srcQueueFamilyIndex = s.src_queue->getFamilyIndex(),
                     .dstQueueFamilyIndex = s.dst_queue->getFamilyIndex(),
                     .image               = rsc.image.get(),
-                    .subresourceRange    = subrscToRange(rsc.subrsc)
+                    .subresourceRange    = rsc.range
                 });
         }
     });
@@ -227,7 +230,7 @@ void SemaphoreWaitHandler::processResourceWait(
 
     auto &name = rsc.getName();
 
-    const ResourceState &state = rsc.getState();
+    const ResourceState &state = getResourceState(rsc);
 
     state.match(
         [&](const FreeState &)
@@ -249,14 +252,14 @@ void SemaphoreWaitHandler::processResourceWait(
             {
                 // s, n, f: same queue family
 
-                auto &submit = necessary_pass->wait_semaphores[timeline];
+                auto &submit = necessary_pass->getWaitSemaphore(timeline);
                 submit.semaphore  = timeline;
                 submit.stageMask |= first_usage.stages;
                 submit.value      = timeline.getLastSignalValue();
 
                 if constexpr(is_buffer)
                 {
-                    /*necessary_pass->pre_ext_buffer_barriers.insert(
+                    /*necessary_pass->pre_ext_buffer_barriers.push_back(
                         vk::BufferMemoryBarrier2KHR{
                             .srcStageMask        = first_usage.stages,
                             .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -273,7 +276,7 @@ void SemaphoreWaitHandler::processResourceWait(
                 {
                     if(s.layout != first_usage.layout)
                     {
-                        necessary_pass->pre_ext_image_barriers.insert(
+                        necessary_pass->pre_ext_image_barriers.push_back(
                             vk::ImageMemoryBarrier2KHR{
                                 .srcStageMask        = first_usage.stages,
                                 .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -284,7 +287,7 @@ void SemaphoreWaitHandler::processResourceWait(
                                 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                                 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                                 .image               = rsc.image.get(),
-                                .subresourceRange    = subrscToRange(rsc.subrsc)
+                                .subresourceRange    = rsc.range
                             });
                     }
                 }
@@ -300,7 +303,7 @@ void SemaphoreWaitHandler::processResourceWait(
                 dummy_pass->tails.insert(first_pass);
                 first_pass->heads.insert(dummy_pass);
 
-                auto &submit = dummy_pass->wait_semaphores[timeline];
+                auto &submit = dummy_pass->getWaitSemaphore(timeline);
                 submit.semaphore = timeline;
                 submit.stageMask = first_usage.stages;
                 submit.value     = timeline.getLastSignalValue();
@@ -312,8 +315,6 @@ void SemaphoreWaitHandler::processResourceWait(
                         .stages     = first_usage.stages,
                         .access     = vk::AccessFlagBits2KHR::eNone
                     });
-                    dummy_pass->generated_buffer_usages[rsc] =
-                        record.usages.front();
                 }
                 else
                 {
@@ -324,8 +325,6 @@ void SemaphoreWaitHandler::processResourceWait(
                         .layout      = s.layout,
                         .exit_layout = s.layout
                     });
-                    dummy_pass->generated_image_usages[rsc] =
-                        record.usages.front();
                 }
             }
         }
@@ -336,14 +335,14 @@ void SemaphoreWaitHandler::processResourceWait(
                 // necessary_pass: queue_family 1
                 // s, first_pass: queue family 2
                 
-                auto &submit = first_pass->wait_semaphores[timeline];
+                auto &submit = first_pass->getWaitSemaphore(timeline);
                 submit.semaphore  = timeline;
                 submit.stageMask |= first_usage.stages;
                 submit.value      = timeline.getLastSignalValue();
 
                 if constexpr(is_buffer)
                 {
-                    /*first_pass->pre_ext_buffer_barriers.insert(
+                    /*first_pass->pre_ext_buffer_barriers.push_back(
                         vk::BufferMemoryBarrier2KHR{
                             .srcStageMask        = first_usage.stages,
                             .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -360,7 +359,7 @@ void SemaphoreWaitHandler::processResourceWait(
                 {
                     if(s.layout != first_usage.layout)
                     {
-                        first_pass->pre_ext_image_barriers.insert(
+                        first_pass->pre_ext_image_barriers.push_back(
                             vk::ImageMemoryBarrier2KHR{
                                 .srcStageMask        = first_usage.stages,
                                 .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -371,7 +370,7 @@ void SemaphoreWaitHandler::processResourceWait(
                                 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                                 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                                 .image               = rsc.image.get(),
-                                .subresourceRange    = subrscToRange(rsc.subrsc)
+                                .subresourceRange    = rsc.range
                             });
                     }
                 }
@@ -381,7 +380,7 @@ void SemaphoreWaitHandler::processResourceWait(
                 // s, necessary: queue family 1
                 // first_pass: queue family 2
 
-                auto &submit = necessary_pass->wait_semaphores[timeline];
+                auto &submit = necessary_pass->getWaitSemaphore(timeline);
                 submit.semaphore  = timeline;
                 submit.stageMask |= first_usage.stages;
                 submit.value      = timeline.getLastSignalValue();
@@ -393,8 +392,6 @@ void SemaphoreWaitHandler::processResourceWait(
                         .stages     = first_usage.stages,
                         .access     = vk::AccessFlagBits2KHR::eNone
                     });
-                    necessary_pass->generated_buffer_usages[rsc] =
-                        record.usages.front();
                 }
                 else
                 {
@@ -405,8 +402,6 @@ void SemaphoreWaitHandler::processResourceWait(
                         .layout      = s.layout,
                         .exit_layout = s.layout
                     });
-                    necessary_pass->generated_image_usages[rsc] =
-                        record.usages.front();
                 }
             }
             else
@@ -420,7 +415,7 @@ void SemaphoreWaitHandler::processResourceWait(
                 dummy_pass->tails.insert(first_pass);
                 first_pass->heads.insert(dummy_pass);
 
-                auto &submit = dummy_pass->wait_semaphores[timeline];
+                auto &submit = dummy_pass->getWaitSemaphore(timeline);
                 submit.semaphore = timeline;
                 submit.stageMask = first_usage.stages;
                 submit.value     = timeline.getLastSignalValue();
@@ -432,20 +427,16 @@ void SemaphoreWaitHandler::processResourceWait(
                         .stages     = first_usage.stages,
                         .access     = vk::AccessFlagBits2KHR::eNone
                     });
-                    dummy_pass->generated_buffer_usages[rsc] =
-                        record.usages.front();
                 }
                 else
                 {
                     record.usages.push_front(CompileImageUsage{
-                        .pass        = necessary_pass,
+                        .pass        = dummy_pass,
                         .stages      = first_usage.stages,
                         .access      = vk::AccessFlagBits2KHR::eNone,
                         .layout      = s.layout,
                         .exit_layout = s.layout
                     });
-                    dummy_pass->generated_image_usages[rsc] =
-                        record.usages.front();
                 }
             }
         }
@@ -463,14 +454,14 @@ void SemaphoreWaitHandler::processResourceWait(
         if(necessary_pass->queue->getFamilyIndex() ==
            first_pass->queue->getFamilyIndex())
         {
-            auto &submit = necessary_pass->wait_semaphores[timeline];
+            auto &submit = necessary_pass->getWaitSemaphore(timeline);
             submit.semaphore  = timeline;
             submit.stageMask |= first_usage.stages;
             submit.value      = timeline.getLastSignalValue();
 
             if constexpr(is_buffer)
             {
-                necessary_pass->pre_ext_buffer_barriers.insert(
+                necessary_pass->pre_ext_buffer_barriers.push_back(
                     vk::BufferMemoryBarrier2KHR{
                         .srcStageMask        = first_usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -485,7 +476,7 @@ void SemaphoreWaitHandler::processResourceWait(
             }
             else
             {
-                necessary_pass->pre_ext_image_barriers.insert(
+                necessary_pass->pre_ext_image_barriers.push_back(
                     vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = first_usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -496,20 +487,20 @@ void SemaphoreWaitHandler::processResourceWait(
                         .srcQueueFamilyIndex = s.src_queue->getFamilyIndex(),
                         .dstQueueFamilyIndex = s.dst_queue->getFamilyIndex(),
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
+                        .subresourceRange    = rsc.range
                     });
             }
         }
         else
         {
-            auto &submit = first_pass->wait_semaphores[timeline];
+            auto &submit = first_pass->getWaitSemaphore(timeline);
             submit.semaphore  = timeline;
             submit.stageMask |= first_usage.stages;
             submit.value      = timeline.getLastSignalValue();
 
             if constexpr(is_buffer)
             {
-                first_pass->pre_ext_buffer_barriers.insert(
+                first_pass->pre_ext_buffer_barriers.push_back(
                     vk::BufferMemoryBarrier2KHR{
                         .srcStageMask        = first_usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -524,7 +515,7 @@ void SemaphoreWaitHandler::processResourceWait(
             }
             else
             {
-                first_pass->pre_ext_image_barriers.insert(
+                first_pass->pre_ext_image_barriers.push_back(
                     vk::ImageMemoryBarrier2KHR{
                         .srcStageMask        = first_usage.stages,
                         .srcAccessMask       = vk::AccessFlagBits2KHR::eNone,
@@ -535,7 +526,7 @@ void SemaphoreWaitHandler::processResourceWait(
                         .srcQueueFamilyIndex = s.src_queue->getFamilyIndex(),
                         .dstQueueFamilyIndex = s.dst_queue->getFamilyIndex(),
                         .image               = rsc.image.get(),
-                        .subresourceRange    = subrscToRange(rsc.subrsc)
+                        .subresourceRange    = rsc.range
                     });
             }
         }
@@ -556,7 +547,7 @@ void SemaphoreWaitHandler::processWaitingSemaphore(
             "resources.",
             rsc.is<Buffer>() ? "buffer" : "image",
             rsc.is<Buffer>() ? rsc.as<Buffer>().getName() :
-            rsc.as<ImageSubresource>().getName());
+            rsc.as<ImageSubresourceRange>().getName());
     }
 
     resources.front().match(
@@ -585,7 +576,7 @@ void SemaphoreWaitHandler::processWaitingSemaphore(
             record.has_wait_semaphore = true;
             passes.insert(record.usages.front().pass);
         },
-            [&](const ImageSubresource &image)
+            [&](const ImageSubresourceRange &image)
         {
             auto &record = resource_records.getRecord(image);
             record.has_wait_semaphore = true;
@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <climits>
+#include <ranges>
+
+#include <vkpt/graph/transient_resource_pool.h>
+
+VKPT_GRAPH_BEGIN
+
+struct TransientResourcePool::Lifetime
+{
+    int resource = -1;
+
+    // positions in the linearized executable graph.
+    // usages/barriers at begin and end are included
+
+    int begin = INT_MAX;
+    int end   = -1;
+
+    const Queue *queue     = nullptr;
+    bool         aliasable = true;
+
+    vk::PipelineStageFlags2KHR first_stages;
+    vk::AccessFlags2KHR        first_access;
+    vk::PipelineStageFlags2KHR last_stages;
+    vk::AccessFlags2KHR        last_access;
+    bool                       has_usage = false;
+
+    vk::DeviceSize offset = 0;
+
+    void touch(int position, const Queue *q)
+    {
+        if(queue && queue != q)
+            aliasable = false;
+        queue = q;
+        begin = (std::min)(begin, position);
+        end   = (std::max)(end, position);
+    }
+
+    void use(
+        int                        position,
+        const Queue               *q,
+        vk::PipelineStageFlags2KHR stages,
+        vk::AccessFlags2KHR        access)
+    {
+        touch(position, q);
+        if(!has_usage)
+        {
+            first_stages = stages;
+            first_access = access;
+        }
+        last_stages = stages;
+        last_access = access;
+        has_usage = true;
+    }
+
+    bool conflicts(const Lifetime &other) const
+    {
+        if(!aliasable || !other.aliasable || queue != other.queue)
+            return true;
+        return !(end < other.begin || other.end < begin);
+    }
+};
+
+TransientResourcePool::TransientResourcePool()
+    : resource_allocator_(nullptr), frame_index_(0)
+{
+
+}
+
+TransientResourcePool::TransientResourcePool(
+    ResourceAllocator &resource_allocator, int frame_count)
+    : resource_allocator_(&resource_allocator), frame_index_(0)
+{
+    frames_.resize(frame_count);
+}
+
+TransientResourcePool::TransientResourcePool(
+    TransientResourcePool &&other) noexcept
+    : TransientResourcePool()
+{
+    swap(other);
+}
+
+TransientResourcePool &TransientResourcePool::operator=(
+    TransientResourcePool &&other) noexcept
+{
+    swap(other);
+    return *this;
+}
+
+TransientResourcePool::~TransientResourcePool()
+{
+    for(auto &frame : frames_)
+    {
+        frame.resources.clear();
+        freeHeaps(frame, false);
+    }
+}
+
+TransientResourcePool::operator bool() const
+{
+    return resource_allocator_ != nullptr;
+}
+
+void TransientResourcePool::swap(TransientResourcePool &other) noexcept
+{
+    std::swap(resource_allocator_, other.resource_allocator_);
+    std::swap(frame_index_, other.frame_index_);
+    std::swap(frames_, other.frames_);
+    std::swap(image_barrier_patches_, other.image_barrier_patches_);
+    std::swap(memory_barrier_patches_, other.memory_barrier_patches_);
+}
+
+void TransientResourcePool::newFrame()
+{
+    frame_index_ = (frame_index_ + 1) % static_cast<int>(frames_.size());
+
+    // the gpu is done with this frame. heaps not used during its last
+    // round are released, the others are kept for reuse
+
+    auto &frame = frames_[frame_index_];
+    frame.resources.clear();
+    freeHeaps(frame, true);
+    for(auto &heap : frame.heaps)
+        heap.in_use = false;
+}
+
+Buffer TransientResourcePool::newBuffer(const vk::BufferCreateInfo &create_info)
+{
+    auto buffer = resource_allocator_->createUnboundBuffer(create_info);
+    frames_[frame_index_].resources.push_back(Resource{
+        .buffer       = buffer,
+        .requirements = resource_allocator_->getMemoryRequirements(buffer),
+        .linear       = true
+    });
+    return buffer;
+}
+
+Image TransientResourcePool::newImage(const vk::ImageCreateInfo &create_info)
+{
+    // aliased memory has undefined content
+
+    auto info = create_info;
+    info.initialLayout = vk::ImageLayout::eUndefined;
+
+    auto image = resource_allocator_->createUnboundImage(info);
+    frames_[frame_index_].resources.push_back(Resource{
+        .image        = image,
+        .requirements = resource_allocator_->getMemoryRequirements(image),
+        .linear       = info.tiling == vk::ImageTiling::eLinear
+    });
+    return image;
+}
+
+void TransientResourcePool::allocate(const Graph &graph, ExecutableGraph &exec)
+{
+    assert(image_barrier_patches_.empty() && memory_barrier_patches_.empty());
+    auto &frame = frames_[frame_index_];
+
+    std::vector<Lifetime>                    lifetimes;
+    std::unordered_map<VkBuffer, Lifetime *> buffer_lifetimes;
+    std::unordered_map<VkImage, Lifetime *>  image_lifetimes;
+
+    lifetimes.reserve(frame.resources.size());
+    for(size_t i = 0; i < frame.resources.size(); ++i)
+    {
+        auto &rsc = frame.resources[i];
+        if(rsc.bound)
+            continue;
+        auto &lifetime = lifetimes.emplace_back();
+        lifetime.resource = static_cast<int>(i);
+    }
+
+    if(lifetimes.empty())
+        return;
+
+    for(auto &lifetime : lifetimes)
+    {
+        auto &rsc = frame.resources[lifetime.resource];
+        if(rsc.buffer)
+        {
+            auto handle = static_cast<VkBuffer>(rsc.buffer.get());
+            buffer_lifetimes[handle] = &lifetime;
+        }
+        else
+        {
+            auto handle = static_cast<VkImage>(rsc.image.get());
+            image_lifetimes[handle] = &lifetime;
+        }
+    }
+
+    auto find_buffer = [&](vk::Buffer buffer) -> Lifetime *
+    {
+        auto it = buffer_lifetimes.find(static_cast<VkBuffer>(buffer));
+        return it != buffer_lifetimes.end() ? it->second : nullptr;
+    };
+
+    auto find_image = [&](vk::Image image) -> Lifetime *
+    {
+        auto it = image_lifetimes.find(static_cast<VkImage>(image));
+        return it != image_lifetimes.end() ? it->second : nullptr;
+    };
+
+    // resources synchronized with semaphores are accessed outside of the
+    // graph, so their memory is never shared
+
+    auto disable_buffer = [&](const Buffer &buffer)
+    {
+        if(auto l = find_buffer(buffer.get()))
+            l->aliasable = false;
+    };
+
+    auto disable_image = [&](const ImageSubresourceRange &image_range)
+    {
+        if(auto l = find_image(image_range.get()))
+            l->aliasable = false;
+    };
+
+    for(auto &buffer : std::views::keys(graph.buffer_waits_))
+        disable_buffer(buffer);
+    for(auto &buffer : std::views::keys(graph.buffer_signals_))
+        disable_buffer(buffer);
+    for(auto &image_range : std::views::keys(graph.image_waits_))
+        disable_image(image_range);
+    for(auto &image_range : std::views::keys(graph.image_signals_))
+        disable_image(image_range);
+
+    // compute lifetimes over the linearized executable graph, whose groups
+    // and passes are in the compiler's sorted order. groups on the same
+    // queue are submitted in this order.
+    // event barriers count at both the setting and the waiting pass
+
+    std::vector<ExecutablePass *> positions;
+    for(auto &group : exec.groups)
+    {
+        for(auto &pass : group.passes)
+        {
+            const int position = static_cast<int>(positions.size());
+            positions.push_back(&pass);
+
+            auto touch_barriers = [&](
+                const auto &buffer_barriers, const auto &image_barriers)
+            {
+                for(auto &b : buffer_barriers)
+                {
+                    if(auto l = find_buffer(b.buffer))
+                        l->touch(position, group.queue);
+                }
+                for(auto &b : image_barriers)
+                {
+                    if(auto l = find_image(b.image))
+                        l->touch(position, group.queue);
+                }
+            };
+
+            touch_barriers(pass.pre_buffer_barriers, pass.pre_image_barriers);
+            touch_barriers(pass.post_buffer_barriers, pass.post_image_barriers);
+
+            for(int event : pass.set_events)
+            {
+                auto &e = group.events[event];
+                touch_barriers(e.buffer_barriers, e.image_barriers);
+            }
+            for(int event : pass.wait_events)
+            {
+                auto &e = group.events[event];
+                touch_barriers(e.buffer_barriers, e.image_barriers);
+            }
+
+            if(!pass.pass)
+                continue;
+
+            for(auto &[buffer, usage] : pass.pass->_getBufferUsages())
+            {
+                if(auto l = find_buffer(buffer.get()))
+                    l->use(position, group.queue, usage.stages, usage.access);
+            }
+
+            for(auto &[image_range, usage] : pass.pass->_getImageUsages())
+            {
+                if(auto l = find_image(image_range.get()))
+                    l->use(position, group.queue, usage.stages, usage.access);
+            }
+        }
+    }
+
+    // resources not touched by this graph are left unbound, as they may be
+    // used by a later graph of this frame and share memory there
+
+    std::erase_if(lifetimes, [](const Lifetime &l) { return l.end < 0; });
+    if(lifetimes.empty())
+        return;
+
+    for(auto &lifetime : lifetimes)
+    {
+        if(!lifetime.has_usage)
+            lifetime.aliasable = false;
+    }
+
+    // pack resources of each memory type set into one heap.
+    // linear and non-linear resources go to different heaps, so that they
+    // never share a page of bufferImageGranularity.
+    // larger resources are placed first, each at the lowest offset where it
+    // does not overlap any placed resource with a conflicting lifetime
+
+    auto get_resource = [&](const Lifetime &l) -> auto &
+    {
+        return frame.resources[l.resource];
+    };
+
+    auto get_requirements = [&](const Lifetime &l) -> auto &
+    {
+        return get_resource(l).requirements;
+    };
+
+    auto same_heap = [&](const Lifetime &a, const Lifetime &b)
+    {
+        return get_requirements(a).memoryTypeBits ==
+                    get_requirements(b).memoryTypeBits &&
+               get_resource(a).linear == get_resource(b).linear;
+    };
+
+    std::ranges::sort(lifetimes, [&](const Lifetime &a, const Lifetime &b)
+    {
+        auto &ra = get_requirements(a);
+        auto &rb = get_requirements(b);
+        if(ra.memoryTypeBits != rb.memoryTypeBits)
+            return ra.memoryTypeBits < rb.memoryTypeBits;
+        if(get_resource(a).linear != get_resource(b).linear)
+            return get_resource(a).linear < get_resource(b).linear;
+        return ra.size > rb.size;
+    });
+
+    size_t group_beg = 0;
+    while(group_beg < lifetimes.size())
+    {
+        const uint32_t memory_type_bits =
+            get_requirements(lifetimes[group_beg]).memoryTypeBits;
+
+        size_t group_end = group_beg + 1;
+        while(group_end < lifetimes.size() &&
+              same_heap(lifetimes[group_beg], lifetimes[group_end]))
+            ++group_end;
+
+        vk::DeviceSize heap_size = 0, heap_alignment = 1;
+        for(size_t i = group_beg; i < group_end; ++i)
+        {
+            auto &lifetime = lifetimes[i];
+            auto &req = get_requirements(lifetime);
+
+            std::vector<std::pair<vk::DeviceSize, vk::DeviceSize>> occupied;
+            for(size_t j = group_beg; j < i; ++j)
+            {
+                if(lifetimes[j].conflicts(lifetime))
+                {
+                    auto &other = lifetimes[j];
+                    occupied.push_back({
+                        other.offset,
+                        other.offset + get_requirements(other).size
+                    });
+                }
+            }
+            std::ranges::sort(occupied);
+
+            vk::DeviceSize offset = 0;
+            for(auto &[beg, end] : occupied)
+            {
+                if(offset + req.size <= beg)
+                    break;
+                offset = (std::max)(
+                    offset, agz::upalign_to(end, req.alignment));
+            }
+
+            lifetime.offset = offset;
+            heap_size = (std::max)(heap_size, offset + req.size);
+            heap_alignment = (std::max)(heap_alignment, req.alignment);
+        }
+
+        auto allocation = getHeap(memory_type_bits, heap_size, heap_alignment);
+
+        for(size_t i = group_beg; i < group_end; ++i)
+        {
+            auto &lifetime = lifetimes[i];
+            auto &rsc = frame.resources[lifetime.resource];
+            if(rsc.buffer)
+            {
+                resource_allocator_->bindMemory(
+                    rsc.buffer, allocation, lifetime.offset);
+            }
+            else
+            {
+                resource_allocator_->bindMemory(
+                    rsc.image, allocation, lifetime.offset);
+            }
+            rsc.bound = true;
+        }
+
+        // the first access to a resource must wait for the last accesses to
+        // every earlier resource sharing its memory
+
+        for(size_t i = group_beg; i < group_end; ++i)
+        {
+            auto &b = lifetimes[i];
+            auto &b_rsc = frame.resources[b.resource];
+            const vk::DeviceSize b_end = b.offset + get_requirements(b).size;
+
+            for(size_t j = group_beg; j < group_end; ++j)
+            {
+                auto &a = lifetimes[j];
+                if(i == j || a.conflicts(b) || a.end >= b.begin)
+                    continue;
+
+                const vk::DeviceSize a_end =
+                    a.offset + get_requirements(a).size;
+                if(a_end <= b.offset || b_end <= a.offset)
+                    continue;
+
+                auto pass = positions[b.begin];
+
+                // images start with a layout transition, whose first
+                // synchronization scope is extended to cover the previous
+                // resource. buffers get a global memory barrier instead
+
+                bool patched = false;
+                if(b_rsc.image)
+                {
+                    auto &barriers = pass->pre_image_barriers;
+                    for(size_t k = 0; k < barriers.size(); ++k)
+                    {
+                        auto &barrier = barriers[k];
+                        if(barrier.image != b_rsc.image.get())
+                            continue;
+                        image_barrier_patches_.push_back({
+                            pass, k,
+                            barrier.srcStageMask, barrier.srcAccessMask
+                        });
+                        barrier.srcStageMask  |= a.last_stages;
+                        barrier.srcAccessMask |= a.last_access;
+                        patched = true;
+                    }
+                }
+
+                if(!patched)
+                {
+                    memory_barrier_patches_.push_back({
+                        pass, pass->pre_memory_barrier
+                    });
+                    if(!pass->pre_memory_barrier)
+                        pass->pre_memory_barrier = vk::MemoryBarrier2KHR{};
+                    auto &barrier = *pass->pre_memory_barrier;
+                    barrier.srcStageMask  |= a.last_stages;
+                    barrier.srcAccessMask |= a.last_access;
+                    barrier.dstStageMask  |= b.first_stages;
+                    barrier.dstAccessMask |= b.first_access;
+                }
+            }
+        }
+
+        group_beg = group_end;
+    }
+}
+
+void TransientResourcePool::restoreBarriers()
+{
+    // in reverse order, so that a barrier patched several times gets its
+    // original value back
+
+    for(auto &patch : std::views::reverse(image_barrier_patches_))
+    {
+        auto &barrier = patch.pass->pre_image_barriers[patch.barrier];
+        barrier.srcStageMask  = patch.src_stages;
+        barrier.srcAccessMask = patch.src_access;
+    }
+
+    for(auto &patch : std::views::reverse(memory_barrier_patches_))
+        patch.pass->pre_memory_barrier = patch.barrier;
+
+    image_barrier_patches_.clear();
+    memory_barrier_patches_.clear();
+}
+
+VmaAllocation TransientResourcePool::getHeap(
+    uint32_t       memory_type_bits,
+    vk::DeviceSize size,
+    vk::DeviceSize alignment)
+{
+    auto &frame = frames_[frame_index_];
+
+    // offsets within the heap are aligned relative to its start, so the
+    // heap itself must be aligned at least as strictly
+
+    for(auto &heap : frame.heaps)
+    {
+        if(!heap.in_use &&
+           heap.memory_type_bits == memory_type_bits &&
+           heap.size >= size &&
+           heap.alignment % alignment == 0)
+        {
+            heap.in_use = true;
+            return heap.allocation;
+        }
+    }
+
+    const vk::MemoryRequirements requirements = {
+        .size           = size,
+        .alignment      = alignment,
+        .memoryTypeBits = memory_type_bits
+    };
+
+    auto &heap = frame.heaps.emplace_back();
+    heap.memory_type_bits = memory_type_bits;
+    heap.size             = size;
+    heap.alignment        = alignment;
+    heap.allocation       = resource_allocator_->allocateMemory(
+        requirements, vma::MemoryUsage::eGPUOnly);
+    heap.in_use           = true;
+
+    return heap.allocation;
+}
+
+void TransientResourcePool::freeHeaps(PerFrame &frame, bool only_unused)
+{
+    std::erase_if(frame.heaps, [&](const Heap &heap)
+    {
+        if(only_unused && heap.in_use)
+            return false;
+        resource_allocator_->freeMemory(heap.allocation);
+        return true;
+    });
+}
+
+VKPT_GRAPH_END
@@ -1,3 +1,9 @@
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <vkpt/graph/transitive_closure.h>
 
 VKPT_GRAPH_BEGIN
@@ -5,29 +11,47 @@ VKPT_GRAPH_BEGIN
 namespace
 {
 
-    bool getBit(uint32_t bits, int index)
+    bool getBit(uint64_t bits, int index)
+    {
+        return bits & (uint64_t(1) << index);
+    }
+
+    void setBit(uint64_t &bits, int index)
     {
-        return bits & (1 << index);
+        bits |= (uint64_t(1) << index);
     }
 
-    void setBit(uint32_t &bits, int index)
+    void orLine(uint64_t *dst, const uint64_t *src, int count)
     {
-        bits |= (1 << index);
+        int i = 0;
+#ifdef __AVX2__
+        for(; i + 4 <= count; i += 4)
+        {
+            const __m256i a = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(dst + i));
+            const __m256i b = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(src + i));
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(a, b));
+        }
+#endif
+        for(; i < count; ++i)
+            dst[i] |= src[i];
     }
 
 } // namespace anonymous
 
 DAGTransitiveClosure::DAGTransitiveClosure(
     int vertex_count, std::pmr::memory_resource &memory)
-    : bitmap_(&memory), direct_neighbors_(&memory)
+    : vertex_count_(vertex_count), bitmap_(&memory), direct_neighbors_(&memory)
 {
-    line_ = agz::upalign_to(vertex_count, 32) / 32;
+    line_ = agz::upalign_to(vertex_count, 64) / 64;
 
-    bitmap_.resize(line_ * vertex_count);
+    bitmap_.resize(static_cast<size_t>(line_) * vertex_count);
     for(int i = 0; i < vertex_count; ++i)
     {
-        uint32_t &bits = bitmap_[i * line_ + i / 32];
-        setBit(bits, i % 32);
+        uint64_t &bits = bitmap_[static_cast<size_t>(i) * line_ + i / 64];
+        setBit(bits, i % 64);
     }
 
     direct_neighbors_.resize(vertex_count, Vector<int>(&memory));
@@ -35,29 +59,46 @@ DAGTransitiveClosure::DAGTransitiveClosure(
 
 void DAGTransitiveClosure::addArc(int head, int tail)
 {
-    uint32_t &bits = bitmap_[head * line_ + tail / 32];
-    setBit(bits, tail % 32);
+    assert(head < tail);
     direct_neighbors_[head].push_back(tail);
 }
 
 void DAGTransitiveClosure::computeClosure()
 {
-    for(int head = static_cast<int>(bitmap_.size() - 1); head >= 0; --head)
+    for(int head = vertex_count_ - 1; head >= 0; --head)
     {
-        uint32_t *head_line = &bitmap_[head * line_];
-        for(int tail : direct_neighbors_[head])
+        uint64_t *head_line = &bitmap_[static_cast<size_t>(head) * line_];
+
+        // visiting tails in ascending order lets us skip every tail that is
+        // already reachable through a previous one, whose closure contains
+        // that of the skipped tail. for sparse graphs most arcs are skipped
+
+        auto &neighbors = direct_neighbors_[head];
+        std::ranges::sort(neighbors);
+
+        for(int tail : neighbors)
         {
-            uint32_t *tail_line = &bitmap_[tail * line_];
-            for(int i = 0; i < line_; ++i)
-                head_line[i] |= tail_line[i];
+            if(getBit(head_line[tail / 64], tail % 64))
+                continue;
+
+            // every vertex reachable from tail has index >= tail
+
+            const int first_word = tail / 64;
+            const uint64_t *tail_line =
+                &bitmap_[static_cast<size_t>(tail) * line_];
+            orLine(
+                head_line + first_word,
+                tail_line + first_word,
+                line_ - first_word);
         }
     }
 }
 
 bool DAGTransitiveClosure::isReachable(int start, int end) const
 {
-    const uint32_t bits = bitmap_[start * line_ + end / 32];
-    return getBit(bits, end % 32);
+    const uint64_t bits =
+        bitmap_[static_cast<size_t>(start) * line_ + end / 64];
+    return getBit(bits, end % 64);
 }
 
 VKPT_GRAPH_END
@@ -56,14 +56,7 @@ ImmediateCommandBuffer::operator bool() const
 void ImmediateCommandBuffer::submitAndSync()
 {
     buffer_->end();
-    vk::CommandBuffer cmds[] = { buffer_.get() };
-    queue_->getRaw().submit(
-        std::array{
-            vk::SubmitInfo{
-                .commandBufferCount = 1,
-                .pCommandBuffers    = cmds
-            }
-        }, fence_.get());
+    queue_->submit({}, {}, {}, CommandBuffer(buffer_.get()), fence_.get());
 
     (void)queue_->getDevice().waitForFences(
         std::array{ fence_.get() }, true, UINT64_MAX);
@@ -113,6 +113,16 @@ ResourceState &ImageSubresource::getState()
     return image.getState(subrsc);
 }
 
+vk::Image ImageSubresourceRange::get() const
+{
+    return image.get();
+}
+
+const std::string &ImageSubresourceRange::getName() const
+{
+    return image.getName();
+}
+
 ImageView::operator bool() const
 {
     return impl_ != nullptr;
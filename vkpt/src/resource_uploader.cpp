@@ -94,12 +94,8 @@ void ResourceUploader::submitAndSync()
         0, nullptr);
     command_buffer_->end();
 
-    vk::CommandBuffer submit_command_buffers[] = { command_buffer_.get() };
-
-    queue_->getRaw().submit(std::array{ vk::SubmitInfo{
-        .commandBufferCount = 1,
-        .pCommandBuffers    = submit_command_buffers
-    } }, sync_fence_.get());
+    queue_->submit(
+        {}, {}, {}, CommandBuffer(command_buffer_.get()), sync_fence_.get());
 
     (void)queue_->getDevice().waitForFences(
         std::array{ sync_fence_.get() }, true, UINT64_MAX);
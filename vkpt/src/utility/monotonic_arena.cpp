@@ -0,0 +1,107 @@
+#include <vkpt/utility/monotonic_arena.h>
+
+VKPT_BEGIN
+
+MonotonicArena::MonotonicArena(size_t initial_block_size)
+    : initial_block_size_((std::max)(initial_block_size, size_t(64))),
+      block_index_(0),
+      offset_(0)
+{
+    
+}
+
+MonotonicArena::MonotonicArena(MonotonicArena &&other) noexcept
+    : MonotonicArena()
+{
+    swap(other);
+}
+
+MonotonicArena &MonotonicArena::operator=(MonotonicArena &&other) noexcept
+{
+    swap(other);
+    return *this;
+}
+
+MonotonicArena::~MonotonicArena()
+{
+    releaseBlocks();
+}
+
+void MonotonicArena::swap(MonotonicArena &other) noexcept
+{
+    std::swap(initial_block_size_, other.initial_block_size_);
+    std::swap(blocks_, other.blocks_);
+    std::swap(block_index_, other.block_index_);
+    std::swap(offset_, other.offset_);
+}
+
+void MonotonicArena::reset()
+{
+    if(block_index_ > 0)
+    {
+        const size_t capacity = getCapacity();
+        releaseBlocks();
+        blocks_.push_back({
+            static_cast<std::byte *>(::operator new(capacity)), capacity
+        });
+    }
+
+    block_index_ = 0;
+    offset_      = 0;
+}
+
+size_t MonotonicArena::getCapacity() const
+{
+    size_t result = 0;
+    for(auto &block : blocks_)
+        result += block.size;
+    return result;
+}
+
+void *MonotonicArena::do_allocate(size_t bytes, size_t alignment)
+{
+    while(block_index_ < blocks_.size())
+    {
+        auto &block = blocks_[block_index_];
+
+        const auto beg = reinterpret_cast<uintptr_t>(block.data);
+        const auto ptr = (beg + offset_ + alignment - 1) & ~(alignment - 1);
+        if(ptr + bytes <= beg + block.size)
+        {
+            offset_ = ptr + bytes - beg;
+            return reinterpret_cast<void *>(ptr);
+        }
+
+        ++block_index_;
+        offset_ = 0;
+    }
+
+    const size_t last_size =
+        blocks_.empty() ? initial_block_size_ : 2 * blocks_.back().size;
+    const size_t size = (std::max)(last_size, bytes + alignment);
+
+    blocks_.push_back({ static_cast<std::byte *>(::operator new(size)), size });
+    block_index_ = blocks_.size() - 1;
+    offset_ = 0;
+
+    return do_allocate(bytes, alignment);
+}
+
+void MonotonicArena::do_deallocate(void *, size_t, size_t)
+{
+    // memory is reclaimed by reset
+}
+
+bool MonotonicArena::do_is_equal(const memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+void MonotonicArena::releaseBlocks()
+{
+    for(auto &block : blocks_)
+        ::operator delete(block.data);
+    blocks_.clear();
+}
+
+VKPT_END
@@ -0,0 +1,135 @@
+#include <vkpt/utility/thread_pool.h>
+
+VKPT_BEGIN
+
+ThreadPool::ThreadPool(uint32_t worker_count)
+    : stop_(false),
+      job_index_(0),
+      running_workers_(0),
+      func_(nullptr),
+      task_count_(0),
+      next_task_(0)
+{
+    workers_.reserve(worker_count);
+    for(uint32_t i = 0; i < worker_count; ++i)
+        workers_.emplace_back(&ThreadPool::workerMain, this, i + 1);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    start_cond_.notify_all();
+
+    for(auto &w : workers_)
+        w.join();
+}
+
+uint32_t ThreadPool::getThreadCount() const
+{
+    return static_cast<uint32_t>(workers_.size() + 1);
+}
+
+void ThreadPool::parallelFor(
+    size_t                                       task_count,
+    const std::function<void(uint32_t, size_t)> &func)
+{
+    if(!task_count)
+        return;
+
+    if(workers_.empty() || task_count == 1)
+    {
+        for(size_t i = 0; i < task_count; ++i)
+            func(0, i);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        func_            = &func;
+        task_count_      = task_count;
+        next_task_       = 0;
+        exception_       = nullptr;
+        running_workers_ = static_cast<uint32_t>(workers_.size());
+        ++job_index_;
+    }
+    start_cond_.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock lock(mutex_);
+    finish_cond_.wait(lock, [&] { return running_workers_ == 0; });
+    func_ = nullptr;
+
+    if(exception_)
+        std::rethrow_exception(exception_);
+}
+
+void ThreadPool::workerMain(uint32_t thread_index)
+{
+    uint64_t last_job_index = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock lock(mutex_);
+            start_cond_.wait(lock, [&]
+            {
+                return stop_ || job_index_ != last_job_index;
+            });
+            if(stop_)
+                return;
+            last_job_index = job_index_;
+        }
+
+        runTasks(thread_index);
+
+        {
+            std::lock_guard lock(mutex_);
+            --running_workers_;
+        }
+        finish_cond_.notify_one();
+    }
+}
+
+void ThreadPool::runTasks(uint32_t thread_index)
+{
+    for(;;)
+    {
+        const size_t task = next_task_.fetch_add(1);
+        if(task >= task_count_)
+            return;
+
+        try
+        {
+            (*func_)(thread_index, task);
+        }
+        catch(...)
+        {
+            std::lock_guard lock(mutex_);
+            if(!exception_)
+                exception_ = std::current_exception();
+
+            // skip remaining tasks
+            next_task_ = task_count_;
+        }
+    }
+}
+
+void parallelFor(
+    ThreadPool                                  *thread_pool,
+    size_t                                       task_count,
+    const std::function<void(uint32_t, size_t)> &func)
+{
+    if(thread_pool)
+    {
+        thread_pool->parallelFor(task_count, func);
+        return;
+    }
+
+    for(size_t i = 0; i < task_count; ++i)
+        func(0, i);
+}
+
+VKPT_END